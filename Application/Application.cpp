@@ -10,6 +10,7 @@
 #include <glm/glm.hpp>
 #include <ctime>
 #include <string>
+#include <vector>
 
 #include "Quantum.h"
 #include "GxWorld.h"
@@ -25,11 +26,32 @@ using namespace Quantum;
 GxWorld gxWorld;
 QmWorld pxWorld;
 
+std::vector<glm::vec3> positions;
+
 glm::vec3* mousePointer;
 QmParticle* mousP;
+int mousHandle = -1;
+QmSpringNetwork* springNetwork;
 
 int scene = 0;
 
+// Emitters of scene 1, and the graphics particles of every emitter slot.
+QmEmitter* fountain = NULL;
+QmEmitter* jet = NULL;
+std::vector<GxParticle*> emitterSlots;
+
+// Playback of a recorded trajectory, in place of the simulation.
+QmTrajectoryReader playback;
+bool playing = false;
+int playFrame = 0;
+float playTime = 0.f;
+int playSlots = 0;
+
+// Scene 5: read from the file given with --scene-file.
+QmScene sceneDesc;
+std::string sceneFile;
+std::vector<glm::vec3> sceneColors;
+
 
 // ------------------- OpenGL/GLUT Variables -------------------
 // Global variables
@@ -56,6 +78,7 @@ bool g = false;
 bool uDel = false;
 bool euler = true;
 bool col = false;
+bool implicitSprings = false;
 int K = 8;
 int charge = 0;
 float damping = 1.0f;
@@ -91,50 +114,80 @@ QmParticle* createParticle()
 	float rad = 0.1f + 0.2f*((rand() % 100) / 100.f);
 	GxParticle* g = new GxParticle(randomVector(1, 0), rad, pos);
 	QmParticle* p = new QmParticle(pos, randomVector(-1, 1), randomVector(-1, 1), 1, 0, rad, 1);
-	p->setUpdater(new GxUpdater(g));
-	gxWorld.addParticle(g);
-	pxWorld.addBody(p);
+	gxWorld.addParticle(g, pxWorld.addBody(p));
 	return p;
 }
 
 /**
- * @brief Creates a particle for the fountain scene.
+ * @brief Gives a graphics particle to every slot of the emitters, hidden until the slot holds a particle.
+ * @param colors Color of each handle, or NULL for random colors.
+ */
+void addEmitterParticles(const std::vector<glm::vec3>* colors)
+{
+	emitterSlots.clear();
+	for (QmEmitter* e : pxWorld.getEmitters())
+		for (int k = 0; k < e->getCapacity(); k++)
+		{
+			int h = e->getFirstHandle() + k;
+			GxParticle* g = new GxParticle(colors ? (*colors)[h] : randomVector(1, 0), 0.f, glm::vec3(0));
+			gxWorld.addParticle(g, h);
+			emitterSlots.push_back(g);
+		}
+}
+
+/**
+ * @brief Shows the emitter slots that hold a particle, at its radius, and hides the others.
+ */
+void updateEmitterParticles()
+{
+	const std::vector<QmBody*>& bodies = pxWorld.getBodies();
+	for (GxParticle* g : emitterSlots)
+	{
+		int i = pxWorld.getBodyIndex(g->getBody());
+		g->setRad(i < 0 ? 0.f : ((QmParticle*)bodies[i])->getRadius());
+	}
+}
+
+/**
+ * @brief Hides the graphics particles whose handle has no body yet, or no longer.
  *
- * Spawns the particle at the mouse pointer location with initial upward velocity and gravity acting on it.
- * Also creates a corresponding graphics particle and attaches a GxUpdater.
+ * Handles of queued spawns are given before the body joins the world, and
+ * removed bodies keep their handle: neither has a position to show.
  */
-QmParticle* createParticleFontaine()
+void updateParticleVisibility()
 {
-	glm::vec3 pos = *mousePointer;
-	float rad = 0.1f + 0.2f*((rand() % 100) / 100.f);
-	GxParticle* g = new GxParticle(randomVector(1, 0), rad, pos);
-	QmParticle* p = new QmParticle(pos, glm::vec3(-5 + 10 * ((rand() % 100) / 100.f), 15, 0), glm::vec3(0, -9.81, 0), 1, 0, rad, 1);
-	p->setUpdater(new GxUpdater(g));
-	gxWorld.addParticle(g);
-	pxWorld.addBody(p);
-	return p;
+	for (GxParticle* g : gxWorld.getParticles())
+		if (g->getBody() >= 0)
+			g->setVisible(pxWorld.getBodyIndex(g->getBody()) >= 0);
 }
 
 /**
- * @brief Creates a particle with drag force applied.
+ * @brief Creates the fountain and drag emitters of scene 1.
  *
- * The particle is spawned at the mouse pointer location. A QmDrag force generator
- * is registered to apply drag in the physics world.
+ * Both only release particles on demand (keys f and p), at the mouse
+ * pointer; each particle lives 10 seconds and a ring of 500 is reused.
  */
-QmParticle* createParticleDrag()
+void createEmitters()
 {
-	glm::vec3 pos = *mousePointer;
-	float rad = 0.1f + 0.2f*((rand() % 100) / 100.f);
-	GxParticle* g = new GxParticle(randomVector(1, 0), rad, pos);
-	QmParticle* p = new QmParticle(pos, glm::vec3(-3 + 6 * ((rand() % 100) / 100.f), 10, 0), glm::vec3(0, 0, 0), 2, 0, rad, 1);
-	QmDrag* drag = new QmDrag(4 * ((rand() % 100) / 100.f), 0.7 * ((rand() % 100) / 100.f));
-	QmForceGenerator* fg = (QmForceGenerator*)drag;
-	QmForceRegistry* fr = new QmForceRegistry(p, fg);
-	pxWorld.AddForceRegistry(fr);
-	p->setUpdater(new GxUpdater(g));
-	gxWorld.addParticle(g);
-	pxWorld.addBody(p);
-	return p;
+	QmSpawnDistribution s;
+	s.vel[0].min = -5; s.vel[0].max = 5;
+	s.vel[1].min = s.vel[1].max = 15;
+	s.acc[1].min = s.acc[1].max = -9.81f;
+	s.radius.min = 0.1f; s.radius.max = 0.3f;
+	fountain = new QmEmitter(s, 0.f, 10.f, 500, rand());
+	pxWorld.addEmitter(fountain);
+
+	QmSpawnDistribution d;
+	d.vel[0].min = -3; d.vel[0].max = 3;
+	d.vel[1].min = d.vel[1].max = 10;
+	d.mass.min = d.mass.max = 2;
+	d.radius.min = 0.1f; d.radius.max = 0.3f;
+	d.linearDrag.max = 4;
+	d.quadraticDrag.max = 0.7f;
+	jet = new QmEmitter(d, 0.f, 10.f, 500, rand());
+	pxWorld.addEmitter(jet);
+
+	addEmitterParticles(NULL);
 }
 
 /**
@@ -169,12 +222,8 @@ QmParticle* createParticleMagnet()
 	QmForceRegistry* frf2 = new QmForceRegistry(pn, fgf2);
 	pxWorld.AddForceRegistry(frf2);
 
-	pp->setUpdater(new GxUpdater(gp));
-	gxWorld.addParticle(gp);
-	pxWorld.addBody(pp);
-	pn->setUpdater(new GxUpdater(gn));
-	gxWorld.addParticle(gn);
-	pxWorld.addBody(pn);
+	gxWorld.addParticle(gp, pxWorld.addBody(pp));
+	gxWorld.addParticle(gn, pxWorld.addBody(pn));
 	return pp;
 }
 
@@ -196,9 +245,7 @@ QmParticle* createParticleSpring(QmParticle* part, int lo)
 	QmForceGenerator* fg = (QmForceGenerator*)spring;
 	QmForceRegistry* fr = new QmForceRegistry(p, fg);
 	pxWorld.AddForceRegistry(fr);
-	p->setUpdater(new GxUpdater(g));
-	gxWorld.addParticle(g);
-	pxWorld.addBody(p);
+	gxWorld.addParticle(g, pxWorld.addBody(p));
 	return p;
 }
 
@@ -220,9 +267,7 @@ QmParticle* createParticleFixedSpring(glm::vec3 pos, int lo)
 	QmForceGenerator* fg = (QmForceGenerator*)fixspring;
 	QmForceRegistry* fr = new QmForceRegistry(p, fg);
 	pxWorld.AddForceRegistry(fr);
-	p->setUpdater(new GxUpdater(g));
-	gxWorld.addParticle(g);
-	pxWorld.addBody(p);
+	gxWorld.addParticle(g, pxWorld.addBody(p));
 	return p;
 }
 
@@ -233,7 +278,12 @@ QmParticle* createParticleFixedSpring(glm::vec3 pos, int lo)
  * @return QmParticle* Pointer to the last created particle in the tetrahedron
  *
  * This function spawns 3 particles connected to the base particle with springs, then creates
- * additional springs between them to form a tetrahedron. Useful for soft-body simulations.
+ * additional two-way springs between them in the scene spring network to form a tetrahedron.
+ * Useful for soft-body simulations.
+ *
+ * Before the spring network, these inner springs were one-way QmSpring entries
+ * (p1->p2, p2->p3, p3->p1, p4->p2, p4->p3) pulling only their first particle;
+ * they now pull both ends, so scene 3 moves differently than it used to.
  */
 QmParticle* createTethra(QmParticle* part, int lo) 
 {
@@ -241,30 +291,13 @@ QmParticle* createTethra(QmParticle* part, int lo)
 	QmParticle* p2 = createParticleSpring(part, 2);
 	QmParticle* p3 = createParticleSpring(part, 2);
 
-	QmSpring* spring11 = new QmSpring(K, 1, p2);
-	QmForceGenerator* fg11 = (QmForceGenerator*)spring11;
-	QmForceRegistry* fr11 = new QmForceRegistry(p1, fg11);
-	pxWorld.AddForceRegistry(fr11);
-
-	QmSpring* spring21 = new QmSpring(K, 1, p3);
-	QmForceGenerator* fg21 = (QmForceGenerator*)spring21;
-	QmForceRegistry* fr21 = new QmForceRegistry(p2, fg21);
-	pxWorld.AddForceRegistry(fr21);
-
-	QmSpring* spring31 = new QmSpring(K, 1, p1);
-	QmForceGenerator* fg31 = (QmForceGenerator*)spring31;
-	QmForceRegistry* fr31 = new QmForceRegistry(p3, fg31);
-	pxWorld.AddForceRegistry(fr31);
+	springNetwork->addSpring(p1, p2, K, 1);
+	springNetwork->addSpring(p2, p3, K, 1);
+	springNetwork->addSpring(p3, p1, K, 1);
 
 	QmParticle* p4 = createParticleSpring(p1, 2);
-	QmSpring* spring22 = new QmSpring(K, 1, p2);
-	QmForceGenerator* fg22 = (QmForceGenerator*)spring22;
-	QmForceRegistry* fr22 = new QmForceRegistry(p4, fg22);
-	pxWorld.AddForceRegistry(fr22);
-	QmSpring* spring32 = new QmSpring(K, 1, p3);
-	QmForceGenerator* fg32 = (QmForceGenerator*)spring32;
-	QmForceRegistry* fr32 = new QmForceRegistry(p4, fg32);
-	pxWorld.AddForceRegistry(fr32);
+	springNetwork->addSpring(p4, p2, K, 1);
+	springNetwork->addSpring(p4, p3, K, 1);
 
 	return p4;
 }
@@ -281,9 +314,7 @@ QmParticle* createParticleBox()
 	glm::vec3 pos = randomVector(-5, 5);
 	GxParticle* g = new GxParticle(randomVector(1, 0), 0.3f, pos);
 	QmParticle* p = new QmParticle(pos, randomVector(-4, 4), randomVector(1, 2), 1, 0, 0.3f, 1);
-	p->setUpdater(new GxUpdater(g));
-	gxWorld.addParticle(g);
-	pxWorld.addBody(p);
+	gxWorld.addParticle(g, pxWorld.addBody(p));
 	return p;
 }
 
@@ -301,6 +332,7 @@ void initScene1()
 	mousePointer = new glm::vec3(0, 4.5, 0);
 	for (int i = 0; i < 100; i++)
 		createParticle();
+	createEmitters();
 }
 
 /**
@@ -312,7 +344,7 @@ void initScene2()
 	printf("Magnetism.\n");
 	mousePointer = new glm::vec3(0, 4.5, 0);
 	mousP = new QmParticle(*mousePointer, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 0.1, 0, 0.2f, 0);
-	pxWorld.addBody(mousP);
+	mousHandle = pxWorld.addBody(mousP);
 	for (int i = 0; i < 50; i++)
 		createParticleMagnet();
 }
@@ -326,7 +358,9 @@ void initScene3()
 	printf("Ressort.\n");
 	mousePointer = new glm::vec3(0, 4.5, 0);
 	mousP = new QmParticle(*mousePointer, glm::vec3(0, 0, 0), glm::vec3(0, 0, 9.81), 0.1, 0, 0.2f, 0);
-	pxWorld.addBody(mousP);
+	mousHandle = pxWorld.addBody(mousP);
+	springNetwork = new QmSpringNetwork();
+	pxWorld.AddSpringNetwork(springNetwork);
 	//QmParticle* begin = createParticleFixedSpring(*mousePointer, 1);
 	QmParticle* n1 = createTethra(mousP, 2);
 	QmParticle* n2 = createTethra(n1, 3);
@@ -346,6 +380,116 @@ void initScene4()
 		createParticleBox();
 }
 
+/**
+ * @brief Gives a graphics particle to the bodies and emitter slots of the scene file.
+ */
+void addSceneParticles()
+{
+	const std::vector<QmBody*>& bodies = pxWorld.getBodies();
+	for (int h = 0; h < pxWorld.getHandleCount(); h++)
+	{
+		int i = pxWorld.getBodyIndex(h);
+		if (i < 0)
+			continue;
+		QmParticle* p = (QmParticle*)bodies[i];
+		gxWorld.addParticle(new GxParticle(sceneColors[h], p->getRadius(), p->getPos()), h);
+	}
+	addEmitterParticles(&sceneColors);
+}
+
+/**
+ * @brief Initializes scene 5: the scene file, read again each time so that edits show up.
+ */
+void initScene5()
+{
+	printf("Scene 5: %s.\n", sceneFile.c_str());
+	mousePointer = new glm::vec3(0, 4.5, 0);
+	sceneColors.clear();
+	if (!sceneDesc.load(sceneFile.c_str()))
+	{
+		std::cerr << sceneDesc.getError() << std::endl;
+		return;
+	}
+	sceneDesc.build(pxWorld, &sceneColors);
+	addSceneParticles();
+}
+
+
+// ------------------- Trajectory Playback -------------------
+
+/**
+ * @brief Displays the current playback frame.
+ *
+ * The frame is decoded into the same position buffer as the live simulation,
+ * and slots seen for the first time get a graphics particle, so GxWorld
+ * draws recorded bodies exactly like simulated ones.
+ */
+void showPlaybackFrame()
+{
+	int n = playback.getSlotCount(playFrame);
+	positions.resize(n);
+	if (playback.readFrame(playFrame, positions.data(), NULL, n) < 0)
+		return;
+	// The recording holds positions only: radius and colour are made up.
+	for (; playSlots < n; playSlots++)
+		gxWorld.addParticle(new GxParticle(randomVector(1, 0), 0.15f, positions[playSlots]), playSlots);
+	gxWorld.updatePositions(positions.data(), n);
+}
+
+/**
+ * @brief Empties both worlds and forgets what pointed into them.
+ *
+ * gxWorld deletes the emitter slot particles and pxWorld the emitters and
+ * bodies: the slots are rebuilt only when a scene with emitters is set up.
+ */
+void clearWorld()
+{
+	gxWorld.clear();
+	pxWorld.clear();
+	emitterSlots.clear();
+	fountain = jet = NULL;
+	mousP = NULL;
+	mousHandle = -1;
+}
+
+/**
+ * @brief Replaces the simulation by the playback of a recorded trajectory.
+ * @param path File written by QmTrajectoryWriter (quantum_run --record).
+ */
+void startPlayback(const char* path)
+{
+	clearWorld();
+	scene = 0;
+	if (!playback.open(path) || playback.getFrameCount() == 0)
+	{
+		std::cerr << "Cannot play trajectory " << path << std::endl;
+		return;
+	}
+	playing = true;
+	playFrame = 0;
+	playTime = playback.getTime(0);
+	playSlots = 0;
+	showPlaybackFrame();
+}
+
+/**
+ * @brief Moves the playback to a frame, clamped to the recording.
+ */
+void seekPlayback(int frame)
+{
+	playFrame = std::min(std::max(frame, 0), playback.getFrameCount() - 1);
+	playTime = playback.getTime(playFrame);
+}
+
+/**
+ * @brief Ends the playback and unmaps the trajectory.
+ */
+void stopPlayback()
+{
+	playing = false;
+	playback.close();
+}
+
 
 // ------------------- GLUT Callbacks -------------------
 
@@ -414,7 +558,24 @@ void idleFunc()
 	timeold = timer;
 
 	calculateFPS(dt);
+	if (playing)
+	{
+		if (!paused)
+		{
+			playTime += dt;
+			playFrame = playback.findFrame(playTime);
+		}
+		showPlaybackFrame();
+		glutPostRedisplay();
+		return;
+	}
 	if (!paused) pxWorld.simulate(dt, g, uDel, damping, euler, col);
+	updateEmitterParticles();
+	updateParticleVisibility();
+
+	positions.resize(pxWorld.getHandleCount());
+	pxWorld.exportState(positions.data(), NULL, (int)positions.size());
+	gxWorld.updatePositions(positions.data(), (int)positions.size());
 
 	glutPostRedisplay();
 }
@@ -457,6 +618,19 @@ void drawFunc()
 			}
 		}
 
+	if (scene == 3)
+		for (QmSpringNetwork* net : pxWorld.getSpringNetworks())
+			for (int e = 0; e < net->getSpringCount(); e++)
+			{
+				glm::vec3 pos1 = net->getSpringStart(e)->getPos();
+				glm::vec3 pos2 = net->getSpringEnd(e)->getPos();
+				glBegin(GL_LINES);
+				glColor3f(1.f, 1.f, 1.f);
+				glVertex3f(pos1.x, pos1.y, pos1.z);
+				glVertex3f(pos2.x, pos2.y, pos2.z);
+				glEnd();
+			}
+
 	if (scene == 4)
 	{
 		glBegin(GL_LINES);
@@ -501,6 +675,8 @@ void drawFunc()
 
 	for (GxParticle* p : gxWorld.getParticles())
 	{
+		if (!p->isVisible())
+			continue;
 		glPushMatrix();
 		glm::vec3 color = p->getColor();
 		glColor3f(color.x, color.y, color.z);
@@ -548,22 +724,16 @@ void motionFunc(int x, int y)
 		if (mousePointer)
 		*mousePointer += glm::vec3(x - mx, my - y, 0.f) / 15.f;
 		if (scene==3 || scene ==2)
-			mousP->setPos(*mousePointer);
+			pxWorld.postPosition(mousHandle, *mousePointer);
 	}
 
 	mx = (float)x;
 	my = (float)y;
 }
 
-void clearWorld()
-{
-	gxWorld.clear();
-	pxWorld.clear();
-
-}
-
 void toggleScene(int s)
 {
+	stopPlayback();
 	clearWorld();
 	scene = s;
 	resetView();
@@ -574,6 +744,7 @@ void toggleScene(int s)
 	case 2: initScene2(); break;
 	case 3: initScene3(); break;
 	case 4: initScene4(); break;
+	case 5: initScene5(); break;
 	}
 }
 
@@ -605,9 +776,29 @@ void keyFunc(unsigned char key, int x, int y)
 		clearWorld();
 		toggleScene(4);
 		break;
+	case '5':
+		if (!sceneFile.empty())
+			toggleScene(5);
+		break;
 	case ' ': 
 		paused = !paused; 
 		break;
+	case ',':
+		if (playing)
+			seekPlayback(playFrame - 1);
+		break;
+	case '.':
+		if (playing)
+			seekPlayback(playFrame + 1);
+		break;
+	case '[':
+		if (playing)
+			seekPlayback(playFrame - std::max(1, playback.getFrameCount() / 10));
+		break;
+	case ']':
+		if (playing)
+			seekPlayback(playFrame + std::max(1, playback.getFrameCount() / 10));
+		break;
 	case 'g':
 		g = !g;
 		break;
@@ -616,13 +807,11 @@ void keyFunc(unsigned char key, int x, int y)
 		break;
 	case 'f':
 		if (scene == 1)
-			for (int i = 0; i < 10; i++)
-				createParticleFontaine();
+			pxWorld.postBurst(fountain, 10, *mousePointer);
 		break;
 	case 'p':
 		if (scene == 1)
-			for (int i = 0; i < 10; i++)
-				createParticleDrag();
+			pxWorld.postBurst(jet, 10, *mousePointer);
 		break;
 	case 'm':
 		if (scene == 2) {
@@ -630,12 +819,12 @@ void keyFunc(unsigned char key, int x, int y)
 			charge = (charge++) % 3;
 			if (charge == 0) {
 				mousP = new QmParticle(*mousePointer, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 0.1, 0, 0.2f, 0);
-				pxWorld.addBody(mousP);
+				mousHandle = pxWorld.postSpawn(mousP);
 			}
 			else if (charge == 1)
-				mousP->setCharge(15);
+				pxWorld.postCharge(mousHandle, 15);
 			else if (charge == 2)
-				mousP->setCharge(-15);
+				pxWorld.postCharge(mousHandle, -15);
 		}
 		break;
 	case 'a':
@@ -668,6 +857,18 @@ void keyFunc(unsigned char key, int x, int y)
 		break;
 	case 'e':
 		euler = !euler;
+		// Implicit springs assume semi-implicit integration.
+		if (euler && implicitSprings)
+		{
+			implicitSprings = false;
+			pxWorld.setImplicitSprings(false, 20, 1e-3f);
+		}
+		break;
+	case 'i':
+		implicitSprings = !implicitSprings;
+		if (implicitSprings)
+			euler = false;
+		pxWorld.setImplicitSprings(implicitSprings, 20, 1e-3f);
 		break;
 	case 'c':
 		col = !col;
@@ -716,7 +917,15 @@ int main(int argc, char** argv)
 	srand((unsigned int)time(NULL));
 	initGraphics(argc, argv);
 
-	toggleScene(1);
+	if (argc > 2 && std::string(argv[1]) == "--play")
+		startPlayback(argv[2]);
+	else if (argc > 2 && std::string(argv[1]) == "--scene-file")
+	{
+		sceneFile = argv[2];
+		toggleScene(5);
+	}
+	else
+		toggleScene(1);
 
 	glutMainLoop();
 	return 0;
@@ -1,7 +1,7 @@
 #include "stdafx.h"
 #include "GxParticle.h"
 
-GxParticle::GxParticle()
+GxParticle::GxParticle() : body(-1), visible(true)
 {
 
 }
@@ -11,6 +11,8 @@ GxParticle::GxParticle(glm::vec3 c, float rad, glm::vec3 pos)
 	color = c;
 	radius = rad;
 	position = pos;
+	body = -1;
+	visible = true;
 }
 
 GxParticle::~GxParticle()
@@ -46,3 +48,23 @@ float GxParticle::getRadius()
 {
 	return radius;
 }
+
+void GxParticle::setBody(int b)
+{
+	body = b;
+}
+
+int GxParticle::getBody()
+{
+	return body;
+}
+
+void GxParticle::setVisible(bool v)
+{
+	visible = v;
+}
+
+bool GxParticle::isVisible()
+{
+	return visible;
+}
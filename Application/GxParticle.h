@@ -73,6 +73,29 @@ public:
 	 */
 	float getRadius();
 
+	/**
+	 * @brief Sets the handle of the physics body this particle displays.
+	 * @param b Body handle in the physics world, -1 for none.
+	 */
+	void setBody(int b);
+
+	/**
+	 * @brief Returns the handle of the physics body this particle displays.
+	 * @return Body handle, -1 for none.
+	 */
+	int getBody();
+
+	/**
+	 * @brief Shows or hides the particle.
+	 * @param v False to skip the particle when drawing.
+	 */
+	void setVisible(bool v);
+
+	/**
+	 * @brief Returns whether the particle is drawn.
+	 */
+	bool isVisible();
+
 private:
 	/// @brief Current position of the particle.
 	glm::vec3 position;
@@ -82,6 +105,12 @@ private:
 
 	/// @brief rticle radius for rendering.
 	float radius;
+
+	/// @brief Handle of the displayed body in the physics world.
+	int body;
+
+	/// @brief False while the particle is not drawn.
+	bool visible;
 };
 
 
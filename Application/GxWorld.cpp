@@ -19,7 +19,23 @@ void GxWorld::addParticle(GxParticle* p)
 	particles.push_back(p);
 }
 
-std::list<GxParticle*> GxWorld::getParticles()
+void GxWorld::addParticle(GxParticle* p, int body)
+{
+	p->setBody(body);
+	particles.push_back(p);
+}
+
+void GxWorld::updatePositions(const glm::vec3* positions, int count)
+{
+	for (GxParticle* p : particles)
+	{
+		int b = p->getBody();
+		if (b >= 0 && b < count)
+			p->setPos(positions[b]);
+	}
+}
+
+const std::list<GxParticle*>& GxWorld::getParticles()
 {
 	return particles;
 }
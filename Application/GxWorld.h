@@ -2,6 +2,7 @@
 #define GXWORLD_H
 
 #include <list>
+#include <glm/glm.hpp>
 
 class GxParticle;
 
@@ -32,10 +33,29 @@ public:
 	 */
 	void addParticle(GxParticle*);
 
+	/**
+	 * @brief Adds a particle displaying a physics body.
+	 * @param p Pointer to the particle to add.
+	 * @param body Handle of the body in the physics world.
+	 */
+	void addParticle(GxParticle*, int body);
+
+	/**
+	 * @brief Moves every particle to the position of its body.
+	 *
+	 * Consumes the buffer filled by Quantum::QmWorld::exportState (or by
+	 * Quantum::QmTrajectoryReader::readFrame during a playback) once per
+	 * frame, instead of one QmUpdater callback per particle and tick.
+	 *
+	 * @param positions Body positions, indexed by body handle.
+	 * @param count Number of positions.
+	 */
+	void updatePositions(const glm::vec3* positions, int count);
+
 	/**
 	* @brief Returns the list of particles in the world.
 	*/
-	std::list<GxParticle*> getParticles();
+	const std::list<GxParticle*>& getParticles();
 
 	/**
 	 * @brief Replaces the entire particle list.
@@ -20,6 +20,11 @@ glm::vec3 HalfSpace::GetNormal()
 	return normal_;
 }
 
+glm::vec3 HalfSpace::GetOffset()
+{
+	return offset_;
+}
+
 void HalfSpace::setAABB()
 {
 	glm::vec3 min = offset_;
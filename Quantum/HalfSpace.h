@@ -38,6 +38,11 @@ namespace Quantum {
 		 */
 		glm::vec3 GetNormal();
 
+		/**
+		 * @brief Returns the point the plane passes through.
+		 */
+		glm::vec3 GetOffset();
+
 		/**
 		 * @brief Returns the axis-aligned bounding box (AABB) for the half-space.
 		 *
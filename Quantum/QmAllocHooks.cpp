@@ -0,0 +1,116 @@
+#include "QmAllocTracker.h"
+#include <cstdlib>
+#include <new>
+
+// Replacement of the global operator new and delete that counts allocations
+// (QmAllocTracker). Not part of the Quantum library: a program opts in by
+// compiling this file with QM_TRACK_ALLOCATIONS set to 1.
+
+#if QM_TRACK_ALLOCATIONS
+
+using namespace Quantum;
+
+namespace {
+
+	struct Enable {
+		Enable() { QmAllocTracker::enable(); }
+	} enableTracker;
+
+	/// @brief Calls the installed new handler until malloc succeeds; NULL when there is none.
+	void* allocate(std::size_t size)
+	{
+		QmAllocTracker::record(size);
+		for (;;)
+		{
+			if (void* p = std::malloc(size ? size : 1))
+				return p;
+			std::new_handler handler = std::get_new_handler();
+			if (!handler)
+				return NULL;
+			handler();
+		}
+	}
+
+	void* allocateAligned(std::size_t size, std::size_t alignment)
+	{
+		QmAllocTracker::record(size);
+		for (;;)
+		{
+#ifdef _WIN32
+			void* p = _aligned_malloc(size ? size : 1, alignment);
+#else
+			// aligned_alloc wants a multiple of the alignment.
+			void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+			if (p)
+				return p;
+			std::new_handler handler = std::get_new_handler();
+			if (!handler)
+				return NULL;
+			handler();
+		}
+	}
+
+	void releaseAligned(void* p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* p = allocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	if (void* p = allocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+// The nothrow forms report a failure, including one thrown by a new handler, as NULL.
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return allocate(size); }
+	catch (...) { return NULL; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return allocate(size); }
+	catch (...) { return NULL; }
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (void* p = allocateAligned(size, (std::size_t)alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	if (void* p = allocateAligned(size, (std::size_t)alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { releaseAligned(p); }
+
+#endif
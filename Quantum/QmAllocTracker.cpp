@@ -0,0 +1,44 @@
+#include "QmAllocTracker.h"
+
+using namespace Quantum;
+
+namespace {
+
+	// Constant-initialised, so operator new may touch them from any thread at any time.
+	thread_local unsigned long long allocCount = 0;
+	thread_local unsigned long long allocBytes = 0;
+
+	bool enabled = false;
+}
+
+unsigned long long QmAllocTracker::getCount()
+{
+	return allocCount;
+}
+
+unsigned long long QmAllocTracker::getBytes()
+{
+	return allocBytes;
+}
+
+void QmAllocTracker::credit(unsigned long long count, unsigned long long bytes)
+{
+	allocCount += count;
+	allocBytes += bytes;
+}
+
+bool QmAllocTracker::isEnabled()
+{
+	return enabled;
+}
+
+void QmAllocTracker::record(std::size_t bytes)
+{
+	allocCount++;
+	allocBytes += bytes;
+}
+
+void QmAllocTracker::enable()
+{
+	enabled = true;
+}
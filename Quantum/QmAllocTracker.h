@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+
+// Set QM_TRACK_ALLOCATIONS to 1 when compiling QmAllocHooks.cpp to replace
+// the global operator new of the program; otherwise the counters below
+// always read 0. quantum_run and quantum_bench do, the library does not.
+#ifndef QM_TRACK_ALLOCATIONS
+#define QM_TRACK_ALLOCATIONS 0
+#endif
+
+namespace Quantum {
+
+	/**
+	 * @class QmAllocTracker
+	 * @brief Per-thread count of heap allocations made through operator new.
+	 *
+	 * A program that compiles QmAllocHooks.cpp with QM_TRACK_ALLOCATIONS set
+	 * replaces the global operator new and delete with versions that forward
+	 * to malloc and free and count every allocation in counters of the
+	 * allocating thread. Differences of the counters around a piece of code
+	 * give its allocations, whatever other threads (checkpoint or trajectory
+	 * writers) allocate meanwhile. QmThreadPool credits the allocations of its
+	 * tasks to the thread that ran the job. Memory taken directly with malloc
+	 * is not seen.
+	 */
+	class QmAllocTracker {
+	public:
+
+		/**
+		 * @return Number of allocations of the calling thread since it started.
+		 */
+		static unsigned long long getCount();
+
+		/**
+		 * @return Bytes requested by those allocations.
+		 */
+		static unsigned long long getBytes();
+
+		/**
+		 * @brief Adds allocations made on behalf of the calling thread to its counters.
+		 *
+		 * @param count Number of allocations.
+		 * @param bytes Bytes requested by them.
+		 */
+		static void credit(unsigned long long count, unsigned long long bytes);
+
+		/**
+		 * @return Whether the program counts allocations (QmAllocHooks.cpp linked in).
+		 */
+		static bool isEnabled();
+
+		/**
+		 * @brief Counts one allocation of the calling thread. Called by the replaced operator new.
+		 */
+		static void record(std::size_t bytes);
+
+		/**
+		 * @brief Marks the counters as live. Called once by QmAllocHooks.cpp.
+		 */
+		static void enable();
+	};
+}
@@ -0,0 +1,66 @@
+#include "QmBlockMatrix.h"
+#include <algorithm>
+
+using namespace Quantum;
+
+QmBlockMatrix::QmBlockMatrix() : rows_(0)
+{
+	rowStart_.push_back(0);
+}
+
+QmBlockMatrix::~QmBlockMatrix() {}
+
+void QmBlockMatrix::setPattern(int rows, const std::vector<int>& rowStart, const std::vector<int>& cols)
+{
+	rows_ = rows;
+	rowStart_ = rowStart;
+	col_ = cols;
+	val_.assign(9 * col_.size(), 0.f);
+	diag_.assign(rows, -1);
+	for (int i = 0; i < rows; i++)
+		diag_[i] = find(i, i);
+}
+
+int QmBlockMatrix::find(int i, int j)
+{
+	auto first = col_.begin() + rowStart_[i];
+	auto last = col_.begin() + rowStart_[i + 1];
+	auto it = std::lower_bound(first, last, j);
+	if (it == last || *it != j)
+		return -1;
+	return (int)(it - col_.begin());
+}
+
+void QmBlockMatrix::zero()
+{
+	std::fill(val_.begin(), val_.end(), 0.f);
+}
+
+void QmBlockMatrix::multiply(const float* x, float* y)
+{
+	for (int i = 0; i < rows_; i++)
+	{
+		float y0 = 0.f, y1 = 0.f, y2 = 0.f;
+		for (int k = rowStart_[i]; k < rowStart_[i + 1]; k++)
+		{
+			const float* b = &val_[9 * k];
+			const float* v = x + 3 * col_[k];
+			y0 += b[0] * v[0] + b[1] * v[1] + b[2] * v[2];
+			y1 += b[3] * v[0] + b[4] * v[1] + b[5] * v[2];
+			y2 += b[6] * v[0] + b[7] * v[1] + b[8] * v[2];
+		}
+		y[3 * i] = y0;
+		y[3 * i + 1] = y1;
+		y[3 * i + 2] = y2;
+	}
+}
+
+int QmBlockMatrix::getRows()
+{
+	return rows_;
+}
+
+int QmBlockMatrix::getBlockCount()
+{
+	return (int)col_.size();
+}
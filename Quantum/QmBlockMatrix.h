@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+
+namespace Quantum {
+
+	/**
+	 * @class QmBlockMatrix
+	 * @brief Sparse matrix made of 3x3 blocks (block CSR).
+	 *
+	 * Row i of blocks holds the couplings of particle i with its neighbors,
+	 * so a spring network of n particles gives a 3n x 3n matrix with one
+	 * diagonal block per particle and two off-diagonal blocks per spring.
+	 * The sparsity pattern is set once; values are reset and reassembled
+	 * every step.
+	 *
+	 * Blocks are stored row-major, 9 floats each. Vectors are interleaved
+	 * (x0, y0, z0, x1, ...).
+	 */
+	class QmBlockMatrix {
+	public:
+
+		/**
+		 * @brief Constructs an empty matrix.
+		 */
+		QmBlockMatrix();
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmBlockMatrix();
+
+		/**
+		 * @brief Sets the sparsity pattern.
+		 *
+		 * @param rows     Number of block rows.
+		 * @param rowStart First block of each row (size rows + 1).
+		 * @param cols     Block column of each block, sorted within a row.
+		 *                 Every row must contain its diagonal block.
+		 */
+		void setPattern(int rows, const std::vector<int>& rowStart, const std::vector<int>& cols);
+
+		/**
+		 * @brief Returns the index of block (i, j), or -1 if it is not in the pattern.
+		 */
+		int find(int i, int j);
+
+		/**
+		 * @brief Returns the 9 values of a block.
+		 */
+		float* block(int k) { return &val_[9 * k]; }
+
+		/**
+		 * @brief Returns the 9 values of the diagonal block of row i.
+		 */
+		float* diagonal(int i) { return &val_[9 * diag_[i]]; }
+
+		/**
+		 * @brief Sets every value to zero, keeping the pattern.
+		 */
+		void zero();
+
+		/**
+		 * @brief Computes y = A x.
+		 */
+		void multiply(const float* x, float* y);
+
+		/// @return Number of block rows.
+		int getRows();
+
+		/// @return Number of stored blocks.
+		int getBlockCount();
+
+	private:
+
+		/// @brief Number of block rows.
+		int rows_;
+
+		/// @brief First block of each row.
+		std::vector<int> rowStart_;
+
+		/// @brief Block column of each block.
+		std::vector<int> col_;
+
+		/// @brief Diagonal block of each row.
+		std::vector<int> diag_;
+
+		/// @brief Block values.
+		std::vector<float> val_;
+	};
+}
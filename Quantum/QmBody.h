@@ -24,6 +24,11 @@ namespace Quantum {
 	 */
 	class QmBody {
 	public:
+		/**
+		 * @brief Virtual destructor, so bodies can be deleted through this class.
+		 */
+		virtual ~QmBody() {}
+
 		/**
 		 * @brief Integrates the motion equations over a given timestep.
 		 *
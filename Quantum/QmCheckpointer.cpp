@@ -0,0 +1,152 @@
+#include "QmCheckpointer.h"
+#include <cstdio>
+#include "QmTrace.h"
+
+using namespace Quantum;
+
+QmCheckpointer::QmCheckpointer(const std::string& prefix, int fullEvery)
+	: prefix_(prefix), fullEvery_(fullEvery < 1 ? 1 : fullEvery), pending_(-1), writing_(-1), stop_(false),
+	sequence_(0), written_(0), skipped_(0), failed_(0), bytes_(0)
+{
+	for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+		hashes_[s] = 0;
+	writer_ = std::thread(&QmCheckpointer::writerLoop, this);
+}
+
+QmCheckpointer::~QmCheckpointer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_one();
+	writer_.join();
+}
+
+bool QmCheckpointer::checkpoint(QmWorld& world)
+{
+	int target;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (pending_ >= 0)
+		{
+			skipped_++;
+			return false;
+		}
+		target = writing_ == 0 ? 1 : 0;
+	}
+	// The writer only touches the pending and writing images, so the copy needs no lock.
+	{
+		QM_TRACE_SCOPE("checkpoint_capture");
+		images_[target].capture(world);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_ = target;
+	}
+	wake_.notify_one();
+	return true;
+}
+
+void QmCheckpointer::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_.wait(lock, [this] { return pending_ < 0 && writing_ < 0; });
+}
+
+void QmCheckpointer::writerLoop()
+{
+	QmTrace::setThreadName("checkpoint writer");
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;)
+	{
+		wake_.wait(lock, [this] { return pending_ >= 0 || stop_; });
+		if (pending_ < 0)
+			return; // stopping with nothing left to write
+		writing_ = pending_;
+		pending_ = -1;
+		lock.unlock();
+		save(images_[writing_]);
+		lock.lock();
+		writing_ = -1;
+		idle_.notify_all();
+	}
+}
+
+void QmCheckpointer::save(const QmWorldImage& image)
+{
+	QM_TRACE_SCOPE("checkpoint_write");
+	char number[32];
+	snprintf(number, sizeof(number), "%08llu", (unsigned long long)((const QmImageParams*)image.getSection(IMAGE_PARAMS))->tickCount);
+	std::string path = prefix_ + number + ".qmw";
+	std::string temp = path + ".tmp";
+
+	// Sections whose content is the same as in the previous file are left to it.
+	bool full = sequence_ % fullEvery_ == 0 || previous_.empty();
+	bool changed[IMAGE_SECTION_COUNT];
+	uint64_t hashes[IMAGE_SECTION_COUNT];
+	unsigned long long bytes = 0;
+	for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+	{
+		hashes[s] = image.hashSection(s);
+		changed[s] = full || s == IMAGE_PARAMS || hashes[s] != hashes_[s];
+		if (changed[s])
+			bytes += image.getCount(s) * QmWorldImage::getElementSize(s);
+	}
+
+	bool ok = full ? image.write(temp.c_str()) : image.write(temp.c_str(), previous_.c_str(), changed);
+	if (ok)
+	{
+		std::remove(path.c_str()); // rename does not replace files on Windows
+		ok = std::rename(temp.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+		std::remove(temp.c_str());
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	sequence_++;
+	if (!ok)
+	{
+		// The next file must not be based on this one.
+		previous_.clear();
+		failed_++;
+		return;
+	}
+	for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+		hashes_[s] = hashes[s];
+	size_t slash = path.find_last_of("/\\");
+	previous_ = slash == std::string::npos ? path : path.substr(slash + 1);
+	written_++;
+	bytes_ += bytes;
+	lastPath_ = path;
+}
+
+unsigned long long QmCheckpointer::getWritten()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return written_;
+}
+
+unsigned long long QmCheckpointer::getSkipped()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return skipped_;
+}
+
+unsigned long long QmCheckpointer::getFailed()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return failed_;
+}
+
+unsigned long long QmCheckpointer::getBytesWritten()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return bytes_;
+}
+
+std::string QmCheckpointer::getLastPath()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return lastPath_;
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "QmWorldImage.h"
+
+namespace Quantum {
+
+	class QmWorld;
+
+	/**
+	 * @class QmCheckpointer
+	 * @brief Writes world images in the background while the world keeps ticking.
+	 *
+	 * checkpoint() copies the world into one of two images (QmWorldImage) and
+	 * returns; a writer thread saves it while the next checkpoint can be taken
+	 * into the other image. When both are busy the checkpoint is skipped rather
+	 * than waited for.
+	 *
+	 * Files are named prefix + tick count + ".qmw". Every fullEvery-th
+	 * file is complete; the others are incremental and only hold the sections
+	 * whose content changed since the previous file, which they name as their
+	 * base. Each file is written under a temporary name and renamed once
+	 * complete, so a crash never leaves a partial checkpoint behind.
+	 */
+	class QmCheckpointer {
+	public:
+
+		/**
+		 * @brief Starts the writer thread.
+		 *
+		 * @param prefix    Path and file name prefix of the checkpoints.
+		 * @param fullEvery A complete file every fullEvery checkpoints; 1 disables incremental files.
+		 */
+		QmCheckpointer(const std::string& prefix, int fullEvery = 16);
+
+		/**
+		 * @brief Writes the pending checkpoint, then stops the writer thread.
+		 */
+		~QmCheckpointer();
+
+		/**
+		 * @brief Copies the state of a world for the writer thread.
+		 *
+		 * Call between ticks, from the thread ticking the world (QmWorld::setCheckpointer
+		 * does it at the end of a tick).
+		 *
+		 * @return False if the checkpoint was skipped because the writer is behind.
+		 */
+		bool checkpoint(QmWorld& world);
+
+		/**
+		 * @brief Waits until every checkpoint taken so far is on disk.
+		 */
+		void flush();
+
+		/**
+		 * @return Number of files written.
+		 */
+		unsigned long long getWritten();
+
+		/**
+		 * @return Number of checkpoints skipped because the writer was behind.
+		 */
+		unsigned long long getSkipped();
+
+		/**
+		 * @return Number of files that could not be written.
+		 */
+		unsigned long long getFailed();
+
+		/**
+		 * @return Bytes of section data written, headers and padding excluded.
+		 */
+		unsigned long long getBytesWritten();
+
+		/**
+		 * @return Path of the last file written, empty if none.
+		 */
+		std::string getLastPath();
+
+	private:
+
+		QmCheckpointer(const QmCheckpointer&);
+		QmCheckpointer& operator=(const QmCheckpointer&);
+
+		/**
+		 * @brief Body of the writer thread.
+		 */
+		void writerLoop();
+
+		/**
+		 * @brief Writes one image, complete or against the previous file.
+		 */
+		void save(const QmWorldImage& image);
+
+		/// @brief Path and file name prefix of the checkpoints.
+		std::string prefix_;
+
+		/// @brief A complete file every fullEvery_ files.
+		int fullEvery_;
+
+		/// @brief The two capture buffers.
+		QmWorldImage images_[2];
+
+		/// @brief Image waiting for the writer, -1 if none.
+		int pending_;
+
+		/// @brief Image being written, -1 if none.
+		int writing_;
+
+		/// @brief Set when the writer must exit once idle.
+		bool stop_;
+
+		/// @brief Protects the fields above and the counters.
+		std::mutex mutex_;
+
+		/// @brief Signals the writer that an image is pending or that it must stop.
+		std::condition_variable wake_;
+
+		/// @brief Signals flush() that the writer went idle.
+		std::condition_variable idle_;
+
+		/// @brief Writer thread, started last.
+		std::thread writer_;
+
+		/// @brief Hash of each section of the previous file (writer thread only).
+		uint64_t hashes_[IMAGE_SECTION_COUNT];
+
+		/// @brief Number of files attempted, to space the complete ones (writer thread only).
+		unsigned long long sequence_;
+
+		/// @brief File name of the previous file, without its directory (writer thread only).
+		std::string previous_;
+
+		unsigned long long written_;
+		unsigned long long skipped_;
+		unsigned long long failed_;
+		unsigned long long bytes_;
+		std::string lastPath_;
+	};
+}
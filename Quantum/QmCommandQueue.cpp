@@ -0,0 +1,55 @@
+#include "QmCommandQueue.h"
+
+using namespace Quantum;
+
+QmCommandQueue::QmCommandQueue(size_t capacity) : enqueue_(0), dequeue_(0)
+{
+	size_t n = 2;
+	while (n < capacity)
+		n *= 2;
+	slots_ = std::vector<Slot>(n);
+	for (size_t i = 0; i < n; i++)
+		slots_[i].seq.store(i, std::memory_order_relaxed);
+	mask_ = n - 1;
+}
+
+QmCommandQueue::~QmCommandQueue() {}
+
+bool QmCommandQueue::push(const QmCommand& c)
+{
+	size_t pos = enqueue_.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Slot& slot = slots_[pos & mask_];
+		size_t seq = slot.seq.load(std::memory_order_acquire);
+		if (seq == pos)
+		{
+			// Slot is free for this position: try to claim it.
+			if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				slot.cmd = c;
+				slot.seq.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (seq < pos)
+		{
+			return false; // full: the consumer has not freed this slot yet
+		}
+		else
+		{
+			pos = enqueue_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool QmCommandQueue::pop(QmCommand& c)
+{
+	Slot& slot = slots_[dequeue_ & mask_];
+	if (slot.seq.load(std::memory_order_acquire) != dequeue_ + 1)
+		return false; // empty, or the producer of this slot has not finished writing
+	c = slot.cmd;
+	slot.seq.store(dequeue_ + mask_ + 1, std::memory_order_release);
+	dequeue_++;
+	return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	class QmParticle;
+	class QmForceGenerator;
+	class QmEmitter;
+
+	/**
+	 * @brief Kind of change carried by a QmCommand.
+	 *
+	 * Except for CMD_SPAWN and CMD_BURST, commands name their particle by
+	 * handle; a handle without a body when the command is applied (removed,
+	 * or never spawned) makes the command a no-op.
+	 */
+	enum QmCommandType {
+		CMD_SPAWN,        ///< Add `particle` to the world with handle `handle` and drag (k1, k2).
+		CMD_REMOVE,       ///< Remove and delete the particle `handle`.
+		CMD_SET_POSITION, ///< Set the position of the particle `handle` to `value`.
+		CMD_SET_VELOCITY, ///< Set the velocity of the particle `handle` to `value`.
+		CMD_SET_CHARGE,   ///< Set the charge of the particle `handle` to `k1`.
+		CMD_ADD_FORCE,    ///< Register `generator` on the particle `handle`.
+		CMD_BURST         ///< Release `handle` particles from `emitter`, spawning them at `value` from now on.
+	};
+
+	/**
+	 * @struct QmCommand
+	 * @brief A deferred change to the world, applied by the simulation thread.
+	 */
+	struct QmCommand {
+		/// @brief Kind of change.
+		QmCommandType type;
+
+		/// @brief Spawned particle (CMD_SPAWN).
+		QmParticle* particle;
+
+		/// @brief Generator to register (CMD_ADD_FORCE).
+		QmForceGenerator* generator;
+
+		/// @brief Emitter to burst (CMD_BURST).
+		QmEmitter* emitter;
+
+		/// @brief Position or velocity.
+		glm::vec3 value;
+
+		/// @brief Charge, or linear drag of a spawned particle.
+		float k1;
+
+		/// @brief Quadratic drag of a spawned particle.
+		float k2;
+
+		/// @brief Handle of the target or spawned particle, or number of particles of a burst.
+		int handle;
+	};
+
+	/**
+	 * @class QmCommandQueue
+	 * @brief Bounded lock-free multi-producer queue of QmCommand.
+	 *
+	 * Each slot carries a sequence number (D. Vyukov's bounded queue):
+	 * producers claim a slot with a compare-and-swap on the enqueue position
+	 * and never wait for the consumer; when the queue is full push() fails
+	 * instead of blocking. The simulation thread is the only consumer.
+	 * Slots are allocated once, so pushing and draining never allocate.
+	 */
+	class QmCommandQueue {
+	public:
+
+		/**
+		 * @brief Constructs a queue.
+		 *
+		 * @param capacity Number of slots, rounded up to a power of two.
+		 */
+		QmCommandQueue(size_t capacity = 4096);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmCommandQueue();
+
+		/**
+		 * @brief Appends a command. Safe from any thread.
+		 *
+		 * @return False if the queue is full.
+		 */
+		bool push(const QmCommand& c);
+
+		/**
+		 * @brief Takes the oldest command. Consumer thread only.
+		 *
+		 * @return False if the queue is empty.
+		 */
+		bool pop(QmCommand& c);
+
+	private:
+
+		/**
+		 * @brief Slot of the ring.
+		 */
+		struct Slot {
+			/// @brief Sequence number telling producers and consumer whose turn it is.
+			std::atomic<size_t> seq;
+			/// @brief Stored command.
+			QmCommand cmd;
+		};
+
+		/// @brief Ring of slots.
+		std::vector<Slot> slots_;
+
+		/// @brief capacity - 1.
+		size_t mask_;
+
+		/// @brief Next position to write.
+		std::atomic<size_t> enqueue_;
+
+		/// @brief Next position to read.
+		size_t dequeue_;
+	};
+}
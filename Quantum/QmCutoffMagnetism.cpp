@@ -0,0 +1,104 @@
+#include "QmCutoffMagnetism.h"
+#include "QmParticle.h"
+#include <algorithm>
+#include <cmath>
+#include "QmThreadPool.h"
+
+using namespace Quantum;
+
+QmCutoffMagnetism::QmCutoffMagnetism(float K, float cutoff, float skin) : k_(K), list_(cutoff, skin) {}
+
+QmCutoffMagnetism::~QmCutoffMagnetism() {}
+
+void QmCutoffMagnetism::update(const std::vector<QmBody*>& bodies, QmThreadPool* pool, int partitions)
+{
+	int count = (int)bodies.size();
+	pos_.resize(count);
+	charge_.resize(count);
+	force_.assign(count, glm::vec3(0));
+	for (int i = 0; i < count; i++)
+	{
+		QmParticle* p = (QmParticle*)bodies[i];
+		pos_[i] = p->getPos();
+		charge_[i] = p->getCharge();
+	}
+
+	list_.update(pos_.data(), count);
+
+	int parts = std::max(1, std::min(partitions, count));
+	if (parts == 1)
+	{
+		accumulate(0, count, force_.data());
+	}
+	else
+	{
+		// Block b only reaches particles j > i >= its first row, so only that
+		// tail of its buffer is cleared and summed.
+		partForce_.resize((size_t)parts * count);
+		auto block = [&](int b) {
+			int begin = (int)((long long)b * count / parts), end = (int)((long long)(b + 1) * count / parts);
+			glm::vec3* f = partForce_.data() + (size_t)b * count;
+			std::fill(f + begin, f + count, glm::vec3(0));
+			accumulate(begin, end, f);
+		};
+		auto reduce = [&](int c) {
+			int begin = (int)((long long)c * count / parts), end = (int)((long long)(c + 1) * count / parts);
+			for (int i = begin; i < end; i++)
+			{
+				glm::vec3 f(0);
+				for (int b = 0; b <= c; b++)
+					f += partForce_[(size_t)b * count + i];
+				force_[i] = f;
+			}
+		};
+		if (pool)
+		{
+			pool->run(parts, block, "cutoff_magnetism");
+			pool->run(parts, reduce, "cutoff_reduce");
+		}
+		else
+		{
+			for (int b = 0; b < parts; b++)
+				block(b);
+			for (int c = 0; c < parts; c++)
+				reduce(c);
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+		if (force_[i] != glm::vec3(0))
+			((QmParticle*)bodies[i])->AddForce(force_[i]);
+}
+
+void QmCutoffMagnetism::accumulate(int begin, int end, glm::vec3* f)
+{
+	float cutoff2 = list_.getCutoff() * list_.getCutoff();
+	for (int i = begin; i < end; i++)
+	{
+		if (charge_[i] == 0.f)
+			continue;
+		glm::vec3 fi(0);
+		for (int k = list_.getStart(i); k < list_.getEnd(i); k++)
+		{
+			int j = list_.getNeighbor(k);
+			glm::vec3 d = pos_[i] - pos_[j];
+			float N2 = glm::dot(d, d);
+			if (N2 >= cutoff2 || N2 == 0.f)
+				continue;
+			glm::vec3 fij = d * (k_ * charge_[i] * charge_[j] / (std::sqrt(N2) * (N2 + 1.f)));
+			fi += fij;
+			f[j] -= fij;
+		}
+		f[i] += fi;
+	}
+}
+
+QmNeighborList& QmCutoffMagnetism::getNeighborList()
+{
+	return list_;
+}
+
+float QmCutoffMagnetism::getK()
+{
+	return k_;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "QmNeighborList.h"
+
+namespace Quantum {
+
+	class QmBody;
+	class QmThreadPool;
+
+	/**
+	 * @class QmCutoffMagnetism
+	 * @brief Short-range magnetism between all particles of the world.
+	 *
+	 * Same law as QmMagnetism, applied to every pair of particles closer than
+	 * the cutoff and ignored beyond it:
+	 *      F_i = K * q_i * q_j * normalize(x_i - x_j) / (|x_i - x_j|^2 + 1),  F_j = -F_i
+	 *
+	 * Pairs are taken from a QmNeighborList, so distant pairs are never visited
+	 * and the spatial search only runs when particles moved more than half
+	 * the skin distance.
+	 */
+	class QmCutoffMagnetism {
+	public:
+
+		/**
+		 * @brief Constructs a cutoff magnetism force.
+		 *
+		 * @param K      Force scaling coefficient.
+		 * @param cutoff Distance beyond which pairs do not interact.
+		 * @param skin   Neighbor list skin distance.
+		 */
+		QmCutoffMagnetism(float K, float cutoff, float skin);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmCutoffMagnetism();
+
+		/**
+		 * @brief Applies the pair forces to the given particles.
+		 *
+		 * With partitions > 1 the rows of the neighbor list are cut into that
+		 * many contiguous blocks, each accumulating into its own force buffer,
+		 * and the buffers are summed in block order. The result then depends
+		 * on the number of partitions only, not on the pool running them.
+		 *
+		 * @param bodies     Particles of the world, in a stable order between ticks.
+		 * @param pool       Threads to use, or NULL.
+		 * @param partitions Number of row blocks, 1 for the serial loop.
+		 */
+		void update(const std::vector<QmBody*>& bodies, QmThreadPool* pool = NULL, int partitions = 1);
+
+		/// @return The neighbor list used to find the pairs.
+		QmNeighborList& getNeighborList();
+
+		/// @return Force scaling coefficient.
+		float getK();
+
+	private:
+
+		/// @brief Force scaling coefficient.
+		float k_;
+
+		/// @brief Pairs in range.
+		QmNeighborList list_;
+
+		/// @brief Scratch positions.
+		std::vector<glm::vec3> pos_;
+
+		/// @brief Scratch charges.
+		std::vector<float> charge_;
+
+		/// @brief Scratch forces.
+		std::vector<glm::vec3> force_;
+
+		/// @brief Force buffer of each partition, [partition * count + i].
+		std::vector<glm::vec3> partForce_;
+
+		/**
+		 * @brief Accumulates the forces of the pairs of rows [begin, end) into f.
+		 */
+		void accumulate(int begin, int end, glm::vec3* f);
+	};
+}
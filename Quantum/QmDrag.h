@@ -41,6 +41,12 @@ namespace Quantum {
          * This overrides the base class method and calculates drag based on velocity.
          */
 		virtual void update(QmParticle* p);
+
+        /// @return Linear drag coefficient.
+		float getK1();
+
+        /// @return Quadratic drag coefficient.
+		float getK2();
 	private:
 
         /**
@@ -0,0 +1,204 @@
+#include "QmEmitter.h"
+#include "QmWorld.h"
+#include "QmTrace.h"
+
+using namespace Quantum;
+
+QmSpawnDistribution::QmSpawnDistribution() : dynamic(true)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		pos[a].min = pos[a].max = 0.f;
+		vel[a].min = vel[a].max = 0.f;
+		acc[a].min = acc[a].max = 0.f;
+	}
+	mass.min = mass.max = 1.f;
+	charge.min = charge.max = 0.f;
+	radius.min = radius.max = 0.2f;
+	linearDrag.min = linearDrag.max = 0.f;
+	quadraticDrag.min = quadraticDrag.max = 0.f;
+}
+
+void QmSpawnDistribution::setPosition(glm::vec3 p)
+{
+	pos[0].min = pos[0].max = p.x;
+	pos[1].min = pos[1].max = p.y;
+	pos[2].min = pos[2].max = p.z;
+}
+
+uint64_t QmSpawnDistribution::next(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+float QmSpawnDistribution::uniform(uint64_t& state, const QmRange& r)
+{
+	if (r.min == r.max)
+		return r.min;
+	return r.min + (r.max - r.min) * (float)(next(state) >> 40) * (1.f / 16777216.f);
+}
+
+void QmSpawnDistribution::draw(uint64_t& state, QmParticle* p, float& K1, float& K2, const glm::vec3* position) const
+{
+	// Components one by one, so that the order of the draws is fixed.
+	float v[9];
+	for (int a = 0; a < 3; a++)
+		v[a] = position ? 0.f : uniform(state, pos[a]);
+	for (int a = 0; a < 3; a++)
+		v[3 + a] = uniform(state, vel[a]);
+	for (int a = 0; a < 3; a++)
+		v[6 + a] = uniform(state, acc[a]);
+	float m = uniform(state, mass);
+	float q = uniform(state, charge);
+	float r = uniform(state, radius);
+	K1 = uniform(state, linearDrag);
+	K2 = uniform(state, quadraticDrag);
+	p->reset(position ? *position : glm::vec3(v[0], v[1], v[2]), glm::vec3(v[3], v[4], v[5]), glm::vec3(v[6], v[7], v[8]), m, q, r, dynamic);
+}
+
+QmEmitter::QmEmitter(const QmSpawnDistribution& spawn, float rate, float lifetime, int capacity, uint64_t seed)
+	: spawn_(spawn), rate_(rate), lifetime_(lifetime), head_(0), alive_(0), firstHandle_(-1), time_(0.f), pending_(0.f),
+	burst_(0), state_(seed), spawned_(0), expired_(0), recycled_(0)
+{
+	if (capacity < 1)
+		capacity = 1;
+	particles_.resize(capacity);
+	for (int k = 0; k < capacity; k++)
+		particles_[k] = new QmParticle();
+	born_.assign(capacity, 0.f);
+}
+
+QmEmitter::~QmEmitter()
+{
+	for (QmParticle* p : particles_)
+		delete p;
+}
+
+QmSpawnDistribution& QmEmitter::getSpawn()
+{
+	return spawn_;
+}
+
+void QmEmitter::setRate(float rate)
+{
+	rate_ = rate;
+}
+
+float QmEmitter::getRate()
+{
+	return rate_;
+}
+
+void QmEmitter::setLifetime(float lifetime)
+{
+	lifetime_ = lifetime;
+}
+
+float QmEmitter::getLifetime()
+{
+	return lifetime_;
+}
+
+void QmEmitter::burst(int count)
+{
+	if (count > 0)
+		burst_ += count;
+}
+
+int QmEmitter::getCapacity()
+{
+	return (int)particles_.size();
+}
+
+int QmEmitter::getAliveCount()
+{
+	return alive_;
+}
+
+int QmEmitter::getFirstHandle()
+{
+	return firstHandle_;
+}
+
+unsigned long long QmEmitter::getSpawned()
+{
+	return spawned_;
+}
+
+unsigned long long QmEmitter::getExpired()
+{
+	return expired_;
+}
+
+unsigned long long QmEmitter::getRecycled()
+{
+	return recycled_;
+}
+
+void QmEmitter::attach(QmWorld& world)
+{
+	int capacity = (int)particles_.size();
+	firstHandle_ = world.nextHandle.fetch_add(capacity);
+	if (firstHandle_ + capacity > (int)world.handleIndex.size())
+		world.handleIndex.resize(firstHandle_ + capacity, -1);
+	head_ = alive_ = 0;
+}
+
+void QmEmitter::kill(QmWorld& world)
+{
+	int capacity = (int)particles_.size();
+	int tail = (head_ - alive_ + capacity) % capacity;
+	world.removeBody(world.handleIndex[firstHandle_ + tail]);
+	alive_--;
+}
+
+void QmEmitter::update(QmWorld& world, float t)
+{
+	int capacity = (int)particles_.size();
+	time_ += t;
+
+	// Slots are released in order, so the oldest expire first.
+	while (alive_ > 0 && lifetime_ > 0.f && time_ - born_[(head_ - alive_ + capacity) % capacity] >= lifetime_)
+	{
+		kill(world);
+		expired_++;
+	}
+
+	pending_ += rate_ * t;
+	int count = (int)pending_;
+	pending_ -= (float)count;
+	count += burst_;
+	burst_ = 0;
+	if (count > capacity)
+		count = capacity; // the ring cannot hold more in one step
+	if (count == 0)
+		return;
+
+	QM_TRACE_SCOPE_ARG("emit", count);
+	for (int i = 0; i < count; i++)
+	{
+		if (alive_ == capacity)
+		{
+			kill(world);
+			recycled_++;
+		}
+		QmParticle* p = particles_[head_];
+		float K1, K2;
+		spawn_.draw(state_, p, K1, K2);
+		world.insertBody(p, firstHandle_ + head_, K1, K2);
+		born_[head_] = time_;
+		head_ = (head_ + 1) % capacity;
+		alive_++;
+	}
+	spawned_ += count;
+}
+
+void QmEmitter::detach(QmWorld& world)
+{
+	while (alive_ > 0)
+		kill(world);
+	firstHandle_ = -1;
+}
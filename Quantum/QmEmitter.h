@@ -0,0 +1,200 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	class QmWorld;
+	class QmParticle;
+
+	/**
+	 * @struct QmRange
+	 * @brief A number drawn uniformly in [min, max].
+	 */
+	struct QmRange {
+		float min, max;
+	};
+
+	/**
+	 * @struct QmSpawnDistribution
+	 * @brief How the initial state of new particles is drawn.
+	 *
+	 * Every component is drawn independently in its range, from a splitmix64
+	 * stream, so the same stream always gives the same particles.
+	 */
+	struct QmSpawnDistribution {
+		QmRange pos[3], vel[3], acc[3];
+		QmRange mass, charge, radius;
+		QmRange linearDrag, quadraticDrag; ///< See QmWorld::AddParticle.
+		bool dynamic;                      ///< Affected by external accelerations.
+
+		/**
+		 * @brief At the origin, at rest, mass 1, no charge, radius 0.2, no drag.
+		 */
+		QmSpawnDistribution();
+
+		/**
+		 * @brief Spawns every particle at pos.
+		 */
+		void setPosition(glm::vec3 pos);
+
+		/**
+		 * @brief Resets p to a state drawn from the distribution.
+		 * @param K1, K2   Receive the drag coefficients.
+		 * @param position If not NULL, used instead of a drawn position.
+		 */
+		void draw(uint64_t& state, QmParticle* p, float& K1, float& K2, const glm::vec3* position = NULL) const;
+
+		/**
+		 * @return The next number of a splitmix64 stream.
+		 */
+		static uint64_t next(uint64_t& state);
+
+		/**
+		 * @return A number drawn in r (24 random bits), r.min without drawing if the range is empty.
+		 */
+		static float uniform(uint64_t& state, const QmRange& r);
+	};
+
+	/**
+	 * @class QmEmitter
+	 * @brief Releases particles at a given rate, each living for a given time.
+	 *
+	 * The particles come from a ring of capacity particles allocated once,
+	 * under capacity handles reserved when the emitter joins a world
+	 * (QmWorld::addEmitter). A particle whose lifetime is over leaves the
+	 * world's body arrays; when a new one is due, the next slot of the ring
+	 * is reset and joins them again under its handle. If the ring is full
+	 * the oldest particle is recycled early. An emitter therefore never
+	 * allocates and never grows the world past its capacity, and each tick
+	 * only costs the particles released and expired.
+	 *
+	 * The world steps its emitters at the start of every tick. QmWorld::DelParticle
+	 * refuses the particles of an emitter. World images
+	 * (QmWorldImage) keep the live particles as plain bodies, not the emitters.
+	 */
+	class QmEmitter {
+	public:
+
+		/**
+		 * @param spawn    Distribution of the released particles.
+		 * @param rate     Particles per second.
+		 * @param lifetime Seconds a particle lives, 0 to live until recycled.
+		 * @param capacity Particles alive at once at most.
+		 * @param seed     Seed of the random stream.
+		 */
+		QmEmitter(const QmSpawnDistribution& spawn, float rate, float lifetime, int capacity, uint64_t seed = 0);
+
+		/**
+		 * @brief Deletes the particles. The emitter must have left its world (QmWorld::clear).
+		 */
+		~QmEmitter();
+
+		/**
+		 * @return The distribution of the particles, which may be changed between ticks.
+		 */
+		QmSpawnDistribution& getSpawn();
+
+		void setRate(float rate);
+		float getRate();
+
+		void setLifetime(float lifetime);
+		float getLifetime();
+
+		/**
+		 * @brief Releases count particles at the next tick, on top of the rate.
+		 */
+		void burst(int count);
+
+		/**
+		 * @return Size of the ring.
+		 */
+		int getCapacity();
+
+		/**
+		 * @return Number of particles in the world.
+		 */
+		int getAliveCount();
+
+		/**
+		 * @return Handle of the first slot (the others follow), -1 before joining a world.
+		 */
+		int getFirstHandle();
+
+		/**
+		 * @return Particles released so far.
+		 */
+		unsigned long long getSpawned();
+
+		/**
+		 * @return Particles that lived their whole lifetime.
+		 */
+		unsigned long long getExpired();
+
+		/**
+		 * @return Particles recycled before the end of their lifetime because the ring was full.
+		 */
+		unsigned long long getRecycled();
+
+	private:
+
+		friend class QmWorld;
+
+		QmEmitter(const QmEmitter&);
+		QmEmitter& operator=(const QmEmitter&);
+
+		/**
+		 * @brief Reserves the handles of the ring in a world.
+		 */
+		void attach(QmWorld& world);
+
+		/**
+		 * @brief Expires and releases the particles of a step.
+		 */
+		void update(QmWorld& world, float t);
+
+		/**
+		 * @brief Takes the live particles out of the world.
+		 */
+		void detach(QmWorld& world);
+
+		/**
+		 * @brief Takes the oldest particle out of the world.
+		 */
+		void kill(QmWorld& world);
+
+		QmSpawnDistribution spawn_;
+		float rate_;
+		float lifetime_;
+
+		/// @brief The ring of particles, owned.
+		std::vector<QmParticle*> particles_;
+
+		/// @brief Emitter time at which each slot was released.
+		std::vector<float> born_;
+
+		/// @brief Next slot to release.
+		int head_;
+
+		/// @brief Particles in the world; they are the alive_ slots before head_.
+		int alive_;
+
+		/// @brief Handle of slot 0, -1 before joining a world.
+		int firstHandle_;
+
+		/// @brief Time stepped so far.
+		float time_;
+
+		/// @brief Fraction of a particle due but not yet released.
+		float pending_;
+
+		/// @brief Particles asked for by burst().
+		int burst_;
+
+		uint64_t state_;
+		unsigned long long spawned_;
+		unsigned long long expired_;
+		unsigned long long recycled_;
+	};
+}
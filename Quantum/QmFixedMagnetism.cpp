@@ -5,10 +5,16 @@ using namespace Quantum;
 QmFixedMagnetism::QmFixedMagnetism(float K, QmParticle* pfix) : k_(K)
 {
 	partfix= pfix;
+	type = FORCE_FIXED_MAGNETISM;
 }
 
 QmFixedMagnetism::~QmFixedMagnetism() {}
 
+float QmFixedMagnetism::getK()
+{
+	return k_;
+}
+
 
 void QmFixedMagnetism::update(QmParticle* p) {
 	glm::vec3 d = p->getPos() - partfix->getPos();
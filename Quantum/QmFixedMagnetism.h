@@ -37,6 +37,9 @@ namespace Quantum {
 		 */
 		virtual void update(QmParticle* p);
 
+		/// @return Force scaling coefficient.
+		float getK();
+
 		/**
 		 * @brief Pointer to the fixed particle generating the force.
 		 */
@@ -7,10 +7,21 @@ QmFixedSpring::QmFixedSpring(float K, int lo, glm::vec3 pos) : k_(K)
 {
 	fix = pos;
 	l_ = lo;
+	type = FORCE_FIXED_SPRING;
 }
 
 QmFixedSpring::~QmFixedSpring() {}
 
+float QmFixedSpring::getRaideur()
+{
+	return k_;
+}
+
+int QmFixedSpring::getRestLength()
+{
+	return l_;
+}
+
 
 void QmFixedSpring::update(QmParticle* p) {
 	glm::vec3 d = p->getPos() - fix;
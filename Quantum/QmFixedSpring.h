@@ -42,6 +42,12 @@ namespace Quantum {
          */
 		virtual void update(QmParticle* p);
 
+        /// @return Spring stiffness.
+		float getRaideur();
+
+        /// @return Rest length of the spring.
+		int getRestLength();
+
         /**
          * @brief Fixed point in space where the spring is anchored.
          */
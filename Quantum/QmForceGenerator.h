@@ -5,6 +5,14 @@ namespace Quantum {
 
 	class QmParticle;
 
+	/// @brief Force generator types, returned by QmForceGenerator::getType().
+	const int FORCE_CUSTOM = 0;
+	const int FORCE_DRAG = 1;
+	const int FORCE_SPRING = 2;
+	const int FORCE_FIXED_SPRING = 3;
+	const int FORCE_MAGNETISM = 4;
+	const int FORCE_FIXED_MAGNETISM = 5;
+
     /**
 	 * @class QmForceGenerator
 	 * @brief Abstract base class for force generators.
@@ -18,6 +26,13 @@ namespace Quantum {
 	 */
 	class QmForceGenerator {
 	public:
+		QmForceGenerator() : type(FORCE_CUSTOM) {}
+
+		/**
+		 * @brief Virtual destructor, so generators can be deleted through this class.
+		 */
+		virtual ~QmForceGenerator() {}
+
 		/**
 		 * @brief Applies a force update to the given particle.
 		 *
@@ -27,6 +42,15 @@ namespace Quantum {
 		 * implement the specific force logic.
 		 */
 		virtual void update(QmParticle* p) {};
+
+		/**
+		 * @return One of the FORCE_* constants, FORCE_CUSTOM for generators defined outside the engine.
+		 */
+		int getType() const { return type; }
+
+	protected:
+		/// @brief Generator type, set by the constructor of each derived class.
+		int type;
 	};
 
 }
\ No newline at end of file
@@ -6,10 +6,16 @@ using namespace Quantum;
 QmMagnetism::QmMagnetism(float K, QmParticle* p) : k_(K) 
 {
 	part = p;
+	type = FORCE_MAGNETISM;
 }
 
 QmMagnetism::~QmMagnetism() {}
 
+float QmMagnetism::getK()
+{
+	return k_;
+}
+
 
 void QmMagnetism::update(QmParticle* p) {
 	glm::vec3 d = p->getPos() - part->getPos();
@@ -40,6 +40,9 @@ namespace Quantum {
 		 */
 		virtual void update(QmParticle* p);
 
+		/// @return Force scaling coefficient.
+		float getK();
+
 		/**
 		 * @brief Reference particle exerting the force.
 		 */
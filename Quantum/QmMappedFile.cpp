@@ -0,0 +1,98 @@
+#include "QmMappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Quantum;
+
+QmMappedFile::QmMappedFile() : data_(NULL), size_(0)
+#ifdef _WIN32
+	, file_(NULL), mapping_(NULL)
+#endif
+{
+}
+
+QmMappedFile::~QmMappedFile()
+{
+	close();
+}
+
+bool QmMappedFile::open(const char* path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	file_ = file;
+	size_ = (size_t)size.QuadPart;
+	if (size_ == 0)
+		return true;
+	mapping_ = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_)
+		data_ = (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (!data_)
+	{
+		close();
+		return false;
+	}
+	return true;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	size_ = (size_t)st.st_size;
+	if (size_ > 0)
+	{
+		void* p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			::close(fd);
+			size_ = 0;
+			return false;
+		}
+		// The file is read front to back by the loaders.
+		madvise(p, size_, MADV_SEQUENTIAL);
+		data_ = (const unsigned char*)p;
+	}
+	::close(fd); // the mapping keeps the file alive
+	return true;
+#endif
+}
+
+void QmMappedFile::close()
+{
+#ifdef _WIN32
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle(mapping_);
+	if (file_)
+		CloseHandle(file_);
+	mapping_ = NULL;
+	file_ = NULL;
+#else
+	if (data_)
+		munmap((void*)data_, size_);
+#endif
+	data_ = NULL;
+	size_ = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+
+namespace Quantum {
+
+	/**
+	 * @class QmMappedFile
+	 * @brief Read-only memory mapping of a whole file.
+	 *
+	 * The pages are read by the system on first access, so opening a large
+	 * file is immediate and data can be copied straight out of the mapping.
+	 */
+	class QmMappedFile {
+	public:
+
+		/**
+		 * @brief Constructs a closed mapping.
+		 */
+		QmMappedFile();
+
+		/**
+		 * @brief Unmaps the file.
+		 */
+		~QmMappedFile();
+
+		/**
+		 * @brief Maps a file, closing the previous one.
+		 * @return False if the file cannot be opened or mapped.
+		 */
+		bool open(const char* path);
+
+		/**
+		 * @brief Unmaps the file.
+		 */
+		void close();
+
+		/**
+		 * @return First byte of the file, NULL when closed or empty.
+		 */
+		const unsigned char* data() const { return data_; }
+
+		/**
+		 * @return Size of the file in bytes.
+		 */
+		size_t size() const { return size_; }
+
+	private:
+
+		QmMappedFile(const QmMappedFile&);
+		QmMappedFile& operator=(const QmMappedFile&);
+
+		/// @brief Mapped bytes.
+		const unsigned char* data_;
+
+		/// @brief Number of mapped bytes.
+		size_t size_;
+
+#ifdef _WIN32
+		/// @brief File and mapping handles.
+		void* file_;
+		void* mapping_;
+#endif
+	};
+}
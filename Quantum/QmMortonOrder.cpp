@@ -0,0 +1,82 @@
+#include "QmMortonOrder.h"
+#include <algorithm>
+
+using namespace Quantum;
+
+namespace {
+
+	/// @brief Inserts two zero bits between the 10 low bits of v.
+	uint32_t spread(uint32_t v)
+	{
+		v &= 0x3FF;
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	/// @brief Cell coordinate of c (in cells from the grid origin), clamped to the grid.
+	uint32_t cell(float c)
+	{
+		if (!(c > 0.f)) // NaN included
+			return 0;
+		return c < 1023.f ? (uint32_t)c : 1023;
+	}
+}
+
+uint32_t QmMortonOrder::encode(uint32_t x, uint32_t y, uint32_t z)
+{
+	return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+const std::vector<int>& QmMortonOrder::sort(const glm::vec3* pos, int count)
+{
+	codes_.resize(count);
+	codesTmp_.resize(count);
+	order_.resize(count);
+	orderTmp_.resize(count);
+	if (count == 0)
+		return order_;
+
+	glm::vec3 lo = pos[0], hi = pos[0];
+	for (int i = 1; i < count; i++)
+	{
+		lo = glm::min(lo, pos[i]);
+		hi = glm::max(hi, pos[i]);
+	}
+	glm::vec3 extent = hi - lo;
+	float side = std::max(extent.x, std::max(extent.y, extent.z));
+	float scale = side > 0.f ? 1024.f / side : 0.f;
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 c = (pos[i] - lo) * scale;
+		codes_[i] = encode(cell(c.x), cell(c.y), cell(c.z));
+		order_[i] = i;
+	}
+
+	const int BITS = 10, BUCKETS = 1 << BITS;
+	buckets_.resize(BUCKETS);
+	for (int shift = 0; shift < 30; shift += BITS)
+	{
+		std::fill(buckets_.begin(), buckets_.end(), 0);
+		for (int i = 0; i < count; i++)
+			buckets_[(codes_[i] >> shift) & (BUCKETS - 1)]++;
+		int sum = 0;
+		for (int b = 0; b < BUCKETS; b++)
+		{
+			int n = buckets_[b];
+			buckets_[b] = sum;
+			sum += n;
+		}
+		for (int i = 0; i < count; i++)
+		{
+			int k = buckets_[(codes_[i] >> shift) & (BUCKETS - 1)]++;
+			codesTmp_[k] = codes_[i];
+			orderTmp_[k] = order_[i];
+		}
+		codes_.swap(codesTmp_);
+		order_.swap(orderTmp_);
+	}
+	return order_;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	/**
+	 * @class QmMortonOrder
+	 * @brief Sorts points along a Morton (Z-order) curve.
+	 *
+	 * Points are quantized to a 1024^3 grid of cubic cells over their
+	 * bounding box, and the code of a point interleaves the bits of its three
+	 * cell coordinates, so points close in space mostly get close codes. The
+	 * codes are sorted by an LSD radix sort of three 10-bit passes: linear in
+	 * the number of points, stable (equal codes keep their input order), and
+	 * free of allocations once the buffers have grown.
+	 */
+	class QmMortonOrder {
+	public:
+
+		/**
+		 * @brief Sorts count points by Morton code.
+		 * @return order, order[k] being the index of the k-th point along the curve.
+		 *         Valid until the next call.
+		 */
+		const std::vector<int>& sort(const glm::vec3* pos, int count);
+
+		/**
+		 * @return The 30-bit Morton code of cell (x, y, z), each coordinate in [0, 1024).
+		 */
+		static uint32_t encode(uint32_t x, uint32_t y, uint32_t z);
+
+	private:
+
+		/// @brief Codes of the points, in input then sorted order.
+		std::vector<uint32_t> codes_, codesTmp_;
+
+		/// @brief Point indices, in sorted order after sort().
+		std::vector<int> order_, orderTmp_;
+
+		/// @brief Bucket offsets of a radix pass.
+		std::vector<int> buckets_;
+	};
+}
@@ -0,0 +1,127 @@
+#include "QmNeighborList.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Quantum;
+
+QmNeighborList::QmNeighborList(float cutoff, float skin) : cutoff_(cutoff), skin_(skin), rebuilds_(0)
+{
+	start_.push_back(0);
+}
+
+QmNeighborList::~QmNeighborList() {}
+
+bool QmNeighborList::update(const glm::vec3* pos, int count)
+{
+	if (!needsRebuild(pos, count))
+		return false;
+	build(pos, count);
+	return true;
+}
+
+bool QmNeighborList::needsRebuild(const glm::vec3* pos, int count)
+{
+	if (count != (int)ref_.size())
+		return true;
+	float limit = 0.25f * skin_ * skin_;
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 d = pos[i] - ref_[i];
+		if (glm::dot(d, d) > limit)
+			return true;
+	}
+	return false;
+}
+
+void QmNeighborList::build(const glm::vec3* pos, int count)
+{
+	rebuilds_++;
+	ref_.assign(pos, pos + count);
+	start_.assign(count + 1, 0);
+	list_.clear();
+	if (count == 0)
+		return;
+
+	// Uniform grid with cells of the list range.
+	float range = cutoff_ + skin_;
+	glm::vec3 lo = pos[0], hi = pos[0];
+	for (int i = 1; i < count; i++)
+	{
+		lo = glm::min(lo, pos[i]);
+		hi = glm::max(hi, pos[i]);
+	}
+	float cell = range;
+	int nx, ny, nz;
+	for (;;)
+	{
+		nx = (int)((hi.x - lo.x) / cell) + 1;
+		ny = (int)((hi.y - lo.y) / cell) + 1;
+		nz = (int)((hi.z - lo.z) / cell) + 1;
+		// Keep the grid proportional to the number of points for sparse worlds.
+		if ((double)nx * ny * nz <= 4.0 * count + 64)
+			break;
+		cell *= 2.f;
+	}
+	int cells = nx * ny * nz;
+
+	// Counting sort of the points by cell.
+	cellOf_.resize(count);
+	cellStart_.assign(cells + 1, 0);
+	for (int i = 0; i < count; i++)
+	{
+		int cx = std::min((int)((pos[i].x - lo.x) / cell), nx - 1);
+		int cy = std::min((int)((pos[i].y - lo.y) / cell), ny - 1);
+		int cz = std::min((int)((pos[i].z - lo.z) / cell), nz - 1);
+		cellOf_[i] = (cz * ny + cy) * nx + cx;
+		cellStart_[cellOf_[i] + 1]++;
+	}
+	for (int c = 0; c < cells; c++)
+		cellStart_[c + 1] += cellStart_[c];
+	sorted_.resize(count);
+	fill_.assign(cellStart_.begin(), cellStart_.end() - 1);
+	for (int i = 0; i < count; i++)
+		sorted_[fill_[cellOf_[i]]++] = i;
+
+	float range2 = range * range;
+	for (int i = 0; i < count; i++)
+	{
+		int c = cellOf_[i];
+		int cx = c % nx, cy = (c / nx) % ny, cz = c / (nx * ny);
+		for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, nz - 1); z++)
+			for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, ny - 1); y++)
+				for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, nx - 1); x++)
+				{
+					int n = (z * ny + y) * nx + x;
+					for (int k = cellStart_[n]; k < cellStart_[n + 1]; k++)
+					{
+						int j = sorted_[k];
+						if (j <= i)
+							continue;
+						glm::vec3 d = pos[i] - pos[j];
+						if (glm::dot(d, d) < range2)
+							list_.push_back(j);
+					}
+				}
+		start_[i + 1] = (int)list_.size();
+	}
+}
+
+int QmNeighborList::getPairCount()
+{
+	return (int)list_.size();
+}
+
+int QmNeighborList::getRebuildCount()
+{
+	return rebuilds_;
+}
+
+float QmNeighborList::getCutoff()
+{
+	return cutoff_;
+}
+
+float QmNeighborList::getSkin()
+{
+	return skin_;
+}
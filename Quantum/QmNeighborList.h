@@ -0,0 +1,109 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	/**
+	 * @class QmNeighborList
+	 * @brief Verlet neighbor list for short-range pair forces.
+	 *
+	 * The list stores, for every point i, the points j > i closer than
+	 * cutoff + skin (half list, so every pair appears once). It is built with
+	 * a uniform grid of cell size cutoff + skin and is only rebuilt when some
+	 * point has moved more than skin / 2 since the last build, or when the
+	 * number of points changed. Between rebuilds no pair closer than the
+	 * cutoff can be missing from the list.
+	 *
+	 * Neighbors are stored in compressed form: the neighbors of i are
+	 * getNeighbor(k) for k in [getStart(i), getEnd(i)).
+	 */
+	class QmNeighborList {
+	public:
+
+		/**
+		 * @brief Constructs an empty neighbor list.
+		 *
+		 * @param cutoff Interaction range of the pair force.
+		 * @param skin   Extra distance kept in the list to delay rebuilds.
+		 */
+		QmNeighborList(float cutoff, float skin);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmNeighborList();
+
+		/**
+		 * @brief Rebuilds the list if it may be out of date.
+		 *
+		 * @param pos   Point positions.
+		 * @param count Number of points.
+		 * @return True if the list was rebuilt.
+		 */
+		bool update(const glm::vec3* pos, int count);
+
+		/**
+		 * @brief Tests whether some point moved more than skin / 2 since the last build.
+		 */
+		bool needsRebuild(const glm::vec3* pos, int count);
+
+		/**
+		 * @brief Rebuilds the list unconditionally.
+		 */
+		void build(const glm::vec3* pos, int count);
+
+		/// @return Index of the first neighbor entry of point i.
+		int getStart(int i) { return start_[i]; }
+
+		/// @return Index past the last neighbor entry of point i.
+		int getEnd(int i) { return start_[i + 1]; }
+
+		/// @return Point stored at neighbor entry k.
+		int getNeighbor(int k) { return list_[k]; }
+
+		/// @return Total number of stored pairs.
+		int getPairCount();
+
+		/// @return Number of rebuilds since construction.
+		int getRebuildCount();
+
+		/// @return Interaction range.
+		float getCutoff();
+
+		/// @return Skin distance.
+		float getSkin();
+
+	private:
+
+		/// @brief Interaction range.
+		float cutoff_;
+
+		/// @brief Extra list distance.
+		float skin_;
+
+		/// @brief Positions at the last build.
+		std::vector<glm::vec3> ref_;
+
+		/// @brief First neighbor entry of each point (size count + 1).
+		std::vector<int> start_;
+
+		/// @brief Neighbor indices.
+		std::vector<int> list_;
+
+		/// @brief Grid cell of each point.
+		std::vector<int> cellOf_;
+
+		/// @brief First sorted point of each grid cell (size cells + 1).
+		std::vector<int> cellStart_;
+
+		/// @brief Points sorted by grid cell.
+		std::vector<int> sorted_;
+
+		/// @brief Insertion cursor of each cell during the sort.
+		std::vector<int> fill_;
+
+		/// @brief Number of rebuilds.
+		int rebuilds_;
+	};
+}
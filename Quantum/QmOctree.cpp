@@ -0,0 +1,344 @@
+#include "QmOctree.h"
+#include <algorithm>
+#include <cmath>
+#include "QmThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QM_OCTREE_SSE
+#endif
+
+using namespace Quantum;
+
+static const int MAX_DEPTH = 24;
+
+/**
+ * @brief Distance from c to the farthest corner of the cell (center, half).
+ */
+static float farthestCorner(glm::vec3 c, glm::vec3 center, float half)
+{
+	glm::vec3 d = glm::abs(c - center) + glm::vec3(half);
+	return glm::length(d);
+}
+
+/**
+ * @brief Whether |a - b| <= r on every axis (cells of half sizes summing to r overlap, or a point is inside).
+ */
+static bool within(glm::vec3 a, glm::vec3 b, float r)
+{
+	glm::vec3 d = glm::abs(a - b);
+	return d.x <= r && d.y <= r && d.z <= r;
+}
+
+QmOctree::QmOctree(int leafSize, int maxDepth) : leafSize_(std::max(1, leafSize)), maxDepth_(std::min(maxDepth, MAX_DEPTH)) {}
+
+QmOctree::~QmOctree() {}
+
+void QmOctree::build(const glm::vec3* pos, const float* charge, int count)
+{
+	nodes_.clear();
+	pos_.assign(pos, pos + count);
+	charge_.assign(charge, charge + count);
+	index_.resize(count);
+	scratch_.resize(count);
+	for (int i = 0; i < count; i++)
+		index_[i] = i;
+
+	// Bounding cube of all points.
+	glm::vec3 lo(0), hi(0);
+	if (count > 0)
+	{
+		lo = hi = pos[0];
+		for (int i = 1; i < count; i++)
+		{
+			lo = glm::min(lo, pos[i]);
+			hi = glm::max(hi, pos[i]);
+		}
+	}
+	glm::vec3 ext = hi - lo;
+	float half = 0.5f * std::max(ext.x, std::max(ext.y, ext.z)) + 1e-3f;
+
+	Node root;
+	root.center = 0.5f * (lo + hi);
+	root.halfSize = half;
+	root.start = 0;
+	root.count = count;
+	root.firstChild = -1;
+	nodes_.push_back(root);
+	split(0, 0);
+}
+
+void QmOctree::split(int id, int depth)
+{
+	Node node = nodes_[id];
+
+	if (node.count <= leafSize_ || depth >= maxDepth_)
+	{
+		float q[2] = { 0.f, 0.f };
+		glm::vec3 c[2] = { glm::vec3(0), glm::vec3(0) };
+		for (int k = node.start; k < node.start + node.count; k++)
+		{
+			int i = index_[k];
+			int s = charge_[i] < 0.f;
+			q[s] += charge_[i];
+			c[s] += std::fabs(charge_[i]) * pos_[i];
+		}
+		setCharges(id, q, c);
+		return;
+	}
+
+	// Counting sort of the cell's points into the 8 octants.
+	int counts[8] = { 0 };
+	for (int k = node.start; k < node.start + node.count; k++)
+	{
+		const glm::vec3& p = pos_[index_[k]];
+		int o = (p.x >= node.center.x) | ((p.y >= node.center.y) << 1) | ((p.z >= node.center.z) << 2);
+		counts[o]++;
+	}
+	int offsets[8];
+	offsets[0] = node.start;
+	for (int o = 1; o < 8; o++)
+		offsets[o] = offsets[o - 1] + counts[o - 1];
+	int fill[8];
+	std::copy(offsets, offsets + 8, fill);
+	for (int k = node.start; k < node.start + node.count; k++)
+	{
+		const glm::vec3& p = pos_[index_[k]];
+		int o = (p.x >= node.center.x) | ((p.y >= node.center.y) << 1) | ((p.z >= node.center.z) << 2);
+		scratch_[fill[o]++] = index_[k];
+	}
+	std::copy(scratch_.begin() + node.start, scratch_.begin() + node.start + node.count, index_.begin() + node.start);
+
+	int first = (int)nodes_.size();
+	float h = 0.5f * node.halfSize;
+	for (int o = 0; o < 8; o++)
+	{
+		Node child;
+		child.center = node.center + glm::vec3((o & 1) ? h : -h, (o & 2) ? h : -h, (o & 4) ? h : -h);
+		child.halfSize = h;
+		child.start = offsets[o];
+		child.count = counts[o];
+		child.firstChild = -1;
+		nodes_.push_back(child);
+	}
+	nodes_[id].firstChild = first;
+
+	float q[2] = { 0.f, 0.f };
+	glm::vec3 c[2] = { glm::vec3(0), glm::vec3(0) };
+	for (int o = 0; o < 8; o++)
+	{
+		split(first + o, depth + 1);
+		const Node& child = nodes_[first + o];
+		for (int s = 0; s < 2; s++)
+		{
+			q[s] += child.charge[s];
+			c[s] += std::fabs(child.charge[s]) * child.chargeCenter[s];
+		}
+	}
+	setCharges(id, q, c);
+}
+
+void QmOctree::setCharges(int id, const float* q, const glm::vec3* weighted)
+{
+	Node& node = nodes_[id];
+	node.absCharge = std::fabs(q[0]) + std::fabs(q[1]);
+	for (int s = 0; s < 2; s++)
+	{
+		node.charge[s] = q[s];
+		node.chargeCenter[s] = q[s] != 0.f ? weighted[s] / std::fabs(q[s]) : node.center;
+		node.bmax[s] = farthestCorner(node.chargeCenter[s], node.center, node.halfSize);
+	}
+}
+
+bool QmOctree::accept(const Node& node, glm::vec3 d0, glm::vec3 d1, float theta2)
+{
+	return (node.charge[0] == 0.f || node.bmax[0] * node.bmax[0] < theta2 * glm::dot(d0, d0))
+		&& (node.charge[1] == 0.f || node.bmax[1] * node.bmax[1] < theta2 * glm::dot(d1, d1));
+}
+
+glm::vec3 QmOctree::field(glm::vec3 x, int self, float theta)
+{
+	glm::vec3 E(0);
+	if (nodes_.empty())
+		return E;
+
+	int stack[8 * (MAX_DEPTH + 1)];
+	int top = 0;
+	stack[top++] = 0;
+	float theta2 = theta * theta;
+
+	while (top > 0)
+	{
+		const Node& node = nodes_[stack[--top]];
+		if (node.absCharge == 0.f)
+			continue;
+
+		if (node.firstChild < 0)
+		{
+			for (int k = node.start; k < node.start + node.count; k++)
+			{
+				int j = index_[k];
+				if (j == self)
+					continue;
+				glm::vec3 d = x - pos_[j];
+				float N2 = glm::dot(d, d);
+				if (N2 > 0.f)
+					E += d * (charge_[j] / (std::sqrt(N2) * (N2 + 1.f)));
+			}
+			continue;
+		}
+
+		glm::vec3 d[2] = { x - node.chargeCenter[0], x - node.chargeCenter[1] };
+		if (!within(x, node.center, node.halfSize) && accept(node, d[0], d[1], theta2))
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				float N2 = glm::dot(d[s], d[s]);
+				if (node.charge[s] != 0.f && N2 > 0.f)
+					E += d[s] * (node.charge[s] / (std::sqrt(N2) * (N2 + 1.f)));
+			}
+		}
+		else
+		{
+			for (int o = 0; o < 8; o++)
+				stack[top++] = node.firstChild + o;
+		}
+	}
+	return E;
+}
+
+void QmOctree::evaluate(float theta, glm::vec3* out, QmThreadPool* pool)
+{
+	if (nodes_.empty())
+		return;
+
+	leaves_.clear();
+	for (size_t id = 0; id < nodes_.size(); id++)
+		if (nodes_[id].firstChild < 0 && nodes_[id].count > 0)
+			leaves_.push_back((int)id);
+
+	float theta2 = theta * theta;
+	int tasks = pool ? std::min((int)leaves_.size(), 4 * pool->getThreadCount()) : 1;
+	if ((int)sources_.size() < tasks)
+		sources_.resize(tasks);
+	if (tasks <= 1)
+	{
+		for (int leafId : leaves_)
+			evaluateLeaf(leafId, theta2, out, sources_[0]);
+		return;
+	}
+	int leafCount = (int)leaves_.size();
+	pool->run(tasks, [&](int t) {
+		for (int k = t * leafCount / tasks; k < (t + 1) * leafCount / tasks; k++)
+			evaluateLeaf(leaves_[k], theta2, out, sources_[t]);
+	}, "octree");
+}
+
+void QmOctree::evaluateLeaf(int leafId, float theta2, glm::vec3* out, Sources& src)
+{
+	const Node& leaf = nodes_[leafId];
+	int stack[8 * (MAX_DEPTH + 1)];
+
+	// Interaction list of the whole leaf cell. The leaf's own points are
+	// included: a point sees itself at distance 0 and gets no contribution.
+	src.x.clear(); src.y.clear(); src.z.clear(); src.q.clear();
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes_[stack[--top]];
+		if (node.absCharge == 0.f)
+			continue;
+
+		if (node.firstChild < 0)
+		{
+			for (int k = node.start; k < node.start + node.count; k++)
+			{
+				int j = index_[k];
+				src.x.push_back(pos_[j].x);
+				src.y.push_back(pos_[j].y);
+				src.z.push_back(pos_[j].z);
+				src.q.push_back(charge_[j]);
+			}
+			continue;
+		}
+
+		// Distance from the center of charge to the leaf cell; ancestors of the
+		// leaf (and any cell overlapping it) are never approximated.
+		glm::vec3 d[2];
+		for (int s = 0; s < 2; s++)
+			d[s] = glm::max(glm::abs(node.chargeCenter[s] - leaf.center) - glm::vec3(leaf.halfSize), glm::vec3(0));
+		if (!within(node.center, leaf.center, node.halfSize + leaf.halfSize) && accept(node, d[0], d[1], theta2))
+		{
+			for (int s = 0; s < 2; s++)
+				if (node.charge[s] != 0.f)
+				{
+					src.x.push_back(node.chargeCenter[s].x);
+					src.y.push_back(node.chargeCenter[s].y);
+					src.z.push_back(node.chargeCenter[s].z);
+					src.q.push_back(node.charge[s]);
+				}
+		}
+		else
+		{
+			for (int o = 0; o < 8; o++)
+				stack[top++] = node.firstChild + o;
+		}
+	}
+
+	// Pad to a multiple of 4 with null charges.
+	while (src.q.size() % 4 != 0)
+	{
+		src.x.push_back(0.f); src.y.push_back(0.f); src.z.push_back(0.f); src.q.push_back(0.f);
+	}
+
+	const int sourceCount = (int)src.q.size();
+	const float* sx = src.x.data();
+	const float* sy = src.y.data();
+	const float* sz = src.z.data();
+	const float* sq = src.q.data();
+	for (int k = leaf.start; k < leaf.start + leaf.count; k++)
+	{
+		int i = index_[k];
+		glm::vec3 x = pos_[i];
+		float ex = 0.f, ey = 0.f, ez = 0.f;
+		// N2 is clamped away from 0 so that coincident sources give d * c = 0.
+#ifdef QM_OCTREE_SSE
+		const __m128 tiny = _mm_set1_ps(1e-30f);
+		const __m128 one = _mm_set1_ps(1.f);
+		__m128 vx = _mm_set1_ps(x.x), vy = _mm_set1_ps(x.y), vz = _mm_set1_ps(x.z);
+		__m128 ax = _mm_setzero_ps(), ay = _mm_setzero_ps(), az = _mm_setzero_ps();
+		for (int s = 0; s < sourceCount; s += 4)
+		{
+			__m128 dx = _mm_sub_ps(vx, _mm_loadu_ps(sx + s));
+			__m128 dy = _mm_sub_ps(vy, _mm_loadu_ps(sy + s));
+			__m128 dz = _mm_sub_ps(vz, _mm_loadu_ps(sz + s));
+			__m128 N2 = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)), tiny);
+			__m128 c = _mm_div_ps(_mm_loadu_ps(sq + s), _mm_mul_ps(_mm_sqrt_ps(N2), _mm_add_ps(N2, one)));
+			ax = _mm_add_ps(ax, _mm_mul_ps(dx, c));
+			ay = _mm_add_ps(ay, _mm_mul_ps(dy, c));
+			az = _mm_add_ps(az, _mm_mul_ps(dz, c));
+		}
+		float lane[4];
+		_mm_storeu_ps(lane, ax); ex = lane[0] + lane[1] + lane[2] + lane[3];
+		_mm_storeu_ps(lane, ay); ey = lane[0] + lane[1] + lane[2] + lane[3];
+		_mm_storeu_ps(lane, az); ez = lane[0] + lane[1] + lane[2] + lane[3];
+#else
+		for (int s = 0; s < sourceCount; s++)
+		{
+			float dx = x.x - sx[s];
+			float dy = x.y - sy[s];
+			float dz = x.z - sz[s];
+			float N2 = std::max(dx * dx + dy * dy + dz * dz, 1e-30f);
+			float c = sq[s] / (std::sqrt(N2) * (N2 + 1.f));
+			ex += dx * c; ey += dy * c; ez += dz * c;
+		}
+#endif
+		out[i] = glm::vec3(ex, ey, ez);
+	}
+}
+
+int QmOctree::getNodeCount()
+{
+	return (int)nodes_.size();
+}
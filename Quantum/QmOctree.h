@@ -0,0 +1,168 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	class QmThreadPool;
+
+	/**
+	 * @class QmOctree
+	 * @brief Barnes-Hut octree over charged points.
+	 *
+	 * The tree is rebuilt from scratch every tick. Each node stores its
+	 * positive and its negative charge, each with its own center of charge:
+	 * with charges of both signs the net charge of a node mostly cancels and
+	 * its field is dominated by the dipole between the two centers, which a
+	 * single monopole would miss. A node is approximated by these two point
+	 * charges when bmax / distance < theta for both, bmax being the distance
+	 * from the center to the farthest corner of the cell, so every source of
+	 * the node lies within bmax of its point charge; a node whose cell
+	 * contains the evaluation point (or overlaps the evaluated leaf) is always
+	 * opened. Near leaves are summed exactly.
+	 *
+	 * The interaction law is the one of QmMagnetism:
+	 *      E(x) = sum_j q_j * normalize(x - x_j) / (|x - x_j|^2 + 1)
+	 * so the force on a charge q at x is K * q * E(x).
+	 *
+	 * Nodes live in a flat array and children of a node are contiguous, so the
+	 * storage is reused from one tick to the next without reallocation.
+	 */
+	class QmOctree {
+	public:
+
+		/**
+		 * @brief Constructs an empty tree.
+		 *
+		 * @param leafSize Maximum number of points stored in a leaf.
+		 * @param maxDepth Maximum subdivision depth (at most 24).
+		 */
+		QmOctree(int leafSize = 16, int maxDepth = 20);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmOctree();
+
+		/**
+		 * @brief Builds the tree over a set of charged points.
+		 *
+		 * @param pos    Point positions.
+		 * @param charge Point charges.
+		 * @param count  Number of points.
+		 */
+		void build(const glm::vec3* pos, const float* charge, int count);
+
+		/**
+		 * @brief Evaluates the field at a point.
+		 *
+		 * @param x     Evaluation point.
+		 * @param self  Index of the point at x (excluded from the sum), or -1.
+		 * @param theta Opening angle: a node is approximated when bmax / distance < theta.
+		 * @return Field at x (multiply by K * q to get the force).
+		 *
+		 * The tree is only read, so several threads may call field() at once.
+		 */
+		glm::vec3 field(glm::vec3 x, int self, float theta);
+
+		/**
+		 * @brief Evaluates the field at every point of the last build.
+		 *
+		 * Points of a leaf share one tree walk: the opening criterion is tested
+		 * against the whole leaf cell, and the resulting list of far nodes and
+		 * near points is then applied to each point of the leaf.
+		 *
+		 * Leaves are independent: with a pool they are spread over the threads,
+		 * and every point gets the same result whatever the number of threads.
+		 *
+		 * @param theta Opening angle.
+		 * @param out   Receives the field of point i at out[i].
+		 * @param pool  Threads to use, or NULL.
+		 */
+		void evaluate(float theta, glm::vec3* out, QmThreadPool* pool = NULL);
+
+		/// @return Number of nodes of the last build.
+		int getNodeCount();
+
+	private:
+
+		/**
+		 * @brief Node of the tree.
+		 */
+		struct Node {
+			/// @brief Geometric center of the cell.
+			glm::vec3 center;
+			/// @brief Half of the cell edge length.
+			float halfSize;
+			/// @brief Positive (0) and negative (1) charge of the cell.
+			float charge[2];
+			/// @brief Center of the charge of each sign.
+			glm::vec3 chargeCenter[2];
+			/// @brief Distance from each chargeCenter to the farthest corner of the cell.
+			float bmax[2];
+			/// @brief Sum of |q| of the cell (0 means nothing to evaluate).
+			float absCharge;
+			/// @brief Index of the first of the 8 children, -1 for a leaf.
+			int firstChild;
+			/// @brief First point of the cell in index_.
+			int start;
+			/// @brief Number of points in the cell.
+			int count;
+		};
+
+		/**
+		 * @brief Interaction list of a leaf (far nodes and near points), SoA.
+		 */
+		struct Sources {
+			std::vector<float> x, y, z, q;
+		};
+
+		/**
+		 * @brief Subdivides a node and computes its aggregates.
+		 */
+		void split(int id, int depth);
+
+		/**
+		 * @brief Sets the charges of a node from the sum of q and of |q| * x of each sign.
+		 */
+		void setCharges(int id, const float* q, const glm::vec3* weighted);
+
+		/**
+		 * @brief Whether a node may be replaced by its two point charges, d0 and d1 being
+		 *        the distances from their centers to the evaluation point or leaf.
+		 */
+		static bool accept(const Node& node, glm::vec3 d0, glm::vec3 d1, float theta2);
+
+		/**
+		 * @brief Evaluates the field at the points of one leaf.
+		 */
+		void evaluateLeaf(int leafId, float theta2, glm::vec3* out, Sources& src);
+
+		/// @brief Flat node storage, root at 0.
+		std::vector<Node> nodes_;
+
+		/// @brief Point indices, grouped by cell.
+		std::vector<int> index_;
+
+		/// @brief Scratch buffer used when partitioning a cell.
+		std::vector<int> scratch_;
+
+		/// @brief Copy of the point positions.
+		std::vector<glm::vec3> pos_;
+
+		/// @brief Copy of the point charges.
+		std::vector<float> charge_;
+
+		/// @brief Leaves of the last build.
+		std::vector<int> leaves_;
+
+		/// @brief Interaction list scratch, one per evaluation task.
+		std::vector<Sources> sources_;
+
+		/// @brief Maximum number of points in a leaf.
+		int leafSize_;
+
+		/// @brief Maximum subdivision depth.
+		int maxDepth_;
+	};
+}
@@ -0,0 +1,107 @@
+#include "QmPackedAABBs.h"
+#include "QmBody.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QM_PACKED_SSE
+#endif
+
+using namespace Quantum;
+
+namespace {
+
+	const float RANGE = 32767.f;
+
+	/// @brief Clamps a quantized coordinate to [0, 32767] (NaN to 0).
+	int16_t clampLane(float q)
+	{
+		if (!(q > 0.f))
+			return 0;
+		return q < RANGE ? (int16_t)q : (int16_t)RANGE;
+	}
+}
+
+QmPackedAABBs::QmPackedAABBs() {}
+
+void QmPackedAABBs::pack(const std::vector<QmBody*>& bodies)
+{
+	// Room for the bodies reserved, so that a growing world does not reallocate.
+	int count = (int)bodies.size();
+	boxes_.reserve(bodies.capacity());
+	corners_.reserve(2 * bodies.capacity());
+	boxes_.resize(count);
+	corners_.resize(2 * count);
+	if (count == 0)
+		return;
+
+	glm::vec3 lo = bodies[0]->getAABB().getMin(), hi = lo;
+	for (int i = 0; i < count; i++)
+	{
+		AABB box = bodies[i]->getAABB();
+		corners_[2 * i] = box.getMin();
+		corners_[2 * i + 1] = box.getMax();
+		lo = glm::min(lo, corners_[2 * i]);
+		hi = glm::max(hi, corners_[2 * i + 1]);
+	}
+
+	// Same mapping for both corners: floor of the min, ceil of the max.
+	glm::vec3 scale;
+	for (int a = 0; a < 3; a++)
+	{
+		float extent = hi[a] - lo[a];
+		scale[a] = extent > 0.f && std::isfinite(extent) ? RANGE / extent : 0.f;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 qmin = (corners_[2 * i] - lo) * scale;
+		glm::vec3 qmax = (corners_[2 * i + 1] - lo) * scale;
+		Box& b = boxes_[i];
+		for (int a = 0; a < 3; a++)
+		{
+			b.lane[a] = clampLane(std::floor(qmin[a]));
+			b.lane[4 + a] = (int16_t)-clampLane(std::ceil(qmax[a]));
+		}
+		b.lane[3] = b.lane[7] = 0;
+	}
+}
+
+int QmPackedAABBs::size() const
+{
+	return (int)boxes_.size();
+}
+
+bool QmPackedAABBs::mayOverlap(int i, int j) const
+{
+	const int16_t* a = boxes_[i].lane;
+	const int16_t* b = boxes_[j].lane;
+	for (int k = 0; k < 3; k++)
+		if (b[k] > -a[4 + k] || b[4 + k] > -a[k])
+			return false;
+	return true;
+}
+
+int QmPackedAABBs::query(int i, int begin, int end, int* out) const
+{
+	const Box* boxes = boxes_.data();
+	int n = 0;
+#ifdef QM_PACKED_SSE
+	// Query (max, 0, -min, 0) = -(box with its halves swapped); a box is a
+	// candidate when none of its lanes exceeds the query.
+	__m128i box = _mm_load_si128((const __m128i*)&boxes[i]);
+	__m128i q = _mm_sub_epi16(_mm_setzero_si128(), _mm_shuffle_epi32(box, _MM_SHUFFLE(1, 0, 3, 2)));
+	for (int j = begin; j < end; j++)
+	{
+		out[n] = j;
+		n += _mm_movemask_epi8(_mm_cmpgt_epi16(_mm_load_si128((const __m128i*)&boxes[j]), q)) == 0;
+	}
+#else
+	for (int j = begin; j < end; j++)
+	{
+		out[n] = j;
+		n += mayOverlap(i, j);
+	}
+#endif
+	return n;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	class QmBody;
+
+	/**
+	 * @class QmPackedAABBs
+	 * @brief The bounding boxes of a set of bodies, quantized to 16 bits, for the broadphase.
+	 *
+	 * Each box is stored in 16 bytes (four per cache line) instead of being
+	 * read out of its body: its corners are mapped to [0, 32767] on each axis
+	 * of the bounding box of all the boxes, the minimum rounded down and the
+	 * maximum rounded up. The mapping is monotonic, so boxes that overlap in
+	 * floats always overlap once quantized; the converse does not hold, and
+	 * candidates must be confirmed on the exact boxes.
+	 *
+	 * A box is kept as (min x, y, z, 0, -max x, y, z, 0): box j may overlap
+	 * box i when every lane of j is at most the matching lane of
+	 * (max_i, 0, -min_i, 0), which is one 8-lane integer comparison (SSE2).
+	 */
+	class QmPackedAABBs {
+	public:
+
+		QmPackedAABBs();
+
+		/**
+		 * @brief Quantizes the boxes of bodies, in order.
+		 */
+		void pack(const std::vector<QmBody*>& bodies);
+
+		/// @return Number of boxes packed.
+		int size() const;
+
+		/**
+		 * @return False only if boxes i and j do not overlap.
+		 */
+		bool mayOverlap(int i, int j) const;
+
+		/**
+		 * @brief Finds the boxes of [begin, end) that may overlap box i.
+		 *
+		 * Querying a range at a time keeps the output buffer small whatever
+		 * the number of boxes.
+		 *
+		 * @param out Receives their indices in increasing order; room for end - begin indices.
+		 * @return Number of indices written.
+		 */
+		int query(int i, int begin, int end, int* out) const;
+
+	private:
+
+		struct alignas(16) Box {
+			int16_t lane[8];
+		};
+
+		/// @brief Quantized boxes, in body order.
+		std::vector<Box> boxes_;
+
+		/// @brief Scratch float corners (min, max) of the boxes.
+		std::vector<glm::vec3> corners_;
+	};
+}
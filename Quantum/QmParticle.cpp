@@ -5,11 +5,16 @@
 
 using namespace Quantum;
 
-QmParticle::QmParticle() : position(0, 0, 0), velocity(0, 0, 0), acceleration(0, 0, 0)
+QmParticle::QmParticle() : updater(NULL), position(0, 0, 0), velocity(0, 0, 0), acceleration(0, 0, 0), forceAccumulateur(0, 0, 0)
 {
 }
 
 QmParticle::QmParticle(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float masse, float charge, float rad, bool isacc) : QmParticle()
+{
+	reset(pos, vel, acc, masse, charge, rad, isacc);
+}
+
+void QmParticle::reset(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float masse, float charge, float rad, bool isacc)
 {
 	position = pos;
 	velocity = vel;
@@ -21,6 +26,7 @@ QmParticle::QmParticle(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float masse,
 	e = charge;
 	radius = rad;
 	isAcc = isacc;
+	forceAccumulateur = glm::vec3(0, 0, 0);
 	setAABB();
 	damping = 0.995f;
 	type = TYPE_PARTICLE;
@@ -134,12 +140,17 @@ void QmParticle::setPos(glm::vec3 pos)
 
 }
 
-void QmParticle::setCharge(int charge)
+void QmParticle::setCharge(float charge)
 {
 	e = charge;
 
 }
 
+void QmParticle::setInvMass(float invMass)
+{
+	this->invMass = invMass;
+}
+
 void QmParticle::setAABB()
 {
 	glm::vec3 min = glm::vec3(getPos().x - radius*sqrt(3), getPos().y - radius * sqrt(3), getPos().z - radius * sqrt(3));
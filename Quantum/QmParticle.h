@@ -49,9 +49,16 @@ namespace Quantum {
 		QmParticle(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float masse, float charge, float rad, bool isacc);
 
 		/**
-		 * @brief Destructor.
+		 * @brief Gives the particle a new initial state, as the constructor does.
+		 *
+		 * Lets a particle be reused (see QmEmitter) instead of deleted and allocated again.
+		 */
+		void reset(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float masse, float charge, float rad, bool isacc);
+
+		/**
+		 * @brief Destructor. Deletes the updater.
 		 */
-		~QmParticle();
+		virtual ~QmParticle();
 
 		/**
 		 * @brief Integrates the particles motion over time.
@@ -105,12 +112,20 @@ namespace Quantum {
 		void setPos(glm::vec3 pos);
 
 		/// @brief Sets the particles charge.
-		void setCharge(int charge);
+		void setCharge(float charge);
+
+		/// @brief Sets the inverse mass directly (0 for an immovable particle).
+		void setInvMass(float invMass);
 
 		/// @brief Updates the particles bounding box.
 		void setAABB();
 
-		/// @brief Assigns an updater (external simulation manager).
+		/**
+		 * @brief Assigns an updater, called with the new position after every step.
+		 *
+		 * Compatibility path: reading all positions at once with
+		 * QmWorld::exportState is cheaper. Particles without an updater skip the call.
+		 */
 		void setUpdater(QmUpdater* updater);
 
 		/// @brief Adds a force to the particles accumulator.
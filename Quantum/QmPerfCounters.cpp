@@ -0,0 +1,122 @@
+#include "QmPerfCounters.h"
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace Quantum;
+
+QmPerfCounters::QmPerfCounters() : opened_(0)
+{
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+	{
+		fd_[e] = -1;
+		slot_[e] = -1;
+	}
+}
+
+QmPerfCounters::~QmPerfCounters()
+{
+	close();
+}
+
+bool QmPerfCounters::open()
+{
+	close();
+#ifdef __linux__
+	static const unsigned int types[PERF_EVENT_COUNT] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+	};
+	static const unsigned long long configs[PERF_EVENT_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	int leader = -1;
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[e];
+		attr.config = configs[e];
+		attr.disabled = leader < 0 ? 1 : 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+
+		int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+		if (fd < 0)
+			continue;
+		if (leader < 0)
+			leader = fd;
+		fd_[e] = fd;
+		slot_[e] = opened_++;
+	}
+	if (leader < 0)
+		return false;
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void QmPerfCounters::close()
+{
+#ifdef __linux__
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		if (fd_[e] >= 0)
+			::close(fd_[e]);
+#endif
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+	{
+		fd_[e] = -1;
+		slot_[e] = -1;
+	}
+	opened_ = 0;
+}
+
+bool QmPerfCounters::isOpen()
+{
+	return opened_ > 0;
+}
+
+bool QmPerfCounters::isAvailable(int event)
+{
+	return event >= 0 && event < PERF_EVENT_COUNT && slot_[event] >= 0;
+}
+
+void QmPerfCounters::read(unsigned long long* values)
+{
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		values[e] = 0;
+#ifdef __linux__
+	if (opened_ == 0)
+		return;
+	// Group format: number of events, then one value per event in opening order.
+	unsigned long long buffer[1 + PERF_EVENT_COUNT];
+	int leader = -1;
+	for (int e = 0; e < PERF_EVENT_COUNT && leader < 0; e++)
+		leader = fd_[e];
+	if (::read(leader, buffer, sizeof(buffer)) <= 0)
+		return;
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		if (slot_[e] >= 0 && slot_[e] < (int)buffer[0])
+			values[e] = buffer[1 + slot_[e]];
+#endif
+}
+
+const char* QmPerfCounters::eventName(int event)
+{
+	static const char* names[PERF_EVENT_COUNT] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+	return event >= 0 && event < PERF_EVENT_COUNT ? names[event] : "?";
+}
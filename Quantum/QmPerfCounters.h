@@ -0,0 +1,86 @@
+#pragma once
+
+namespace Quantum {
+
+	/**
+	 * @brief Hardware events counted by QmPerfCounters.
+	 */
+	enum QmPerfEvent {
+		PERF_CYCLES,        ///< CPU cycles.
+		PERF_INSTRUCTIONS,  ///< Retired instructions.
+		PERF_L1D_MISSES,    ///< L1 data cache read misses.
+		PERF_LLC_MISSES,    ///< Last level cache misses.
+		PERF_BRANCH_MISSES, ///< Mispredicted branches.
+		PERF_EVENT_COUNT
+	};
+
+	/**
+	 * @class QmPerfCounters
+	 * @brief Hardware performance counters of the calling thread (Linux perf_event_open).
+	 *
+	 * The events are opened as one group so that a read() is a single system
+	 * call. Events the CPU or the kernel does not provide are left out and
+	 * read as 0. Only user-space work is counted. On other systems, or when
+	 * perf events are not permitted (kernel.perf_event_paranoid), open()
+	 * fails and the counters stay 0.
+	 */
+	class QmPerfCounters {
+	public:
+
+		/**
+		 * @brief Constructs closed counters.
+		 */
+		QmPerfCounters();
+
+		/**
+		 * @brief Closes the counters.
+		 */
+		~QmPerfCounters();
+
+		/**
+		 * @brief Opens and starts the counters for the calling thread.
+		 * @return False if no event could be opened.
+		 */
+		bool open();
+
+		/**
+		 * @brief Closes the counters.
+		 */
+		void close();
+
+		/**
+		 * @return Whether at least one event is counting.
+		 */
+		bool isOpen();
+
+		/**
+		 * @return Whether the given event is counting.
+		 */
+		bool isAvailable(int event);
+
+		/**
+		 * @brief Reads the running totals of every event.
+		 *
+		 * Must be called from the thread that opened the counters.
+		 *
+		 * @param values Receives PERF_EVENT_COUNT values.
+		 */
+		void read(unsigned long long* values);
+
+		/**
+		 * @return Printable name of an event.
+		 */
+		static const char* eventName(int event);
+
+	private:
+
+		/// @brief File descriptor of each event, -1 when unavailable.
+		int fd_[PERF_EVENT_COUNT];
+
+		/// @brief Position of each event in a group read, -1 when unavailable.
+		int slot_[PERF_EVENT_COUNT];
+
+		/// @brief Number of events in the group.
+		int opened_;
+	};
+}
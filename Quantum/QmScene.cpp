@@ -0,0 +1,560 @@
+#include "QmScene.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "QmWorld.h"
+#include "QmTrace.h"
+
+using namespace Quantum;
+
+namespace {
+
+	/// @brief Random stream of the statement-th statement of a scene.
+	uint64_t stream(uint64_t seed, uint64_t statement)
+	{
+		uint64_t state = seed ^ ((statement + 1) * 0xD1B54A32D192ED03ULL);
+		QmSpawnDistribution::next(state);
+		return state;
+	}
+
+	bool toNumber(const std::string& s, float& v)
+	{
+		char* end;
+		v = strtof(s.c_str(), &end);
+		return !s.empty() && *end == 0;
+	}
+
+	bool toInt(const std::string& s, long& v)
+	{
+		char* end;
+		v = strtol(s.c_str(), &end, 10);
+		return !s.empty() && *end == 0;
+	}
+
+	/// @brief Reads "value" or "min:max".
+	bool toRange(const std::string& s, float& min, float& max)
+	{
+		size_t colon = s.find(':', 1);
+		if (colon == std::string::npos)
+		{
+			if (!toNumber(s, min))
+				return false;
+			max = min;
+			return true;
+		}
+		return toNumber(s.substr(0, colon), min) && toNumber(s.substr(colon + 1), max);
+	}
+}
+
+QmScene::QmScene() : seed_(0), hasGravity_(false), hasField_(false), hasCharge_(false),
+	gravity_(0.f), field_(0.f), chargeK_(0.f), chargeTheta_(0.f), line_(0)
+{
+}
+
+bool QmScene::load(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		reset();
+		error_ = std::string(path) + ": cannot read the file";
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	return parse(text.str(), path);
+}
+
+const std::string& QmScene::getError() const
+{
+	return error_;
+}
+
+bool QmScene::fail(const std::string& message)
+{
+	std::ostringstream s;
+	s << name_ << ":" << line_ << ": " << message;
+	error_ = s.str();
+	return false;
+}
+
+int QmScene::findBlock(const std::string& name)
+{
+	for (size_t b = 0; b < blocks_.size(); b++)
+		if (blocks_[b].name == name)
+			return (int)b;
+	fail("no particle block named '" + name + "'");
+	return -1;
+}
+
+void QmScene::reset()
+{
+	seed_ = 0;
+	hasGravity_ = hasField_ = hasCharge_ = false;
+	cutoffs_.clear();
+	planes_.clear();
+	blocks_.clear();
+	emitters_.clear();
+	springs_.clear();
+	forces_.clear();
+}
+
+bool QmScene::parse(const std::string& text, const std::string& name)
+{
+	reset();
+	name_ = name;
+	error_.clear();
+	if (parseLines(text))
+		return true;
+	reset();
+	return false;
+}
+
+bool QmScene::parseLines(const std::string& text)
+{
+	std::istringstream in(text);
+	std::string line;
+	for (line_ = 1; std::getline(in, line); line_++)
+	{
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+		std::istringstream words(line);
+		std::vector<std::string> tokens;
+		std::string word;
+		while (words >> word)
+			tokens.push_back(word);
+		if (tokens.empty())
+			continue;
+		const std::string& key = tokens[0];
+
+		// Statements of fixed arity take plain numbers.
+		int arity = key == "seed" ? 1 : key == "gravity" || key == "efield" || key == "cutoff_magnetism" ? 3
+			: key == "charge_interaction" ? 2 : key == "box" || key == "halfspace" ? 6 : -1;
+		float v[6];
+		if (arity >= 0)
+		{
+			if ((int)tokens.size() != arity + 1)
+				return fail("'" + key + "' expects " + std::to_string(arity) + " values");
+			for (int i = 0; i < arity && key != "seed"; i++)
+				if (!toNumber(tokens[i + 1], v[i]))
+					return fail("'" + tokens[i + 1] + "' is not a number");
+		}
+
+		if (key == "seed")
+		{
+			char* end;
+			seed_ = strtoull(tokens[1].c_str(), &end, 10);
+			if (*end != 0)
+				return fail("'" + tokens[1] + "' is not a seed");
+		}
+		else if (key == "gravity")
+		{
+			gravity_ = glm::vec3(v[0], v[1], v[2]);
+			hasGravity_ = true;
+		}
+		else if (key == "efield")
+		{
+			field_ = glm::vec3(v[0], v[1], v[2]);
+			hasField_ = true;
+		}
+		else if (key == "charge_interaction")
+		{
+			chargeK_ = v[0];
+			chargeTheta_ = v[1];
+			hasCharge_ = true;
+		}
+		else if (key == "cutoff_magnetism")
+			cutoffs_.push_back(glm::vec3(v[0], v[1], v[2]));
+		else if (key == "box")
+		{
+			Plane p;
+			for (int a = 0; a < 3; a++)
+			{
+				float n[3] = { 0.f, 0.f, 0.f };
+				n[a] = 1.f;
+				p.normal = glm::vec3(n[0], n[1], n[2]);
+				p.point = glm::vec3(v[0], v[1], v[2]);
+				planes_.push_back(p);
+				n[a] = -1.f;
+				p.normal = glm::vec3(n[0], n[1], n[2]);
+				p.point = glm::vec3(v[3], v[4], v[5]);
+				planes_.push_back(p);
+			}
+		}
+		else if (key == "halfspace")
+		{
+			Plane p;
+			p.normal = glm::vec3(v[0], v[1], v[2]);
+			p.point = glm::vec3(v[3], v[4], v[5]);
+			if (glm::length(p.normal) == 0.f)
+				return fail("the normal of a half-space cannot be zero");
+			p.normal = glm::normalize(p.normal);
+			planes_.push_back(p);
+		}
+		else if (key == "particles")
+		{
+			Block b;
+			long count;
+			if (tokens.size() < 3 || !toInt(tokens[2], count) || count < 0 || count > 0x7FFFFFFF)
+				return fail("expected 'particles NAME COUNT'");
+			b.name = tokens[1];
+			b.count = (int)count;
+			if (b.name == "k" || b.name == "rest")
+				return fail("'" + b.name + "' is reserved");
+			for (const Block& other : blocks_)
+				if (other.name == b.name)
+					return fail("particle block '" + b.name + "' is defined twice");
+			if (!parseParticles(tokens, 3, b.particles, NULL))
+				return false;
+			const int* n = b.particles.lattice;
+			if (n[0] && (long long)n[0] * n[1] * n[2] != count)
+				return fail("a lattice of " + std::to_string((long long)n[0] * n[1] * n[2]) + " particles for a block of " + tokens[2]);
+			blocks_.push_back(b);
+		}
+		else if (key == "emitter")
+		{
+			Emitter e;
+			if (tokens.size() < 3 || !toNumber(tokens[2], e.rate) || !(e.rate >= 0.f))
+				return fail("expected 'emitter NAME RATE'");
+			e.name = tokens[1];
+			e.lifetime = 5.f;
+			e.capacity = 0;
+			if (!parseParticles(tokens, 3, e.particles, &e))
+				return false;
+			if (e.capacity == 0)
+			{
+				if (e.lifetime == 0.f)
+					return fail("an emitter without lifetime needs a capacity");
+				double alive = (double)e.rate * e.lifetime + 1.0;
+				if (alive > 0x7FFFFFFF)
+					return fail("the emitter would keep too many particles alive");
+				e.capacity = (int)alive;
+			}
+			emitters_.push_back(e);
+		}
+		else if (key == "springs")
+		{
+			Springs s;
+			if (tokens.size() < 3)
+				return fail("expected 'springs TOPOLOGY BLOCK...'");
+			if (tokens[1] == "chain")
+				s.topology = TOPOLOGY_CHAIN;
+			else if (tokens[1] == "lattice")
+				s.topology = TOPOLOGY_LATTICE;
+			else if (tokens[1] == "tetra")
+				s.topology = TOPOLOGY_TETRA;
+			else
+				return fail("unknown spring topology '" + tokens[1] + "'");
+			s.k = 8.f;
+			s.rest = -1.f;
+			size_t t = 2;
+			long long nodes = 0;
+			for (; t < tokens.size() && tokens[t] != "k" && tokens[t] != "rest"; t++)
+			{
+				int b = findBlock(tokens[t]);
+				if (b < 0)
+					return false;
+				s.blocks.push_back(b);
+				nodes += blocks_[b].count;
+			}
+			for (; t < tokens.size(); t += 2)
+			{
+				if (t + 1 == tokens.size())
+					return fail("'" + tokens[t] + "' expects a value");
+				if (tokens[t] == "k" && toNumber(tokens[t + 1], s.k))
+					continue;
+				if (tokens[t] == "rest" && (tokens[t + 1] == "auto" || (toNumber(tokens[t + 1], s.rest) && s.rest >= 0.f)))
+					continue;
+				return fail("unexpected '" + tokens[t] + " " + tokens[t + 1] + "'");
+			}
+			if (s.blocks.empty())
+				return fail("springs without particles");
+			if (s.topology == TOPOLOGY_LATTICE && (s.blocks.size() != 1 || !blocks_[s.blocks[0]].particles.lattice[0]))
+				return fail("lattice springs take a single lattice block");
+			if (s.topology == TOPOLOGY_TETRA && (nodes < 5 || (nodes - 1) % 4 != 0))
+				return fail("tetra springs need 1 + 4n particles");
+			springs_.push_back(s);
+		}
+		else if (key == "magnetism" || key == "attract" || key == "spring" || key == "anchor")
+		{
+			Force f;
+			f.type = key == "magnetism" ? FORCE_MAGNETISM : key == "attract" ? FORCE_ATTRACT : key == "spring" ? FORCE_SPRING : FORCE_ANCHOR;
+			f.rest = 0.f;
+			bool anchor = f.type == FORCE_ANCHOR;
+			size_t expected = key == "spring" ? 5 : 4;
+			if (tokens.size() != expected && !(anchor && tokens.size() == 3))
+				return fail(anchor ? "expected 'anchor BLOCK K [REST]'" : "expected '" + key + " A B K" + (key == "spring" ? " REST'" : "'"));
+			f.a = findBlock(tokens[1]);
+			f.b = anchor ? f.a : findBlock(tokens[2]);
+			if (f.a < 0 || f.b < 0)
+				return false;
+			if (blocks_[f.b].count == 0)
+				return fail("particle block '" + blocks_[f.b].name + "' is empty");
+			if (!toNumber(tokens[anchor ? 2 : 3], f.k) || (tokens.size() > (anchor ? 3u : 4u) && !toNumber(tokens.back(), f.rest)))
+				return fail("expected numbers after the blocks");
+			forces_.push_back(f);
+		}
+		else
+			return fail("unknown statement '" + key + "'");
+	}
+	line_ = 0;
+	return true;
+}
+
+bool QmScene::parseParticles(const std::vector<std::string>& tokens, size_t t, Particles& p, Emitter* e)
+{
+	QmSpawnDistribution& s = p.spawn;
+	s = QmSpawnDistribution();
+	for (int a = 0; a < 3; a++)
+	{
+		p.color[a].min = 0.f;
+		p.color[a].max = 1.f;
+		p.lattice[a] = 0;
+	}
+
+	while (t < tokens.size())
+	{
+		const std::string& key = tokens[t++];
+		if (key == "static")
+		{
+			s.dynamic = false;
+			continue;
+		}
+		QmRange* ranges = key == "pos" ? s.pos : key == "vel" ? s.vel : key == "acc" ? s.acc : key == "color" ? p.color
+			: key == "mass" ? &s.mass : key == "charge" ? &s.charge : key == "radius" ? &s.radius : NULL;
+		int arity = key == "pos" || key == "vel" || key == "acc" || key == "color" || key == "lattice" ? 3 : key == "drag" ? 2
+			: key == "mass" || key == "charge" || key == "radius" || key == "lifetime" || key == "capacity" ? 1 : 0;
+		if (arity == 0)
+			return fail("unknown particle key '" + key + "'");
+		if (t + arity > tokens.size())
+			return fail("'" + key + "' expects " + std::to_string(arity) + " values");
+		if ((key == "lifetime" || key == "capacity") && !e)
+			return fail("only an emitter has a " + key);
+		if (key == "lifetime")
+		{
+			if (!toNumber(tokens[t], e->lifetime) || !(e->lifetime >= 0.f))
+				return fail("'" + tokens[t] + "' is not a lifetime");
+		}
+		else if (key == "capacity")
+		{
+			long n;
+			if (!toInt(tokens[t], n) || n < 1 || n > 0x7FFFFFFF)
+				return fail("'" + tokens[t] + "' is not a capacity");
+			e->capacity = (int)n;
+		}
+		else if (key == "lattice")
+		{
+			if (e)
+				return fail("an emitter cannot have a lattice");
+			for (int a = 0; a < 3; a++)
+			{
+				long n;
+				if (!toInt(tokens[t + a], n) || n < 1 || n > 0x7FFFFFFF)
+					return fail("'" + tokens[t + a] + "' is not a lattice size");
+				p.lattice[a] = (int)n;
+			}
+		}
+		else
+		{
+			QmRange drag[2];
+			if (!ranges)
+				ranges = drag;
+			for (int i = 0; i < arity; i++)
+				if (!toRange(tokens[t + i], ranges[i].min, ranges[i].max))
+					return fail("'" + tokens[t + i] + "' is neither a number nor a range");
+			if (key == "drag")
+			{
+				s.linearDrag = drag[0];
+				s.quadraticDrag = drag[1];
+			}
+		}
+		t += arity;
+	}
+	return true;
+}
+
+int QmScene::getBodyCount() const
+{
+	long long count = 0;
+	for (const Block& b : blocks_)
+		count += b.count;
+	return (int)count;
+}
+
+void QmScene::draw(const Particles& p, int count, uint64_t& state, bool colors)
+{
+	particles_.resize(count);
+	linearDrag_.resize(count);
+	quadraticDrag_.resize(count);
+	colors_.resize(colors ? count : 0);
+
+	const int* n = p.lattice;
+	const QmRange* box = p.spawn.pos;
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 cellPos;
+		if (n[0])
+		{
+			// Cell centres, x fastest.
+			int cell[3] = { i % n[0], (i / n[0]) % n[1], (int)((long long)i / ((long long)n[0] * n[1])) };
+			float c[3];
+			for (int a = 0; a < 3; a++)
+				c[a] = box[a].min + (box[a].max - box[a].min) * (cell[a] + 0.5f) / n[a];
+			cellPos = glm::vec3(c[0], c[1], c[2]);
+		}
+		particles_[i] = new QmParticle();
+		p.spawn.draw(state, particles_[i], linearDrag_[i], quadraticDrag_[i], n[0] ? &cellPos : NULL);
+		if (colors)
+			colors_[i] = drawColor(p, state);
+	}
+}
+
+glm::vec3 QmScene::drawColor(const Particles& p, uint64_t& state)
+{
+	float r = QmSpawnDistribution::uniform(state, p.color[0]);
+	float g = QmSpawnDistribution::uniform(state, p.color[1]);
+	return glm::vec3(r, g, QmSpawnDistribution::uniform(state, p.color[2]));
+}
+
+void QmScene::storeColors(int first, int count, std::vector<glm::vec3>* colors)
+{
+	if (!colors)
+		return;
+	if ((int)colors->size() < first + count)
+		colors->resize(first + count, glm::vec3(1.f));
+	std::copy(colors_.begin(), colors_.begin() + count, colors->begin() + first);
+}
+
+int QmScene::build(QmWorld& world, std::vector<glm::vec3>* colors)
+{
+	QM_TRACE_SCOPE("scene_build");
+	if (hasGravity_)
+		world.setGravity(gravity_);
+	if (hasField_)
+		world.setElectricField(field_);
+	if (hasCharge_)
+		world.setChargeInteraction(true, chargeK_, chargeTheta_);
+	for (const glm::vec3& c : cutoffs_)
+		world.AddCutoffMagnetism(new QmCutoffMagnetism(c.x, c.y, c.z));
+	for (const Plane& p : planes_)
+		world.addHalfSpace(new HalfSpace(p.normal, p.point));
+
+	// Bodies: one addBodies per block, into storage reserved for all of them.
+	int total = getBodyCount();
+	world.reserveBodies(total);
+	std::vector<QmParticle*> all;
+	all.reserve(total);
+	std::vector<size_t> start(blocks_.size());
+	for (size_t b = 0; b < blocks_.size(); b++)
+	{
+		uint64_t state = stream(seed_, b);
+		draw(blocks_[b].particles, blocks_[b].count, state, colors != NULL);
+		int first = world.addBodies(particles_.data(), blocks_[b].count, linearDrag_.data(), quadraticDrag_.data());
+		storeColors(first, blocks_[b].count, colors);
+		start[b] = all.size();
+		all.insert(all.end(), particles_.begin(), particles_.end());
+	}
+
+	// Springs: one network per statement, filled by node index.
+	for (const Springs& s : springs_)
+	{
+		std::vector<QmParticle*> nodes;
+		for (int b : s.blocks)
+			nodes.insert(nodes.end(), all.begin() + start[b], all.begin() + start[b] + blocks_[b].count);
+		int n = (int)nodes.size();
+		const int* grid = blocks_[s.blocks[0]].particles.lattice;
+		int edges = s.topology == TOPOLOGY_CHAIN ? std::max(n - 1, 0) : s.topology == TOPOLOGY_TETRA ? 9 * (n - 1) / 4
+			: (grid[0] - 1) * grid[1] * grid[2] + grid[0] * (grid[1] - 1) * grid[2] + grid[0] * grid[1] * (grid[2] - 1);
+
+		QmSpringNetwork* net = new QmSpringNetwork();
+		net->reserve(n, edges);
+		for (QmParticle* p : nodes)
+			net->addNode(p);
+		auto spring = [&](int i, int j) {
+			float rest = s.rest >= 0.f ? s.rest : glm::length(nodes[i]->getPos() - nodes[j]->getPos());
+			net->addSpring(i, j, s.k, rest);
+		};
+		switch (s.topology)
+		{
+		case TOPOLOGY_CHAIN:
+			for (int i = 0; i + 1 < n; i++)
+				spring(i, i + 1);
+			break;
+		case TOPOLOGY_LATTICE:
+			for (int i = 0; i < n; i++)
+			{
+				int x = i % grid[0], y = (i / grid[0]) % grid[1], z = (int)((long long)i / ((long long)grid[0] * grid[1]));
+				if (x + 1 < grid[0])
+					spring(i, i + 1);
+				if (y + 1 < grid[1])
+					spring(i, i + grid[0]);
+				if (z + 1 < grid[2])
+					spring(i, i + grid[0] * grid[1]);
+			}
+			break;
+		case TOPOLOGY_TETRA:
+			for (int root = 0; root + 4 < n; root += 4)
+			{
+				int a = root + 1, b = root + 2, c = root + 3, apex = root + 4;
+				spring(root, a); spring(root, b); spring(root, c);
+				spring(a, b); spring(b, c); spring(c, a);
+				spring(apex, a); spring(apex, b); spring(apex, c);
+			}
+			break;
+		}
+		world.AddSpringNetwork(net);
+	}
+
+	// Force entries: generators acting towards the same particle are shared.
+	for (const Force& f : forces_)
+	{
+		int na = blocks_[f.a].count, nb = blocks_[f.b].count;
+		QmParticle* const* A = all.data() + start[f.a];
+		QmParticle* const* B = all.data() + start[f.b];
+		std::vector<QmForceGenerator*> towards(f.type == FORCE_ATTRACT || f.type == FORCE_SPRING ? std::min(na, nb) : 0, NULL);
+		for (int i = 0; i < na; i++)
+		{
+			int j = i % nb;
+			switch (f.type)
+			{
+			case FORCE_MAGNETISM:
+				world.AddForceRegistry(new QmForceRegistry(A[i], (QmForceGenerator*)new QmMagnetism(f.k, B[j])));
+				world.AddForceRegistry(new QmForceRegistry(B[j], (QmForceGenerator*)new QmMagnetism(f.k, A[i])));
+				break;
+			case FORCE_ATTRACT:
+				if (!towards[j])
+					towards[j] = (QmForceGenerator*)new QmFixedMagnetism(f.k, B[j]);
+				world.AddForceRegistry(new QmForceRegistry(A[i], towards[j]));
+				break;
+			case FORCE_SPRING:
+				if (!towards[j])
+					towards[j] = (QmForceGenerator*)new QmSpring(f.k, (int)f.rest, B[j]);
+				world.AddForceRegistry(new QmForceRegistry(A[i], towards[j]));
+				break;
+			case FORCE_ANCHOR:
+				world.AddForceRegistry(new QmForceRegistry(A[i], (QmForceGenerator*)new QmFixedSpring(f.k, (int)f.rest, A[i]->getPos())));
+				break;
+			}
+		}
+	}
+
+	// Emitters: a slot keeps its color whatever particle it holds.
+	for (size_t e = 0; e < emitters_.size(); e++)
+	{
+		const Emitter& d = emitters_[e];
+		uint64_t state = stream(seed_, blocks_.size() + e);
+		QmEmitter* emitter = new QmEmitter(d.particles.spawn, d.rate, d.lifetime, d.capacity, state);
+		world.addEmitter(emitter);
+		if (colors)
+		{
+			uint64_t colorState = stream(seed_, blocks_.size() + emitters_.size() + e);
+			colors_.resize(d.capacity);
+			for (int i = 0; i < d.capacity; i++)
+				colors_[i] = drawColor(d.particles, colorState);
+			storeColors(emitter->getFirstHandle(), d.capacity, colors);
+		}
+	}
+	return total;
+}
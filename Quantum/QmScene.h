@@ -0,0 +1,203 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "QmEmitter.h"
+
+namespace Quantum {
+
+	class QmWorld;
+	class QmParticle;
+
+	/**
+	 * @class QmScene
+	 * @brief Scene described in a text file, built into a world in bulk.
+	 *
+	 * One statement per line, '#' starts a comment. A number may be written
+	 * "min:max" to draw it uniformly in that range, and a vector as three
+	 * such numbers:
+	 *
+	 *     seed 7
+	 *     gravity 0 -9.81 0
+	 *     efield 0 0 0
+	 *     charge_interaction K THETA          (QmWorld::setChargeInteraction)
+	 *     cutoff_magnetism K CUTOFF SKIN      (QmCutoffMagnetism over all pairs)
+	 *     box X0 Y0 Z0 X1 Y1 Z1               six inward half-spaces
+	 *     halfspace NX NY NZ PX PY PZ         normal and a point of the plane
+	 *     particles NAME COUNT [key value...] a block of particles
+	 *     emitter NAME RATE [key value...]    a QmEmitter of RATE particles per second
+	 *     springs TOPOLOGY BLOCK... [k K] [rest L|auto]
+	 *     magnetism A B K                     QmMagnetism both ways between A[i] and B[i]
+	 *     attract A B K                       QmFixedMagnetism towards B[i] on A[i]
+	 *     spring A B K L                      QmSpring towards B[i] on A[i]
+	 *     anchor A K [L]                      QmFixedSpring to its initial position on A[i]
+	 *
+	 * Particle keys: pos X Y Z, vel X Y Z, acc X Y Z, mass M, charge Q,
+	 * radius R, drag K1 K2, color R G B, static (not accelerated), and for
+	 * blocks lattice NX NY NZ (COUNT particles on a grid filling pos), for
+	 * emitters lifetime T (seconds, default 5, 0 for no limit) and capacity N
+	 * (default rate * lifetime + 1, required without a lifetime).
+	 * Where a force pairs two blocks, A[i] goes with B[i % size of B].
+	 *
+	 * Spring topologies join the particles of the listed blocks, in order,
+	 * into one QmSpringNetwork: chain (each to the next), lattice (grid
+	 * neighbours of a single lattice block), tetra (the first particle is
+	 * the root; each group of four hangs a tetrahedron under the root and
+	 * its last particle becomes the next root). "rest auto" uses the initial
+	 * distances.
+	 *
+	 * Random values come from the scene seed and the statement, not from
+	 * rand(), so a scene builds the same on every run and editing a block
+	 * leaves the others unchanged.
+	 */
+	class QmScene {
+	public:
+
+		QmScene();
+
+		/**
+		 * @brief Reads and parses a scene file, replacing the current scene.
+		 * @return False on a read or syntax error (see getError); the scene is then empty.
+		 */
+		bool load(const char* path);
+
+		/**
+		 * @brief Parses a scene description, replacing the current scene.
+		 * @param name Name given to the text in error messages.
+		 * @return False on a syntax error (see getError); the scene is then empty.
+		 */
+		bool parse(const std::string& text, const std::string& name = "scene");
+
+		/**
+		 * @return The last error, "file:line: message".
+		 */
+		const std::string& getError() const;
+
+		/**
+		 * @return Number of bodies build() creates.
+		 */
+		int getBodyCount() const;
+
+		/**
+		 * @brief Adds the scene to a world (usually just cleared).
+		 *
+		 * Storage is reserved for every body first, each block is added with
+		 * one QmWorld::addBodies call, each spring statement becomes one
+		 * network and force entries share their generator where they can.
+		 * Each emitter statement adds a new QmEmitter to the world.
+		 *
+		 * @param colors If not NULL, resized to the handle count and given the
+		 *               color of each body created and of each emitter slot, by handle.
+		 * @return Number of bodies created, emitters aside.
+		 */
+		int build(QmWorld& world, std::vector<glm::vec3>* colors = NULL);
+
+	private:
+
+		/// @brief How the particles of a block or an emitter are drawn.
+		struct Particles {
+			QmSpawnDistribution spawn;
+			QmRange color[3];
+			int lattice[3];
+		};
+
+		struct Block {
+			std::string name;
+			int count;
+			Particles particles;
+		};
+
+		struct Emitter {
+			std::string name;
+			float rate;
+			float lifetime;
+			int capacity;
+			Particles particles;
+		};
+
+		enum Topology { TOPOLOGY_CHAIN, TOPOLOGY_LATTICE, TOPOLOGY_TETRA };
+
+		struct Springs {
+			Topology topology;
+			std::vector<int> blocks;
+			float k;
+			float rest; ///< Negative for the initial distances.
+		};
+
+		enum ForceType { FORCE_MAGNETISM, FORCE_ATTRACT, FORCE_SPRING, FORCE_ANCHOR };
+
+		struct Force {
+			ForceType type;
+			int a, b;
+			float k, rest;
+		};
+
+		struct Plane {
+			glm::vec3 normal, point;
+		};
+
+		/**
+		 * @brief Empties the scene.
+		 */
+		void reset();
+
+		/**
+		 * @brief Parses the statements of text into the empty scene.
+		 */
+		bool parseLines(const std::string& text);
+
+		/**
+		 * @brief Parses the particle keys from token t on.
+		 */
+		bool parseParticles(const std::vector<std::string>& tokens, size_t t, Particles& p, Emitter* e);
+
+		/**
+		 * @return Index of the block named name, -1 (and an error) if there is none.
+		 */
+		int findBlock(const std::string& name);
+
+		/**
+		 * @brief Sets the error of the line being parsed.
+		 * @return False.
+		 */
+		bool fail(const std::string& message);
+
+		/**
+		 * @brief Creates count particles into particles_, with their drag and (if colors) their color.
+		 */
+		void draw(const Particles& p, int count, uint64_t& state, bool colors);
+
+		/**
+		 * @return A color drawn from the color ranges of p.
+		 */
+		static glm::vec3 drawColor(const Particles& p, uint64_t& state);
+
+		/**
+		 * @brief Copies the colors drawn for handles first.. into colors, if not NULL.
+		 */
+		void storeColors(int first, int count, std::vector<glm::vec3>* colors);
+
+		uint64_t seed_;
+		bool hasGravity_, hasField_, hasCharge_;
+		glm::vec3 gravity_, field_;
+		float chargeK_, chargeTheta_;
+		std::vector<glm::vec3> cutoffs_;
+		std::vector<Plane> planes_;
+		std::vector<Block> blocks_;
+		std::vector<Emitter> emitters_;
+		std::vector<Springs> springs_;
+		std::vector<Force> forces_;
+
+		/// @brief Source name and line of the statement being parsed.
+		std::string name_;
+		int line_;
+
+		std::string error_;
+
+		/// @brief Scratch arrays of build().
+		std::vector<QmParticle*> particles_;
+		std::vector<float> linearDrag_, quadraticDrag_;
+		std::vector<glm::vec3> colors_;
+	};
+}
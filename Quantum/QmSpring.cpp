@@ -7,6 +7,7 @@ QmSpring::QmSpring(float K, int lo, QmParticle* p) : k_(K)
 {
 	part = p;
 	l_ = lo;
+	type = FORCE_SPRING;
 }
 
 QmSpring::~QmSpring() {}
@@ -16,6 +17,16 @@ void QmSpring::setRaideur(int k)
 	k_ = k;
 }
 
+float QmSpring::getRaideur()
+{
+	return k_;
+}
+
+int QmSpring::getRestLength()
+{
+	return l_;
+}
+
 void QmSpring::update(QmParticle* p) {
 	glm::vec3 d = p->getPos() - part->getPos();
 	float N = sqrt(pow(d.x, 2) + pow(d.y, 2) + pow(d.z, 2));
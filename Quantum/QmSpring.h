@@ -53,6 +53,12 @@ namespace Quantum {
         */
 		void setRaideur(int k);
 
+        /// @return Spring stiffness.
+		float getRaideur();
+
+        /// @return Rest length of the spring.
+		int getRestLength();
+
         /// @brief Reference particle attached to the spring.
 		QmParticle* part;
 	private:
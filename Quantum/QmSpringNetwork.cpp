@@ -0,0 +1,562 @@
+#include "QmSpringNetwork.h"
+#include "QmParticle.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QM_SPRING_SSE
+#endif
+
+using namespace Quantum;
+
+QmSpringNetwork::QmSpringNetwork() : dirty_(false), lastIterations_(0) {}
+
+QmSpringNetwork::~QmSpringNetwork() {}
+
+int QmSpringNetwork::addNode(QmParticle* p)
+{
+	auto it = nodeIndex_.find(p);
+	if (it != nodeIndex_.end())
+		return it->second;
+	int i = (int)nodes_.size();
+	nodes_.push_back(p);
+	nodeIndex_[p] = i;
+	dirty_ = true;
+	return i;
+}
+
+void QmSpringNetwork::addSpring(QmParticle* a, QmParticle* b, float K, float lo)
+{
+	edgeI_.push_back(addNode(a));
+	edgeJ_.push_back(addNode(b));
+	edgeK_.push_back(K);
+	edgeL_.push_back(lo);
+	dirty_ = true;
+}
+
+void QmSpringNetwork::addSpring(int i, int j, float K, float lo)
+{
+	edgeI_.push_back(i);
+	edgeJ_.push_back(j);
+	edgeK_.push_back(K);
+	edgeL_.push_back(lo);
+	dirty_ = true;
+}
+
+bool QmSpringNetwork::removeNode(QmParticle* p)
+{
+	auto it = nodeIndex_.find(p);
+	if (it == nodeIndex_.end())
+		return false;
+	int i = it->second;
+	int last = (int)nodes_.size() - 1;
+	nodeIndex_.erase(it);
+
+	size_t kept = 0;
+	for (size_t e = 0; e < edgeI_.size(); e++)
+	{
+		if (edgeI_[e] == i || edgeJ_[e] == i)
+			continue;
+		edgeI_[kept] = edgeI_[e] == last ? i : edgeI_[e];
+		edgeJ_[kept] = edgeJ_[e] == last ? i : edgeJ_[e];
+		edgeK_[kept] = edgeK_[e];
+		edgeL_[kept] = edgeL_[e];
+		kept++;
+	}
+	edgeI_.resize(kept);
+	edgeJ_.resize(kept);
+	edgeK_.resize(kept);
+	edgeL_.resize(kept);
+
+	if (i != last)
+	{
+		nodes_[i] = nodes_[last];
+		nodeIndex_[nodes_[i]] = i;
+	}
+	nodes_.pop_back();
+	dirty_ = true;
+	return true;
+}
+
+void QmSpringNetwork::reserve(int nodes, int springs)
+{
+	nodes_.reserve(nodes_.size() + nodes);
+	nodeIndex_.reserve(nodes_.size() + nodes);
+	edgeI_.reserve(edgeI_.size() + springs);
+	edgeJ_.reserve(edgeJ_.size() + springs);
+	edgeK_.reserve(edgeK_.size() + springs);
+	edgeL_.reserve(edgeL_.size() + springs);
+}
+
+namespace {
+
+	/**
+	 * @brief Recursive breadth-first bisection of an undirected graph (CSR adjacency).
+	 */
+	struct Bisection {
+		const std::vector<int>& adjStart;
+		const std::vector<int>& adj;
+		std::vector<int>& order;
+		std::vector<int> part, seen, queue;
+		int parts, sweeps;
+
+		Bisection(const std::vector<int>& adjStart, const std::vector<int>& adj, std::vector<int>& order)
+			: adjStart(adjStart), adj(adj), order(order), part(order.size(), 0), seen(order.size(), 0),
+			queue(order.size()), parts(0), sweeps(0) {}
+
+		/// @brief Breadth-first sweep inside the current part, appended to queue from tail. Returns the new tail.
+		int sweep(int start, int tail)
+		{
+			int head = tail;
+			queue[tail++] = start;
+			seen[start] = sweeps;
+			while (head < tail)
+			{
+				int v = queue[head++];
+				for (int k = adjStart[v]; k < adjStart[v + 1]; k++)
+				{
+					int w = adj[k];
+					if (part[w] == parts && seen[w] != sweeps)
+					{
+						seen[w] = sweeps;
+						queue[tail++] = w;
+					}
+				}
+			}
+			return tail;
+		}
+
+		/// @brief Orders order[lo, hi) breadth-first, then bisects it until parts have at most leaf nodes.
+		void split(int lo, int hi, int leaf)
+		{
+			++parts;
+			for (int k = lo; k < hi; k++)
+				part[order[k]] = parts;
+
+			// The last node reached from any node is far from it: start from there.
+			++sweeps;
+			int far = queue[sweep(order[lo], lo) - 1];
+
+			// Disconnected components follow each other.
+			++sweeps;
+			int tail = sweep(far, lo);
+			for (int k = lo; k < hi && tail < hi; k++)
+				if (seen[order[k]] != sweeps)
+					tail = sweep(order[k], tail);
+			std::copy(queue.begin() + lo, queue.begin() + hi, order.begin() + lo);
+
+			if (hi - lo <= leaf)
+				return;
+			int mid = lo + (hi - lo) / 2;
+			split(lo, mid, leaf);
+			split(mid, hi, leaf);
+		}
+	};
+}
+
+void QmSpringNetwork::reorder()
+{
+	const int nodeCount = (int)nodes_.size();
+	const int edgeCount = (int)edgeI_.size();
+	if (nodeCount < 2)
+		return;
+
+	std::vector<int> adjStart(nodeCount + 1, 0), adj(2 * edgeCount);
+	for (int e = 0; e < edgeCount; e++)
+	{
+		adjStart[edgeI_[e] + 1]++;
+		adjStart[edgeJ_[e] + 1]++;
+	}
+	for (int i = 0; i < nodeCount; i++)
+		adjStart[i + 1] += adjStart[i];
+	std::vector<int> fill(adjStart.begin(), adjStart.end() - 1);
+	for (int e = 0; e < edgeCount; e++)
+	{
+		adj[fill[edgeI_[e]]++] = edgeJ_[e];
+		adj[fill[edgeJ_[e]]++] = edgeI_[e];
+	}
+
+	std::vector<int> order(nodeCount);
+	std::iota(order.begin(), order.end(), 0);
+	Bisection(adjStart, adj, order).split(0, nodeCount, 16);
+
+	std::vector<int> rank(nodeCount);
+	std::vector<QmParticle*> nodes(nodeCount);
+	for (int k = 0; k < nodeCount; k++)
+	{
+		rank[order[k]] = k;
+		nodes[k] = nodes_[order[k]];
+		nodeIndex_[nodes[k]] = k;
+	}
+	nodes_.swap(nodes);
+
+	std::vector<int> I(edgeCount), J(edgeCount), edges(edgeCount);
+	for (int e = 0; e < edgeCount; e++)
+	{
+		I[e] = std::min(rank[edgeI_[e]], rank[edgeJ_[e]]);
+		J[e] = std::max(rank[edgeI_[e]], rank[edgeJ_[e]]);
+	}
+	std::iota(edges.begin(), edges.end(), 0);
+	std::sort(edges.begin(), edges.end(), [&](int a, int b) { return I[a] != I[b] ? I[a] < I[b] : J[a] < J[b]; });
+	std::vector<float> K(edgeCount), L(edgeCount);
+	for (int e = 0; e < edgeCount; e++)
+	{
+		edgeI_[e] = I[edges[e]];
+		edgeJ_[e] = J[edges[e]];
+		K[e] = edgeK_[edges[e]];
+		L[e] = edgeL_[edges[e]];
+	}
+	edgeK_.swap(K);
+	edgeL_.swap(L);
+	dirty_ = true;
+}
+
+void QmSpringNetwork::compress()
+{
+	size_t n = edgeI_.size();
+	std::vector<int> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return edgeI_[a] < edgeI_[b]; });
+
+	std::vector<int> I(n), J(n);
+	std::vector<float> K(n), L(n);
+	for (size_t e = 0; e < n; e++)
+	{
+		I[e] = edgeI_[order[e]];
+		J[e] = edgeJ_[order[e]];
+		K[e] = edgeK_[order[e]];
+		L[e] = edgeL_[order[e]];
+	}
+	edgeI_.swap(I);
+	edgeJ_.swap(J);
+	edgeK_.swap(K);
+	edgeL_.swap(L);
+
+	rowStart_.assign(nodes_.size() + 1, 0);
+	for (int i : edgeI_)
+		rowStart_[i + 1]++;
+	for (size_t i = 0; i < nodes_.size(); i++)
+		rowStart_[i + 1] += rowStart_[i];
+
+	size_t m = nodes_.size();
+	px_.resize(m); py_.resize(m); pz_.resize(m);
+	fx_.resize(m); fy_.resize(m); fz_.resize(m);
+	dx_.resize(n); dy_.resize(n); dz_.resize(n); c_.resize(n);
+
+	// Block pattern of the implicit system: diagonal plus both ends of every edge.
+	std::vector<std::vector<int>> adj(m);
+	for (size_t i = 0; i < m; i++)
+		adj[i].push_back((int)i);
+	for (size_t e = 0; e < n; e++)
+	{
+		adj[edgeI_[e]].push_back(edgeJ_[e]);
+		adj[edgeJ_[e]].push_back(edgeI_[e]);
+	}
+	std::vector<int> blockStart(1, 0), cols;
+	for (size_t i = 0; i < m; i++)
+	{
+		std::sort(adj[i].begin(), adj[i].end());
+		adj[i].erase(std::unique(adj[i].begin(), adj[i].end()), adj[i].end());
+		cols.insert(cols.end(), adj[i].begin(), adj[i].end());
+		blockStart.push_back((int)cols.size());
+	}
+	A_.setPattern((int)m, blockStart, cols);
+	blockIJ_.resize(n);
+	blockJI_.resize(n);
+	for (size_t e = 0; e < n; e++)
+	{
+		blockIJ_[e] = A_.find(edgeI_[e], edgeJ_[e]);
+		blockJI_[e] = A_.find(edgeJ_[e], edgeI_[e]);
+	}
+	dv_.assign(3 * m, 0.f);
+	b_.resize(3 * m); r_.resize(3 * m); z_.resize(3 * m); p_.resize(3 * m); q_.resize(3 * m);
+	pinv_.resize(9 * m);
+	fixed_.resize(m);
+	dirty_ = false;
+}
+
+void QmSpringNetwork::update()
+{
+	if (dirty_)
+		compress();
+
+	const int nodeCount = (int)nodes_.size();
+	const int edgeCount = (int)edgeJ_.size();
+
+	// Gather positions once per node.
+	for (int i = 0; i < nodeCount; i++)
+	{
+		glm::vec3 pos = nodes_[i]->getPos();
+		px_[i] = pos.x; py_[i] = pos.y; pz_[i] = pos.z;
+		fx_[i] = 0.f; fy_[i] = 0.f; fz_[i] = 0.f;
+	}
+
+	// Edge vectors d = x_i - x_j.
+	for (int e = 0; e < edgeCount; e++)
+	{
+		int i = edgeI_[e], j = edgeJ_[e];
+		dx_[e] = px_[i] - px_[j];
+		dy_[e] = py_[i] - py_[j];
+		dz_[e] = pz_[i] - pz_[j];
+	}
+
+	// Force coefficient c = -k * (|d| - l0) / |d|, zero for coincident ends.
+	int e = 0;
+#ifdef QM_SPRING_SSE
+	const __m128 zero = _mm_setzero_ps();
+	for (; e + 4 <= edgeCount; e += 4)
+	{
+		__m128 dx = _mm_loadu_ps(&dx_[e]);
+		__m128 dy = _mm_loadu_ps(&dy_[e]);
+		__m128 dz = _mm_loadu_ps(&dz_[e]);
+		__m128 n = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		__m128 c = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&edgeK_[e]), _mm_sub_ps(_mm_loadu_ps(&edgeL_[e]), n)), n);
+		_mm_storeu_ps(&c_[e], _mm_and_ps(c, _mm_cmpgt_ps(n, zero)));
+	}
+#endif
+	for (; e < edgeCount; e++)
+	{
+		float n = std::sqrt(dx_[e] * dx_[e] + dy_[e] * dy_[e] + dz_[e] * dz_[e]);
+		c_[e] = n > 0.f ? edgeK_[e] * (edgeL_[e] - n) / n : 0.f;
+	}
+
+	// Scatter: the row node accumulates in registers, the column node is pushed back.
+	for (int i = 0; i < nodeCount; i++)
+	{
+		float ax = 0.f, ay = 0.f, az = 0.f;
+		for (int k = rowStart_[i]; k < rowStart_[i + 1]; k++)
+		{
+			int j = edgeJ_[k];
+			float gx = c_[k] * dx_[k], gy = c_[k] * dy_[k], gz = c_[k] * dz_[k];
+			ax += gx; ay += gy; az += gz;
+			fx_[j] -= gx; fy_[j] -= gy; fz_[j] -= gz;
+		}
+		fx_[i] += ax; fy_[i] += ay; fz_[i] += az;
+	}
+
+	for (int i = 0; i < nodeCount; i++)
+		nodes_[i]->AddForce(glm::vec3(fx_[i], fy_[i], fz_[i]));
+}
+
+/**
+ * @brief Inverts a 3x3 row-major matrix. Returns the identity if it is singular.
+ */
+static void invert3(const float* a, float* inv)
+{
+	float c0 = a[4] * a[8] - a[5] * a[7];
+	float c1 = a[5] * a[6] - a[3] * a[8];
+	float c2 = a[3] * a[7] - a[4] * a[6];
+	float det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+	if (det == 0.f)
+	{
+		for (int k = 0; k < 9; k++)
+			inv[k] = (k % 4 == 0) ? 1.f : 0.f;
+		return;
+	}
+	float id = 1.f / det;
+	inv[0] = c0 * id;
+	inv[1] = (a[2] * a[7] - a[1] * a[8]) * id;
+	inv[2] = (a[1] * a[5] - a[2] * a[4]) * id;
+	inv[3] = c1 * id;
+	inv[4] = (a[0] * a[8] - a[2] * a[6]) * id;
+	inv[5] = (a[2] * a[3] - a[0] * a[5]) * id;
+	inv[6] = c2 * id;
+	inv[7] = (a[1] * a[6] - a[0] * a[7]) * id;
+	inv[8] = (a[0] * a[4] - a[1] * a[3]) * id;
+}
+
+int QmSpringNetwork::solveImplicit(float h, int maxIterations, float tolerance)
+{
+	if (dirty_)
+		compress();
+
+	const int nodeCount = (int)nodes_.size();
+	const int edgeCount = (int)edgeJ_.size();
+	const int n3 = 3 * nodeCount;
+
+	// Mass on the diagonal; fixed nodes get the identity and are filtered out.
+	A_.zero();
+	std::vector<glm::vec3>& vel = velScratch_;
+	vel.resize(nodeCount);
+	for (int i = 0; i < nodeCount; i++)
+	{
+		float invMass = nodes_[i]->getInvMass();
+		fixed_[i] = invMass == 0.f;
+		float m = fixed_[i] ? 1.f : 1.f / invMass;
+		float* d = A_.diagonal(i);
+		d[0] = d[4] = d[8] = m;
+		glm::vec3 pos = nodes_[i]->getPos();
+		px_[i] = pos.x; py_[i] = pos.y; pz_[i] = pos.z;
+		vel[i] = nodes_[i]->getVel();
+	}
+	std::fill(b_.begin(), b_.end(), 0.f);
+
+	// Spring forces, Jacobian blocks and right-hand side h * (f + h * K * v).
+	float h2 = h * h;
+	for (int e = 0; e < edgeCount; e++)
+	{
+		int i = edgeI_[e], j = edgeJ_[e];
+		glm::vec3 d(px_[i] - px_[j], py_[i] - py_[j], pz_[i] - pz_[j]);
+		float l = glm::length(d);
+		if (l == 0.f)
+			continue;
+		glm::vec3 u = d / l;
+		float k = edgeK_[e];
+
+		// Ke = k * (u u^T + max(0, 1 - l0 / l) * (I - u u^T)); clamping keeps A positive definite.
+		float s = std::max(0.f, 1.f - edgeL_[e] / l);
+		float Ke[9];
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 3; c++)
+				Ke[3 * r + c] = k * ((1.f - s) * u[r] * u[c] + (r == c ? s : 0.f));
+
+		float* Aii = A_.diagonal(i);
+		float* Ajj = A_.diagonal(j);
+		float* Aij = A_.block(blockIJ_[e]);
+		float* Aji = A_.block(blockJI_[e]);
+		for (int c = 0; c < 9; c++)
+		{
+			float v = h2 * Ke[c];
+			Aii[c] += v; Ajj[c] += v;
+			Aij[c] -= v; Aji[c] -= v;
+		}
+
+		// f_i = -k (l - l0) u, and K v contributes -Ke (v_i - v_j) to node i.
+		glm::vec3 f = u * (-k * (l - edgeL_[e]));
+		glm::vec3 dv = vel[i] - vel[j];
+		glm::vec3 Kdv(Ke[0] * dv.x + Ke[1] * dv.y + Ke[2] * dv.z,
+			Ke[3] * dv.x + Ke[4] * dv.y + Ke[5] * dv.z,
+			Ke[6] * dv.x + Ke[7] * dv.y + Ke[8] * dv.z);
+		glm::vec3 rhs = h * f - h2 * Kdv;
+		b_[3 * i] += rhs.x; b_[3 * i + 1] += rhs.y; b_[3 * i + 2] += rhs.z;
+		b_[3 * j] -= rhs.x; b_[3 * j + 1] -= rhs.y; b_[3 * j + 2] -= rhs.z;
+	}
+
+	for (int i = 0; i < nodeCount; i++)
+		invert3(A_.diagonal(i), &pinv_[9 * i]);
+
+	auto filter = [this, nodeCount](std::vector<float>& v) {
+		for (int i = 0; i < nodeCount; i++)
+			if (fixed_[i])
+				v[3 * i] = v[3 * i + 1] = v[3 * i + 2] = 0.f;
+	};
+	auto dot = [n3](const std::vector<float>& a, const std::vector<float>& b) {
+		double sum = 0.0;
+		for (int k = 0; k < n3; k++)
+			sum += a[k] * b[k];
+		return (float)sum;
+	};
+	auto precondition = [this, nodeCount]() {
+		for (int i = 0; i < nodeCount; i++)
+		{
+			const float* P = &pinv_[9 * i];
+			const float* r = &r_[3 * i];
+			z_[3 * i] = P[0] * r[0] + P[1] * r[1] + P[2] * r[2];
+			z_[3 * i + 1] = P[3] * r[0] + P[4] * r[1] + P[5] * r[2];
+			z_[3 * i + 2] = P[6] * r[0] + P[7] * r[1] + P[8] * r[2];
+		}
+	};
+
+	// Preconditioned conjugate gradient, starting from the previous solution.
+	filter(b_);
+	filter(dv_);
+	A_.multiply(dv_.data(), q_.data());
+	for (int k = 0; k < n3; k++)
+		r_[k] = b_[k] - q_[k];
+	filter(r_);
+	precondition();
+	p_ = z_;
+	float rz = dot(r_, z_);
+	float limit = tolerance * tolerance * dot(b_, b_);
+
+	int it = 0;
+	while (it < maxIterations && dot(r_, r_) > limit)
+	{
+		A_.multiply(p_.data(), q_.data());
+		filter(q_);
+		float pq = dot(p_, q_);
+		if (pq <= 0.f)
+			break;
+		float alpha = rz / pq;
+		for (int k = 0; k < n3; k++)
+		{
+			dv_[k] += alpha * p_[k];
+			r_[k] -= alpha * q_[k];
+		}
+		precondition();
+		float rzNew = dot(r_, z_);
+		float beta = rzNew / rz;
+		rz = rzNew;
+		for (int k = 0; k < n3; k++)
+			p_[k] = z_[k] + beta * p_[k];
+		filter(p_);
+		it++;
+	}
+	lastIterations_ = it;
+
+	// Equivalent force: a semi-implicit step then gives v + dv.
+	for (int i = 0; i < nodeCount; i++)
+		if (!fixed_[i])
+			nodes_[i]->AddForce(glm::vec3(dv_[3 * i], dv_[3 * i + 1], dv_[3 * i + 2]) / (nodes_[i]->getInvMass() * h));
+
+	return it;
+}
+
+int QmSpringNetwork::getLastIterations()
+{
+	return lastIterations_;
+}
+
+void QmSpringNetwork::setRaideur(float k)
+{
+	std::fill(edgeK_.begin(), edgeK_.end(), k);
+}
+
+int QmSpringNetwork::getNodeCount()
+{
+	return (int)nodes_.size();
+}
+
+int QmSpringNetwork::getSpringCount()
+{
+	return (int)edgeJ_.size();
+}
+
+QmParticle* QmSpringNetwork::getNode(int i)
+{
+	return nodes_[i];
+}
+
+QmParticle* QmSpringNetwork::getSpringStart(int e)
+{
+	return nodes_[edgeI_[e]];
+}
+
+QmParticle* QmSpringNetwork::getSpringEnd(int e)
+{
+	return nodes_[edgeJ_[e]];
+}
+
+float QmSpringNetwork::getSpringStiffness(int e)
+{
+	return edgeK_[e];
+}
+
+float QmSpringNetwork::getSpringRestLength(int e)
+{
+	return edgeL_[e];
+}
+
+void QmSpringNetwork::clear()
+{
+	nodes_.clear();
+	nodeIndex_.clear();
+	rowStart_.clear();
+	edgeI_.clear();
+	edgeJ_.clear();
+	edgeK_.clear();
+	edgeL_.clear();
+	dirty_ = true;
+}
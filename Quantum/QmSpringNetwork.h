@@ -0,0 +1,226 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "QmBlockMatrix.h"
+
+namespace Quantum {
+
+	class QmParticle;
+
+	/**
+	 * @class QmSpringNetwork
+	 * @brief Stores many two-way springs in compressed arrays.
+	 *
+	 * A QmSpring only pushes the particle it is registered on, so a two-way
+	 * spring needs two registry entries and computes the same distance twice.
+	 * The network instead keeps every spring once as an edge (i, j, k, l0),
+	 * where i and j index the network's node list, and applies equal and
+	 * opposite Hooke forces to both ends:
+	 *      F_i = -k * (|d| - l0) * (d / |d|),  F_j = -F_i,  d = x_i - x_j
+	 *
+	 * Edges are kept sorted by their first node (CSR layout: rowStart_ gives
+	 * the first edge of every node), so the force on node i is accumulated in
+	 * registers and written once per row.
+	 *
+	 * For stiff springs the network can instead be integrated with backward
+	 * Euler (solveImplicit): the spring Jacobian is assembled into a block
+	 * sparse matrix and the linearized system is solved with a block-Jacobi
+	 * preconditioned conjugate gradient, warm-started from the previous step.
+	 */
+	class QmSpringNetwork {
+	public:
+
+		/**
+		 * @brief Constructs an empty spring network.
+		 */
+		QmSpringNetwork();
+
+		/**
+		 * @brief Destructor. Does not delete the particles.
+		 */
+		~QmSpringNetwork();
+
+		/**
+		 * @brief Returns the node index of a particle, adding it if needed.
+		 *
+		 * @param p Particle to add to the network.
+		 * @return Index of the particle in the node list.
+		 */
+		int addNode(QmParticle* p);
+
+		/**
+		 * @brief Adds a two-way spring between two particles.
+		 *
+		 * @param a  First end of the spring.
+		 * @param b  Second end of the spring.
+		 * @param K  Spring stiffness (Hooke's constant).
+		 * @param lo Rest length of the spring.
+		 */
+		void addSpring(QmParticle* a, QmParticle* b, float K, float lo);
+
+		/**
+		 * @brief Adds a two-way spring between two nodes already in the network.
+		 *
+		 * Skips the particle lookup of the other overload, for bulk construction.
+		 *
+		 * @param i, j Node indices returned by addNode.
+		 */
+		void addSpring(int i, int j, float K, float lo);
+
+		/**
+		 * @brief Removes a particle and every spring attached to it.
+		 *
+		 * The last node takes the index of the removed one.
+		 *
+		 * @param p Particle to remove.
+		 * @return False if the particle is not a node of the network.
+		 */
+		bool removeNode(QmParticle* p);
+
+		/**
+		 * @brief Reserves room for more nodes and springs.
+		 */
+		void reserve(int nodes, int springs);
+
+		/**
+		 * @brief Renumbers the nodes so that connected nodes get close indices.
+		 *
+		 * The spring graph is bisected recursively: each part is ordered
+		 * breadth-first from a node far from its first one (two sweeps), then
+		 * cut in two halves of that order, down to parts of a few nodes. Parts
+		 * are therefore connected chunks of the graph and neighbours end up
+		 * close in the node arrays, whatever the order in which the network
+		 * was built. Springs are then oriented from their lower to their higher
+		 * node and sorted by both ends, so update() and the implicit system
+		 * walk the node arrays almost sequentially.
+		 *
+		 * Only the network's numbering changes: the particles stay where they
+		 * are, a spring may swap its start and end, and the next implicit step
+		 * is not warm-started. Costs O((nodes + springs) log nodes); call it
+		 * once the network is built.
+		 */
+		void reorder();
+
+		/**
+		 * @brief Evaluates every spring once and adds the forces to both ends.
+		 */
+		void update();
+
+		/**
+		 * @brief Applies the springs implicitly (backward Euler) over a step.
+		 *
+		 * Solves (M - h^2 K) dv = h (f + h K v), where f are the spring forces,
+		 * K = df/dx their Jacobian and v the current velocities, then adds
+		 * m * dv / h to each node so that a semi-implicit integration step
+		 * reproduces the backward Euler velocity. Nodes with infinite mass are
+		 * kept fixed. Other forces stay explicit.
+		 *
+		 * @param h             Time step.
+		 * @param maxIterations Maximum number of conjugate gradient iterations.
+		 * @param tolerance     Relative residual at which the solver stops.
+		 * @return Number of conjugate gradient iterations performed.
+		 */
+		int solveImplicit(float h, int maxIterations, float tolerance);
+
+		/**
+		 * @brief Sets the stiffness of every spring of the network.
+		 *
+		 * @param k New spring stiffness.
+		 */
+		void setRaideur(float k);
+
+		/// @return Number of conjugate gradient iterations of the last implicit step.
+		int getLastIterations();
+
+		/// @return Number of particles referenced by the network.
+		int getNodeCount();
+
+		/// @return Number of springs in the network.
+		int getSpringCount();
+
+		/// @return The particle stored at the given node index.
+		QmParticle* getNode(int i);
+
+		/// @return First end of the given spring.
+		QmParticle* getSpringStart(int e);
+
+		/// @return Second end of the given spring.
+		QmParticle* getSpringEnd(int e);
+
+		/// @return Stiffness of the given spring.
+		float getSpringStiffness(int e);
+
+		/// @return Rest length of the given spring.
+		float getSpringRestLength(int e);
+
+		/**
+		 * @brief Removes every node and spring.
+		 */
+		void clear();
+
+	private:
+
+		/**
+		 * @brief Sorts pending edges by first node and rebuilds rowStart_.
+		 */
+		void compress();
+
+		/// @brief Particles referenced by the springs.
+		std::vector<QmParticle*> nodes_;
+
+		/// @brief Lookup from particle to node index.
+		std::unordered_map<QmParticle*, int> nodeIndex_;
+
+		/// @brief Index of the first edge of each node (size nodes + 1).
+		std::vector<int> rowStart_;
+
+		/// @brief Second node of each edge (CSR column index).
+		std::vector<int> edgeJ_;
+
+		/// @brief First node of each edge, kept for random access by edge.
+		std::vector<int> edgeI_;
+
+		/// @brief Stiffness of each edge.
+		std::vector<float> edgeK_;
+
+		/// @brief Rest length of each edge.
+		std::vector<float> edgeL_;
+
+		/// @brief True when edges were added since the last compress().
+		bool dirty_;
+
+		/// @brief Scratch node positions (SoA).
+		std::vector<float> px_, py_, pz_;
+
+		/// @brief Scratch node forces (SoA).
+		std::vector<float> fx_, fy_, fz_;
+
+		/// @brief Scratch edge vectors and force coefficients (SoA).
+		std::vector<float> dx_, dy_, dz_, c_;
+
+		/// @brief System matrix M - h^2 K of the implicit step.
+		QmBlockMatrix A_;
+
+		/// @brief Block (i, j) and (j, i) of each edge in A_.
+		std::vector<int> blockIJ_, blockJI_;
+
+		/// @brief Velocity change of the last implicit step (warm start).
+		std::vector<float> dv_;
+
+		/// @brief Conjugate gradient vectors (interleaved xyz per node).
+		std::vector<float> b_, r_, z_, p_, q_;
+
+		/// @brief Inverse diagonal blocks (block-Jacobi preconditioner).
+		std::vector<float> pinv_;
+
+		/// @brief Nodes kept fixed by the implicit step (infinite mass).
+		std::vector<char> fixed_;
+
+		/// @brief Node velocities at the start of the implicit step.
+		std::vector<glm::vec3> velScratch_;
+
+		/// @brief Iterations of the last implicit step.
+		int lastIterations_;
+	};
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include "QmPerfCounters.h"
+#include "QmAllocTracker.h"
+
+// Set QM_ENABLE_STATS to 0 to compile the tick instrumentation out: the
+// scopes and counters below then expand to nothing and QmTickStats stays zero.
+#ifndef QM_ENABLE_STATS
+#define QM_ENABLE_STATS 1
+#endif
+
+#if QM_ENABLE_STATS
+#define QM_STAT_ADD(stats, counter, n) ((stats).counter += (n))
+#else
+#define QM_STAT_ADD(stats, counter, n) ((void)0)
+#endif
+
+namespace Quantum {
+
+	/**
+	 * @brief Phases of QmWorld::tick(), in execution order.
+	 */
+	enum QmPhase {
+		PHASE_COMMANDS,  ///< Draining the command queue.
+		PHASE_EMIT,      ///< Emitters releasing and expiring particles.
+		PHASE_REORDER,   ///< Morton reordering of the bodies.
+		PHASE_CLEAR,     ///< Clearing accelerations and force accumulators.
+		PHASE_FORCES,    ///< updateForces().
+		PHASE_IMPLICIT,  ///< Implicit spring solve.
+		PHASE_INTEGRATE, ///< Fields, drag and integration.
+		PHASE_BROADPHASE,///< Collision detection.
+		PHASE_RESOLVE,   ///< Collision response.
+		PHASE_COUNT
+	};
+
+	/**
+	 * @struct QmTickStats
+	 * @brief Timings and counters of the last tick.
+	 */
+	struct QmTickStats {
+		/// @brief Seconds spent in each phase.
+		double phaseTime[PHASE_COUNT];
+
+		/// @brief Seconds spent in the whole tick.
+		double tickTime;
+
+		/// @brief Bodies integrated.
+		unsigned long long bodiesIntegrated;
+
+		/// @brief Force registry entries and network springs evaluated.
+		unsigned long long forceEntries;
+
+		/// @brief AABB pairs tested by the broadphase.
+		unsigned long long aabbTests;
+
+		/// @brief Contacts produced by the broadphase.
+		unsigned long long contactsGenerated;
+
+		/// @brief Contacts whose bodies received new velocities.
+		unsigned long long contactsResolved;
+
+		/// @brief Heap allocations made during each phase (QmAllocTracker).
+		unsigned long long phaseAllocs[PHASE_COUNT];
+
+		/// @brief Bytes allocated during each phase.
+		unsigned long long phaseAllocBytes[PHASE_COUNT];
+
+		/// @brief Heap allocations made during the whole tick.
+		unsigned long long tickAllocs;
+
+		/// @brief Bytes allocated during the whole tick.
+		unsigned long long tickAllocBytes;
+
+		/// @brief Hardware events of the ticking thread in each phase (zero unless perf counters are enabled).
+		unsigned long long phaseEvents[PHASE_COUNT][PERF_EVENT_COUNT];
+
+		QmTickStats() { reset(); }
+
+		/**
+		 * @brief Sets every timing and counter to zero.
+		 */
+		void reset()
+		{
+			for (int i = 0; i < PHASE_COUNT; i++)
+			{
+				phaseTime[i] = 0.;
+				phaseAllocs[i] = phaseAllocBytes[i] = 0;
+				for (int e = 0; e < PERF_EVENT_COUNT; e++)
+					phaseEvents[i][e] = 0;
+			}
+			tickTime = 0.;
+			tickAllocs = tickAllocBytes = 0;
+			bodiesIntegrated = forceEntries = aabbTests = contactsGenerated = contactsResolved = 0;
+		}
+
+		/**
+		 * @return Printable name of a phase.
+		 */
+		static const char* phaseName(int phase)
+		{
+			static const char* names[PHASE_COUNT] = { "commands", "emit", "reorder", "clear", "forces", "implicit", "integrate", "broadphase", "resolve" };
+			return phase >= 0 && phase < PHASE_COUNT ? names[phase] : "?";
+		}
+	};
+
+	/**
+	 * @class QmPhaseScope
+	 * @brief Adds the time and the allocations of its scope to one phase of a QmTickStats.
+	 *
+	 * Pass PHASE_COUNT to measure the whole tick (tickTime, tickAllocs). When open perf
+	 * counters are given, the events of the scope are added to phaseEvents too.
+	 */
+	class QmPhaseScope {
+	public:
+#if QM_ENABLE_STATS
+		QmPhaseScope(QmTickStats& stats, int phase, QmPerfCounters* perf = NULL) : stats_(stats), phase_(phase), perf_(perf), events_()
+		{
+			if (perf_ && phase_ < PHASE_COUNT)
+				perf_->read(events_);
+			else
+				perf_ = NULL;
+			allocs_ = QmAllocTracker::getCount();
+			allocBytes_ = QmAllocTracker::getBytes();
+			start_ = std::chrono::steady_clock::now();
+		}
+
+		~QmPhaseScope()
+		{
+			double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+			unsigned long long allocs = QmAllocTracker::getCount() - allocs_;
+			unsigned long long allocBytes = QmAllocTracker::getBytes() - allocBytes_;
+			if (phase_ < PHASE_COUNT)
+			{
+				stats_.phaseTime[phase_] += s;
+				stats_.phaseAllocs[phase_] += allocs;
+				stats_.phaseAllocBytes[phase_] += allocBytes;
+			}
+			else
+			{
+				stats_.tickTime += s;
+				stats_.tickAllocs += allocs;
+				stats_.tickAllocBytes += allocBytes;
+			}
+			if (perf_)
+			{
+				unsigned long long end[PERF_EVENT_COUNT];
+				perf_->read(end);
+				for (int e = 0; e < PERF_EVENT_COUNT; e++)
+					stats_.phaseEvents[phase_][e] += end[e] - events_[e];
+			}
+		}
+
+	private:
+		QmTickStats& stats_;
+		int phase_;
+		QmPerfCounters* perf_;
+		unsigned long long events_[PERF_EVENT_COUNT];
+		unsigned long long allocs_;
+		unsigned long long allocBytes_;
+		std::chrono::steady_clock::time_point start_;
+#else
+		QmPhaseScope(QmTickStats&, int, QmPerfCounters* = NULL) {}
+#endif
+	};
+}
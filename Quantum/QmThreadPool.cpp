@@ -0,0 +1,104 @@
+#include "QmThreadPool.h"
+#include "QmTrace.h"
+#include "QmAllocTracker.h"
+#include <string>
+
+using namespace Quantum;
+
+QmThreadPool::QmThreadPool(int threads) : job_(NULL), call_(NULL), name_("task"), count_(0), next_(0), active_(0), generation_(0), jobAllocs_(0), jobAllocBytes_(0), stop_(false)
+{
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	for (int i = 1; i < threads; i++)
+		workers_.push_back(std::thread(&QmThreadPool::workerLoop, this, i));
+}
+
+QmThreadPool::~QmThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (std::thread& t : workers_)
+		t.join();
+}
+
+int QmThreadPool::getThreadCount()
+{
+	return (int)workers_.size() + 1;
+}
+
+void QmThreadPool::runTasks(int count, Invoker call, const void* fn, const char* name)
+{
+	if (count <= 0)
+		return;
+	if (workers_.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			QM_TRACE_SCOPE_ARG(name, i);
+			call(fn, i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = fn;
+		call_ = call;
+		name_ = name;
+		count_ = count;
+		next_ = 0;
+		active_ = (int)workers_.size();
+		generation_++;
+	}
+	wake_.notify_all();
+
+	drain();
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [this] { return active_ == 0; });
+	job_ = NULL;
+	QmAllocTracker::credit(jobAllocs_, jobAllocBytes_);
+	jobAllocs_ = jobAllocBytes_ = 0;
+}
+
+void QmThreadPool::drain()
+{
+	for (int i = next_++; i < count_; i = next_++)
+	{
+		QM_TRACE_SCOPE_ARG(name_, i);
+		call_(job_, i);
+	}
+}
+
+void QmThreadPool::workerLoop(int index)
+{
+#if QM_ENABLE_TRACE
+	QmTrace::setThreadName(("pool worker " + std::to_string(index)).c_str());
+#else
+	(void)index;
+#endif
+	unsigned long long seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+			if (stop_)
+				return;
+			seen = generation_;
+		}
+
+		unsigned long long allocs = QmAllocTracker::getCount();
+		unsigned long long allocBytes = QmAllocTracker::getBytes();
+		drain();
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobAllocs_ += QmAllocTracker::getCount() - allocs;
+		jobAllocBytes_ += QmAllocTracker::getBytes() - allocBytes;
+		if (--active_ == 0)
+			done_.notify_one();
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Quantum {
+
+	/**
+	 * @class QmThreadPool
+	 * @brief Fixed set of worker threads running indexed tasks.
+	 *
+	 * run() hands tasks 0..count-1 to the workers and to the calling thread,
+	 * and returns once all of them are done. Tasks are taken from a shared
+	 * counter, so which thread runs a task varies, but the split of the work
+	 * into tasks is the caller's and does not. The workers' allocations during
+	 * a job are credited to the caller (QmAllocTracker::credit).
+	 */
+	class QmThreadPool {
+	public:
+
+		/**
+		 * @brief Starts the workers.
+		 *
+		 * @param threads Number of threads running tasks, the caller included.
+		 *                0 uses one per hardware thread.
+		 */
+		QmThreadPool(int threads = 0);
+
+		/**
+		 * @brief Stops and joins the workers.
+		 */
+		~QmThreadPool();
+
+		/**
+		 * @return Number of threads running tasks, the caller included.
+		 */
+		int getThreadCount();
+
+		/**
+		 * @brief Runs fn(0) .. fn(count - 1) and waits for them.
+		 *
+		 * Must not be called from inside a task. Each task is recorded in the
+		 * trace (QmTrace) under the given name, with its index. fn is only
+		 * referenced, never copied, so starting a job does not allocate.
+		 */
+		template <class F>
+		void run(int count, const F& fn, const char* name = "task")
+		{
+			runTasks(count, &invoke<F>, &fn, name);
+		}
+
+	private:
+
+		/// @brief Calls task i of a job given as a type-erased callable.
+		typedef void (*Invoker)(const void* fn, int i);
+
+		template <class F>
+		static void invoke(const void* fn, int i)
+		{
+			(*(const F*)fn)(i);
+		}
+
+		/**
+		 * @brief Runs call(fn, 0) .. call(fn, count - 1) and waits for them.
+		 */
+		void runTasks(int count, Invoker call, const void* fn, const char* name);
+
+		/**
+		 * @brief Runs tasks until the counter passes the task count.
+		 */
+		void drain();
+
+		/**
+		 * @brief Body of a worker thread.
+		 *
+		 * @param index Worker number, from 1, used to name its trace track.
+		 */
+		void workerLoop(int index);
+
+		/// @brief Worker threads.
+		std::vector<std::thread> workers_;
+
+		/// @brief Protects the job description and the counters below.
+		std::mutex mutex_;
+
+		/// @brief Signals workers that a job started or that the pool stops.
+		std::condition_variable wake_;
+
+		/// @brief Signals the caller that the last worker finished.
+		std::condition_variable done_;
+
+		/// @brief Callable of the current job.
+		const void* job_;
+
+		/// @brief Calls the callable of the current job.
+		Invoker call_;
+
+		/// @brief Trace name of the tasks of the current job.
+		const char* name_;
+
+		/// @brief Number of tasks of the current job.
+		int count_;
+
+		/// @brief Next task to run.
+		std::atomic<int> next_;
+
+		/// @brief Workers still running the current job.
+		int active_;
+
+		/// @brief Incremented for every job, so workers notice new ones.
+		unsigned long long generation_;
+
+		/// @brief Allocations and bytes of the workers during the current job.
+		unsigned long long jobAllocs_, jobAllocBytes_;
+
+		/// @brief Set when the workers must exit.
+		bool stop_;
+	};
+}
@@ -0,0 +1,165 @@
+#include "QmTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace Quantum;
+
+namespace {
+
+	/// @brief One finished scope.
+	struct Event {
+		const char* name;
+		long long begin;
+		long long end;
+		int arg;
+	};
+
+	/// @brief Ring of events written by one thread only.
+	struct Buffer {
+		std::vector<Event> events;
+		std::atomic<size_t> head; // events ever written; slot head % size is next
+		int tid;
+		std::string name;
+	};
+
+	/// @brief Every buffer ever registered. Never freed, so threads may still
+	/// record while the program exits.
+	struct Registry {
+		std::mutex mutex;
+		std::vector<Buffer*> buffers;
+		std::atomic<size_t> capacity;
+		std::string exitPath;
+		bool exitRegistered;
+
+		Registry() : capacity(1 << 16), exitRegistered(false) {}
+	};
+
+	Registry& registry()
+	{
+		static Registry* r = new Registry();
+		return *r;
+	}
+
+	thread_local Buffer* localBuffer = NULL;
+
+	/**
+	 * @brief Returns the buffer of the calling thread, registering it on first use.
+	 */
+	Buffer* threadBuffer()
+	{
+		if (!localBuffer)
+		{
+			Registry& r = registry();
+			Buffer* b = new Buffer();
+			b->events.resize(std::max<size_t>(1, r.capacity.load()));
+			b->head = 0;
+			std::lock_guard<std::mutex> lock(r.mutex);
+			b->tid = (int)r.buffers.size() + 1;
+			b->name = "thread " + std::to_string(b->tid);
+			r.buffers.push_back(b);
+			localBuffer = b;
+		}
+		return localBuffer;
+	}
+
+	void dumpAtExit()
+	{
+		Registry& r = registry();
+		QmTrace::disable();
+		if (!r.exitPath.empty() && !QmTrace::dump(r.exitPath.c_str()))
+			fprintf(stderr, "Cannot write trace %s\n", r.exitPath.c_str());
+	}
+}
+
+std::atomic<bool> QmTrace::enabled_(false);
+
+void QmTrace::enable(size_t eventsPerThread, const char* exitPath)
+{
+	Registry& r = registry();
+	r.capacity = eventsPerThread;
+	if (exitPath)
+	{
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.exitPath = exitPath;
+		if (!r.exitRegistered)
+		{
+			std::atexit(dumpAtExit);
+			r.exitRegistered = true;
+		}
+	}
+	now(); // starts the epoch
+	enabled_.store(true, std::memory_order_relaxed);
+}
+
+void QmTrace::disable()
+{
+	enabled_.store(false, std::memory_order_relaxed);
+}
+
+void QmTrace::clear()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (Buffer* b : r.buffers)
+		b->head.store(0, std::memory_order_release);
+}
+
+bool QmTrace::dump(const char* path)
+{
+	FILE* f = fopen(path, "w");
+	if (!f)
+		return false;
+
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+	for (Buffer* b : r.buffers)
+	{
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", b->tid, b->name.c_str());
+		first = false;
+
+		size_t head = b->head.load(std::memory_order_acquire);
+		size_t size = b->events.size();
+		for (size_t i = head > size ? head - size : 0; i < head; i++)
+		{
+			const Event& e = b->events[i % size];
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", e.name, b->tid, e.begin / 1e3, (e.end - e.begin) / 1e3);
+			if (e.arg >= 0)
+				fprintf(f, ",\"args\":{\"task\":%d}", e.arg);
+			fprintf(f, "}");
+		}
+	}
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+}
+
+void QmTrace::setThreadName(const char* name)
+{
+	Buffer* b = threadBuffer();
+	std::lock_guard<std::mutex> lock(registry().mutex);
+	b->name = name;
+}
+
+void QmTrace::record(const char* name, long long begin, long long end, int arg)
+{
+	Buffer* b = threadBuffer();
+	size_t head = b->head.load(std::memory_order_relaxed);
+	Event& e = b->events[head % b->events.size()];
+	e.name = name;
+	e.begin = begin;
+	e.end = end;
+	e.arg = arg;
+	b->head.store(head + 1, std::memory_order_release);
+}
+
+long long QmTrace::now()
+{
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Set QM_ENABLE_TRACE to 0 to compile the trace scopes out entirely. When
+// compiled in, a disabled recorder costs one relaxed load per scope.
+#ifndef QM_ENABLE_TRACE
+#define QM_ENABLE_TRACE 1
+#endif
+
+#define QM_TRACE_CONCAT2(a, b) a##b
+#define QM_TRACE_CONCAT(a, b) QM_TRACE_CONCAT2(a, b)
+
+#if QM_ENABLE_TRACE
+#define QM_TRACE_SCOPE(name) Quantum::QmTraceScope QM_TRACE_CONCAT(qmTraceScope, __LINE__)(name)
+#define QM_TRACE_SCOPE_ARG(name, arg) Quantum::QmTraceScope QM_TRACE_CONCAT(qmTraceScope, __LINE__)(name, arg)
+#else
+#define QM_TRACE_SCOPE(name) ((void)0)
+#define QM_TRACE_SCOPE_ARG(name, arg) ((void)0)
+#endif
+
+namespace Quantum {
+
+	/**
+	 * @class QmTrace
+	 * @brief Timeline of scoped events on every thread, written as Chrome trace JSON.
+	 *
+	 * Each thread records into its own ring buffer, registered the first time
+	 * it records, so recording takes no lock; when a ring is full the oldest
+	 * events are overwritten. The file opens in chrome://tracing and in
+	 * Perfetto (ui.perfetto.dev), one track per thread.
+	 *
+	 * Event names must be string literals (only the pointer is stored).
+	 */
+	class QmTrace {
+	public:
+
+		/**
+		 * @brief Starts recording.
+		 *
+		 * @param eventsPerThread Ring size of each thread; only applies to threads not yet registered.
+		 * @param exitPath        If not NULL, the trace is written to this file when the program exits.
+		 */
+		static void enable(size_t eventsPerThread = 1 << 16, const char* exitPath = NULL);
+
+		/**
+		 * @brief Stops recording; the recorded events are kept.
+		 */
+		static void disable();
+
+		/**
+		 * @return Whether events are being recorded.
+		 */
+		static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief Forgets every recorded event.
+		 */
+		static void clear();
+
+		/**
+		 * @brief Writes the recorded events as Chrome trace JSON.
+		 *
+		 * Call it while no traced work is running (between ticks, or after
+		 * disable()): events written meanwhile may come out torn.
+		 *
+		 * @return False if the file cannot be written.
+		 */
+		static bool dump(const char* path);
+
+		/**
+		 * @brief Names the track of the calling thread.
+		 */
+		static void setThreadName(const char* name);
+
+		/**
+		 * @brief Records a finished event on the calling thread.
+		 *
+		 * @param name  Event name (string literal).
+		 * @param begin Start, in ns since the trace epoch.
+		 * @param end   End, in ns since the trace epoch.
+		 * @param arg   Integer shown in the event details, or -1 for none.
+		 */
+		static void record(const char* name, long long begin, long long end, int arg);
+
+		/**
+		 * @return Nanoseconds since the trace epoch.
+		 */
+		static long long now();
+
+	private:
+
+		/// @brief Whether scopes record.
+		static std::atomic<bool> enabled_;
+	};
+
+	/**
+	 * @class QmTraceScope
+	 * @brief Records its lifetime as one event of the calling thread.
+	 */
+	class QmTraceScope {
+	public:
+		explicit QmTraceScope(const char* name, int arg = -1) : name_(QmTrace::isEnabled() ? name : NULL), arg_(arg), begin_(0)
+		{
+			if (name_)
+				begin_ = QmTrace::now();
+		}
+
+		~QmTraceScope()
+		{
+			if (name_)
+				QmTrace::record(name_, begin_, QmTrace::now(), arg_);
+		}
+
+	private:
+		const char* name_;
+		int arg_;
+		long long begin_;
+	};
+}
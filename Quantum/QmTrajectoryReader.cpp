@@ -0,0 +1,268 @@
+#include "QmTrajectoryReader.h"
+#include <cstring>
+#include "QmTrace.h"
+
+using namespace Quantum;
+
+namespace {
+
+	const char MAGIC[8] = { 'Q', 'M', 'T', 'R', 'A', 'J', 0, 0 };
+
+	size_t streamBytes(size_t n, int bits)
+	{
+		return (n * bits + 7) / 8;
+	}
+
+	/**
+	 * @brief Unpacks n values of bits bits, least significant first, and
+	 *        adds their zigzag decoding to out (or stores it, for a keyframe).
+	 */
+	void unpack(const unsigned char* in, size_t n, int bits, bool keyframe, int32_t* out)
+	{
+		if (bits == 0)
+		{
+			if (keyframe)
+				std::memset(out, 0, n * sizeof(int32_t));
+			return;
+		}
+		const uint32_t mask = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+		size_t left = streamBytes(n, bits);
+		uint64_t acc = 0;
+		int avail = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (avail < bits)
+			{
+				uint32_t word = 0;
+				size_t take = left < 4 ? left : 4;
+				std::memcpy(&word, in, take);
+				in += take;
+				left -= take;
+				acc |= (uint64_t)word << avail;
+				avail += 32;
+			}
+			uint32_t z = (uint32_t)acc & mask;
+			acc >>= bits;
+			avail -= bits;
+			uint32_t delta = (z >> 1) ^ (0u - (z & 1));
+			out[i] = keyframe ? (int32_t)delta : (int32_t)((uint32_t)out[i] + delta);
+		}
+	}
+}
+
+QmTrajectoryReader::QmTrajectoryReader() : frameCount_(0)
+{
+	std::memset(&header_, 0, sizeof(header_));
+	for (int c = 0; c < 6; c++)
+		decoded_[c] = -1;
+}
+
+bool QmTrajectoryReader::open(const char* path)
+{
+	close();
+	if (!file_.open(path))
+		return false;
+	const unsigned char* data = file_.data();
+	uint64_t size = file_.size();
+	if (size < sizeof(header_))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&header_, data, sizeof(header_));
+	if (std::memcmp(header_.magic, MAGIC, sizeof(MAGIC)) != 0 || header_.version != QmTrajectoryWriter::VERSION
+		|| header_.blockSize == 0 || header_.keyframeEvery == 0)
+	{
+		close();
+		return false;
+	}
+
+	// The index, when the writer closed the file.
+	QmTrajectoryTrailer trailer;
+	bool indexed = false;
+	if (size >= sizeof(header_) + sizeof(trailer))
+	{
+		std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+		indexed = trailer.magic == TRAJECTORY_INDEX_MAGIC && trailer.frameCount < 0x7FFFFFFF
+			&& trailer.indexOffset >= sizeof(header_) && trailer.indexOffset <= size
+			&& trailer.indexOffset + trailer.frameCount * sizeof(uint64_t) == size - sizeof(trailer);
+	}
+	uint64_t end = indexed ? trailer.indexOffset : size;
+	if (indexed)
+	{
+		offsets_.resize((size_t)trailer.frameCount);
+		std::memcpy(offsets_.data(), data + trailer.indexOffset, offsets_.size() * sizeof(uint64_t));
+	}
+	else
+	{
+		// Walk the frames; a frame cut short by a crash ends the file.
+		uint64_t offset = sizeof(header_);
+		while (offset + sizeof(QmTrajectoryFrame) <= size && offsets_.size() < 0x7FFFFFFF)
+		{
+			QmTrajectoryFrame frame;
+			std::memcpy(&frame, data + offset, sizeof(frame));
+			if (frame.magic != TRAJECTORY_FRAME_MAGIC || frame.payloadBytes > size - offset - sizeof(frame))
+				break;
+			offsets_.push_back(offset);
+			offset += sizeof(frame) + frame.payloadBytes;
+		}
+	}
+	frameCount_ = (int)offsets_.size();
+
+	// Every frame must lie within the file, so that decoding needs no further checks on its extent.
+	for (int f = 0; f < frameCount_; f++)
+	{
+		uint64_t offset = offsets_[f];
+		if (offset < sizeof(header_) || offset > end - sizeof(QmTrajectoryFrame))
+		{
+			close();
+			return false;
+		}
+		QmTrajectoryFrame frame = frameHeader(f);
+		if (frame.magic != TRAJECTORY_FRAME_MAGIC || frame.payloadBytes > end - offset - sizeof(QmTrajectoryFrame))
+		{
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void QmTrajectoryReader::close()
+{
+	file_.close();
+	std::memset(&header_, 0, sizeof(header_));
+	offsets_.clear();
+	frameCount_ = 0;
+	for (int c = 0; c < 6; c++)
+	{
+		values_[c].clear();
+		decoded_[c] = -1;
+	}
+}
+
+int QmTrajectoryReader::getFrameCount() const
+{
+	return frameCount_;
+}
+
+QmTrajectoryFrame QmTrajectoryReader::frameHeader(int frame) const
+{
+	QmTrajectoryFrame h;
+	std::memcpy(&h, file_.data() + offsets_[frame], sizeof(h));
+	return h;
+}
+
+int QmTrajectoryReader::getSlotCount(int frame) const
+{
+	return frame >= 0 && frame < frameCount_ ? (int)frameHeader(frame).slotCount : 0;
+}
+
+unsigned long long QmTrajectoryReader::getTick(int frame) const
+{
+	return frame >= 0 && frame < frameCount_ ? frameHeader(frame).tick : 0;
+}
+
+float QmTrajectoryReader::getTime(int frame) const
+{
+	return frame >= 0 && frame < frameCount_ ? frameHeader(frame).time : 0.f;
+}
+
+int QmTrajectoryReader::findFrame(float t) const
+{
+	int lo = 0, hi = frameCount_ - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (frameHeader(mid).time <= t)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo < 0 ? 0 : lo;
+}
+
+const QmTrajectoryHeader& QmTrajectoryReader::getHeader() const
+{
+	return header_;
+}
+
+bool QmTrajectoryReader::apply(int frame, int c)
+{
+	QmTrajectoryFrame h = frameHeader(frame);
+	bool keyframe = (h.flags & TRAJECTORY_KEYFRAME) != 0;
+	size_t count = h.slotCount;
+	if (keyframe)
+		values_[c].resize(count);
+	else if (values_[c].size() != count)
+		return false; // deltas need the same slots as the previous frame
+
+	const unsigned char* in = file_.data() + offsets_[frame] + sizeof(h);
+	const unsigned char* end = in + h.payloadBytes;
+	for (size_t first = 0; first < count; first += header_.blockSize)
+	{
+		size_t n = count - first < header_.blockSize ? count - first : header_.blockSize;
+		if (end - in < 8)
+			return false;
+		const unsigned char* widths = in;
+		in += 8;
+		for (int k = 0; k < 6; k++)
+		{
+			if (widths[k] > 32)
+				return false;
+			size_t bytes = streamBytes(n, widths[k]);
+			if ((size_t)(end - in) < bytes)
+				return false;
+			if (k == c)
+				unpack(in, n, widths[k], keyframe, values_[c].data() + first);
+			in += bytes;
+		}
+	}
+	return true;
+}
+
+bool QmTrajectoryReader::decode(int frame, int c)
+{
+	if (decoded_[c] == frame)
+		return true;
+	int key = frame;
+	while (key > 0 && !(frameHeader(key).flags & TRAJECTORY_KEYFRAME))
+		key--;
+	// Continue from the frame held if it is on the way, else restart at the keyframe.
+	int begin = decoded_[c] >= key && decoded_[c] < frame ? decoded_[c] + 1 : key;
+	decoded_[c] = -1;
+	for (int f = begin; f <= frame; f++)
+		if (!apply(f, c))
+			return false;
+	decoded_[c] = frame;
+	return true;
+}
+
+int QmTrajectoryReader::readFrame(int frame, glm::vec3* positions, glm::vec3* velocities, int capacity)
+{
+	if (frame < 0 || frame >= frameCount_)
+		return -1;
+	QM_TRACE_SCOPE_ARG("trajectory_read", frame);
+	int count = (int)frameHeader(frame).slotCount;
+	if (count > capacity)
+		count = capacity < 0 ? 0 : capacity;
+	glm::vec3* out[2] = { positions, velocities };
+	for (int part = 0; part < 2; part++)
+	{
+		if (!out[part])
+			continue;
+		for (int a = 0; a < 3; a++)
+		{
+			int c = 3 * part + a;
+			if (!decode(frame, c))
+				return -1;
+			float origin = part == 0 ? header_.boundMin[a] : 0.f;
+			float step = part == 0 ? header_.positionStep[a] : header_.velocityStep;
+			const int32_t* q = values_[c].data();
+			float* dst = (float*)out[part] + a;
+			for (int i = 0; i < count; i++)
+				dst[3 * i] = origin + (float)q[i] * step;
+		}
+	}
+	return count;
+}
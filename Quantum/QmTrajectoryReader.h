@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "QmMappedFile.h"
+#include "QmTrajectoryWriter.h"
+
+namespace Quantum {
+
+	/**
+	 * @class QmTrajectoryReader
+	 * @brief Plays back a trajectory recorded by QmTrajectoryWriter.
+	 *
+	 * The file is mapped, and frames are found through the index written at
+	 * the end of the file (or by walking the frame headers when it has none).
+	 * Frames are only decoded when read, and only the components asked for:
+	 * reading the next frame applies one delta, while a jump restarts from
+	 * the nearest keyframe before the target.
+	 */
+	class QmTrajectoryReader {
+	public:
+
+		QmTrajectoryReader();
+
+		/**
+		 * @brief Maps a trajectory, closing the previous one.
+		 * @return False if the file cannot be mapped or is not a trajectory.
+		 */
+		bool open(const char* path);
+
+		/**
+		 * @brief Unmaps the file.
+		 */
+		void close();
+
+		/**
+		 * @return Number of frames, 0 when closed.
+		 */
+		int getFrameCount() const;
+
+		/**
+		 * @return Number of slots (body handles) of a frame.
+		 */
+		int getSlotCount(int frame) const;
+
+		/**
+		 * @return World tick count of a frame.
+		 */
+		unsigned long long getTick(int frame) const;
+
+		/**
+		 * @return Simulated time of a frame.
+		 */
+		float getTime(int frame) const;
+
+		/**
+		 * @return Last frame whose time is at most t, 0 if there is none.
+		 */
+		int findFrame(float t) const;
+
+		/**
+		 * @return The file header.
+		 */
+		const QmTrajectoryHeader& getHeader() const;
+
+		/**
+		 * @brief Decodes a frame into buffers indexed by body handle.
+		 *
+		 * Fills the same layout as QmWorld::exportState, so the buffers can go
+		 * straight to the renderer.
+		 *
+		 * @param frame      Frame to read.
+		 * @param positions  Receives the positions (may be NULL).
+		 * @param velocities Receives the velocities (may be NULL).
+		 * @param capacity   Size of the buffers; slots beyond it are not written.
+		 * @return Number of slots written, -1 if the frame is out of range or corrupt.
+		 */
+		int readFrame(int frame, glm::vec3* positions, glm::vec3* velocities, int capacity);
+
+	private:
+
+		QmTrajectoryReader(const QmTrajectoryReader&);
+		QmTrajectoryReader& operator=(const QmTrajectoryReader&);
+
+		/**
+		 * @return Copy of the header of a frame (frames are not aligned in the file).
+		 */
+		QmTrajectoryFrame frameHeader(int frame) const;
+
+		/**
+		 * @brief Brings the quantized values of component c to a frame.
+		 * @return False if a frame on the way is corrupt.
+		 */
+		bool decode(int frame, int c);
+
+		/**
+		 * @brief Applies the stream of component c of a frame to values_[c].
+		 */
+		bool apply(int frame, int c);
+
+		/// @brief Mapped trajectory.
+		QmMappedFile file_;
+
+		/// @brief Copy of the file header.
+		QmTrajectoryHeader header_;
+
+		/// @brief Offset of each frame, from the file's index or found by walking the frames.
+		std::vector<uint64_t> offsets_;
+
+		/// @brief Number of frames.
+		int frameCount_;
+
+		/// @brief Quantized values of each component at frame decoded_[c].
+		std::vector<int32_t> values_[6];
+		int decoded_[6];
+	};
+}
@@ -0,0 +1,335 @@
+#include "QmTrajectoryWriter.h"
+#include <chrono>
+#include <cstring>
+#include "QmWorld.h"
+#include "QmTrace.h"
+
+using namespace Quantum;
+
+static_assert(sizeof(QmTrajectoryHeader) == 64, "QmTrajectoryHeader layout");
+static_assert(sizeof(QmTrajectoryFrame) == 32, "QmTrajectoryFrame layout");
+static_assert(sizeof(QmTrajectoryTrailer) == 32, "QmTrajectoryTrailer layout");
+
+namespace {
+
+	const char MAGIC[8] = { 'Q', 'M', 'T', 'R', 'A', 'J', 0, 0 };
+
+	/// @brief Largest float below 2^31.
+	const float LIMIT = 2147483520.f;
+
+	/**
+	 * @brief Nearest lattice points of one component, saturated to the int32 range.
+	 *
+	 * Written without calls or early exits so that the loop vectorizes; NaN
+	 * saturates to the low end.
+	 */
+	void quantize(const glm::vec3* values, size_t count, int axis, float origin, float invStep, int32_t* out)
+	{
+		const float* v = (const float*)values + axis;
+		for (size_t i = 0; i < count; i++)
+		{
+			float q = (v[3 * i] - origin) * invStep;
+			q = q > -LIMIT ? q : -LIMIT;
+			q = q < LIMIT ? q : LIMIT;
+			out[i] = (int32_t)(q + (q < 0.f ? -0.5f : 0.5f));
+		}
+	}
+
+	uint32_t zigzag(uint32_t delta)
+	{
+		return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+	}
+
+	int bitWidth(uint32_t v)
+	{
+		int bits = 0;
+		while (bits < 32 && (v >> bits) != 0)
+			bits++;
+		return bits;
+	}
+
+	/// @brief Packs n values of bits bits each, least significant first.
+	unsigned char* pack(const uint32_t* v, size_t n, int bits, unsigned char* out)
+	{
+		if (bits == 0)
+			return out;
+		uint64_t acc = 0;
+		int filled = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			acc |= (uint64_t)v[i] << filled;
+			filled += bits;
+			if (filled >= 32)
+			{
+				uint32_t word = (uint32_t)acc;
+				std::memcpy(out, &word, 4);
+				out += 4;
+				acc >>= 32;
+				filled -= 32;
+			}
+		}
+		for (; filled > 0; filled -= 8)
+		{
+			*out++ = (unsigned char)acc;
+			acc >>= 8;
+		}
+		return out;
+	}
+}
+
+QmTrajectoryWriter::QmTrajectoryWriter(const glm::vec3& boundMin, const glm::vec3& boundMax, int positionBits,
+	float velocityStep, int keyframeEvery, int slots)
+	: slots_(slots < 1 ? 1 : slots), head_(0), filled_(0), stop_(false), file_(NULL), sinceKeyframe_(0), failed_(false),
+	frames_(0), bytes_(0), rawBytes_(0), recordSeconds_(0.), stalls_(0)
+{
+	positionBits = positionBits < 1 ? 1 : positionBits > 24 ? 24 : positionBits;
+	glm::vec3 step = (boundMax - boundMin) / (float)((1 << positionBits) - 1);
+	for (int a = 0; a < 3; a++)
+		if (!(step[a] > 0.f))
+			step[a] = 1e-6f; // flat bound
+	if (!(velocityStep > 0.f))
+		velocityStep = 1e-3f;
+
+	std::memset(&header_, 0, sizeof(header_));
+	std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+	header_.version = VERSION;
+	header_.blockSize = BLOCK_SIZE;
+	std::memcpy(header_.boundMin, &boundMin, sizeof(header_.boundMin));
+	std::memcpy(header_.positionStep, &step, sizeof(header_.positionStep));
+	header_.velocityStep = velocityStep;
+	header_.keyframeEvery = keyframeEvery < 1 ? 1 : keyframeEvery;
+	invPositionStep_ = glm::vec3(1.f / step.x, 1.f / step.y, 1.f / step.z);
+	invVelocityStep_ = 1.f / velocityStep;
+	for (int c = 0; c < 6; c++)
+		deltas_[c].resize(BLOCK_SIZE);
+}
+
+QmTrajectoryWriter::~QmTrajectoryWriter()
+{
+	close();
+}
+
+bool QmTrajectoryWriter::open(const char* path)
+{
+	close();
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	if (fwrite(&header_, sizeof(header_), 1, f) != 1)
+	{
+		fclose(f);
+		return false;
+	}
+	file_ = f;
+	head_ = filled_ = 0;
+	stop_ = false;
+	failed_ = false;
+	sinceKeyframe_ = 0;
+	offsets_.clear();
+	for (int c = 0; c < 6; c++)
+		previous_[c].clear();
+	frames_ = rawBytes_ = stalls_ = 0;
+	bytes_ = sizeof(header_);
+	recordSeconds_ = 0.;
+	writer_ = std::thread(&QmTrajectoryWriter::writerLoop, this);
+	return true;
+}
+
+bool QmTrajectoryWriter::close()
+{
+	if (!writer_.joinable())
+		return !failed_;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_one();
+	writer_.join();
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!failed_)
+	{
+		QmTrajectoryTrailer trailer;
+		std::memset(&trailer, 0, sizeof(trailer));
+		trailer.magic = TRAJECTORY_INDEX_MAGIC;
+		trailer.frameCount = offsets_.size();
+		trailer.indexOffset = bytes_;
+		if (fwrite(offsets_.data(), sizeof(uint64_t), offsets_.size(), file_) != offsets_.size()
+			|| fwrite(&trailer, sizeof(trailer), 1, file_) != 1)
+			failed_ = true;
+		bytes_ += offsets_.size() * sizeof(uint64_t) + sizeof(trailer);
+	}
+	if (fclose(file_) != 0)
+		failed_ = true;
+	file_ = NULL;
+	return !failed_;
+}
+
+bool QmTrajectoryWriter::isOpen()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return file_ != NULL;
+}
+
+bool QmTrajectoryWriter::record(QmWorld& world)
+{
+	QM_TRACE_SCOPE("trajectory_record");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!file_ || stop_)
+		return false;
+	if (filled_ == slots_.size())
+	{
+		stalls_++;
+		freed_.wait(lock, [this] { return filled_ < slots_.size(); });
+	}
+	Slot& slot = slots_[head_];
+	lock.unlock();
+
+	// The I/O thread only reads filled slots, so this one is ours.
+	size_t count = (size_t)world.getHandleCount();
+	slot.tick = world.getTickCount();
+	slot.time = world.getTickTime();
+	slot.positions.resize(count);
+	slot.velocities.resize(count);
+	world.exportState(slot.positions.data(), slot.velocities.data(), (int)count);
+
+	lock.lock();
+	head_ = (head_ + 1) % slots_.size();
+	filled_++;
+	recordSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	lock.unlock();
+	wake_.notify_one();
+	return true;
+}
+
+void QmTrajectoryWriter::writerLoop()
+{
+	QmTrace::setThreadName("trajectory writer");
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;)
+	{
+		wake_.wait(lock, [this] { return filled_ > 0 || stop_; });
+		if (filled_ == 0)
+			return; // stopping with nothing left to write
+		const Slot& slot = slots_[(head_ + slots_.size() - filled_) % slots_.size()];
+		lock.unlock();
+
+		size_t bytes = encode(slot);
+		size_t raw = slot.positions.size() * 2 * sizeof(glm::vec3);
+		bool ok;
+		{
+			QM_TRACE_SCOPE("trajectory_write");
+			ok = fwrite(out_.data(), 1, bytes, file_) == bytes;
+		}
+
+		lock.lock();
+		if (ok)
+			offsets_.push_back(bytes_);
+		filled_--;
+		frames_++;
+		bytes_ += bytes;
+		rawBytes_ += raw;
+		if (!ok)
+			failed_ = true;
+		freed_.notify_one();
+	}
+}
+
+size_t QmTrajectoryWriter::encode(const Slot& slot)
+{
+	QM_TRACE_SCOPE("trajectory_encode");
+	size_t count = slot.positions.size();
+	bool keyframe = sinceKeyframe_ % header_.keyframeEvery == 0 || previous_[0].size() != count;
+	sinceKeyframe_ = keyframe ? 1 : sinceKeyframe_ + 1;
+
+	// Quantize into one array per component.
+	for (int c = 0; c < 6; c++)
+		current_[c].resize(count);
+	for (int a = 0; a < 3; a++)
+	{
+		quantize(slot.positions.data(), count, a, header_.boundMin[a], invPositionStep_[a], current_[a].data());
+		quantize(slot.velocities.data(), count, a, 0.f, invVelocityStep_, current_[3 + a].data());
+	}
+
+	// Worst case: every value on 32 bits.
+	size_t blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	size_t worst = sizeof(QmTrajectoryFrame) + blocks * 8 + count * 6 * sizeof(uint32_t);
+	if (out_.size() < worst)
+		out_.resize(worst);
+	unsigned char* out = out_.data() + sizeof(QmTrajectoryFrame);
+	for (size_t b = 0; b < blocks; b++)
+	{
+		size_t first = b * BLOCK_SIZE;
+		size_t n = count - first < BLOCK_SIZE ? count - first : BLOCK_SIZE;
+		unsigned char* widths = out;
+		std::memset(widths, 0, 8);
+		out += 8;
+		for (int c = 0; c < 6; c++)
+		{
+			const int32_t* cur = current_[c].data() + first;
+			uint32_t* d = deltas_[c].data();
+			uint32_t bits = 0;
+			if (keyframe)
+				for (size_t i = 0; i < n; i++)
+				{
+					d[i] = zigzag((uint32_t)cur[i]);
+					bits |= d[i];
+				}
+			else
+			{
+				const int32_t* prev = previous_[c].data() + first;
+				for (size_t i = 0; i < n; i++)
+				{
+					d[i] = zigzag((uint32_t)cur[i] - (uint32_t)prev[i]);
+					bits |= d[i];
+				}
+			}
+			widths[c] = (unsigned char)bitWidth(bits);
+			out = pack(d, n, widths[c], out);
+		}
+	}
+
+	QmTrajectoryFrame frame;
+	std::memset(&frame, 0, sizeof(frame));
+	frame.magic = TRAJECTORY_FRAME_MAGIC;
+	frame.flags = keyframe ? TRAJECTORY_KEYFRAME : 0;
+	frame.tick = slot.tick;
+	frame.time = slot.time;
+	frame.slotCount = (uint32_t)count;
+	frame.payloadBytes = (uint64_t)(out - out_.data()) - sizeof(QmTrajectoryFrame);
+	std::memcpy(out_.data(), &frame, sizeof(frame));
+
+	for (int c = 0; c < 6; c++)
+		current_[c].swap(previous_[c]);
+	return (size_t)(out - out_.data());
+}
+
+unsigned long long QmTrajectoryWriter::getFrames()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return frames_;
+}
+
+unsigned long long QmTrajectoryWriter::getBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return bytes_;
+}
+
+unsigned long long QmTrajectoryWriter::getRawBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return rawBytes_;
+}
+
+double QmTrajectoryWriter::getRecordSeconds()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return recordSeconds_;
+}
+
+unsigned long long QmTrajectoryWriter::getStalls()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stalls_;
+}
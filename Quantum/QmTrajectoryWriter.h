@@ -0,0 +1,250 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	class QmWorld;
+
+	/**
+	 * @struct QmTrajectoryHeader
+	 * @brief First 64 bytes of a trajectory file.
+	 *
+	 * A quantized position is round((p - boundMin) / positionStep) per axis,
+	 * a quantized velocity round(v / velocityStep).
+	 */
+	struct QmTrajectoryHeader {
+		char magic[8];          ///< "QMTRAJ" and two zeros.
+		uint32_t version;       ///< QmTrajectoryWriter::VERSION.
+		uint32_t blockSize;     ///< Slots per block of a frame.
+		float boundMin[3];      ///< Origin of the position lattice.
+		float positionStep[3];  ///< Position lattice spacing per axis.
+		float velocityStep;     ///< Velocity lattice spacing.
+		uint32_t keyframeEvery; ///< Frames between keyframes.
+		uint64_t reserved[2];
+	};
+
+	/**
+	 * @struct QmTrajectoryFrame
+	 * @brief Header of a frame, followed by payloadBytes of blocks.
+	 *
+	 * Frames hold one slot per body handle (see QmWorld::exportState). Each
+	 * block of blockSize slots starts with 8 bit widths, one per component
+	 * (position x, y, z, velocity x, y, z, two unused), followed by one
+	 * packed stream per component: the zigzag-coded difference between the
+	 * quantized value and the one of the previous frame (zero in a
+	 * keyframe), on that many bits, least significant first, padded to a byte.
+	 */
+	struct QmTrajectoryFrame {
+		uint32_t magic;         ///< TRAJECTORY_FRAME_MAGIC.
+		uint32_t flags;         ///< TRAJECTORY_KEYFRAME.
+		uint64_t tick;          ///< QmWorld tick count of the frame.
+		float time;             ///< Simulated time of the frame.
+		uint32_t slotCount;     ///< Number of slots (handles).
+		uint64_t payloadBytes;  ///< Bytes of blocks that follow.
+	};
+
+	/// @brief QmTrajectoryFrame::magic, "QMTF" in a little-endian file.
+	const uint32_t TRAJECTORY_FRAME_MAGIC = 0x46544D51;
+
+	/// @brief Frame flag: the frame does not depend on the previous one.
+	const uint32_t TRAJECTORY_KEYFRAME = 1;
+
+	/**
+	 * @struct QmTrajectoryTrailer
+	 * @brief Last 32 bytes of a closed trajectory file.
+	 *
+	 * The frames are followed by the index: the file offset of each frame,
+	 * as uint64. A file without trailer (writer killed) is still readable
+	 * by walking the frame headers.
+	 */
+	struct QmTrajectoryTrailer {
+		uint32_t magic;         ///< TRAJECTORY_INDEX_MAGIC.
+		uint32_t reserved;
+		uint64_t frameCount;    ///< Entries of the index.
+		uint64_t indexOffset;   ///< Offset of the index from the start of the file.
+		uint64_t reserved2;
+	};
+
+	/// @brief QmTrajectoryTrailer::magic, "QMTI" in a little-endian file.
+	const uint32_t TRAJECTORY_INDEX_MAGIC = 0x49544D51;
+
+	/**
+	 * @class QmTrajectoryWriter
+	 * @brief Records positions and velocities of a world to a compact file.
+	 *
+	 * record() only copies the state into one of a fixed number of slots;
+	 * an I/O thread quantizes, delta-encodes and bit-packs each frame and
+	 * writes it. When every slot is waiting for the I/O thread, record()
+	 * blocks, so memory stays bounded and no frame is lost. A keyframe every
+	 * keyframeEvery frames, and whenever the number of handles changes,
+	 * keeps the file seekable.
+	 */
+	class QmTrajectoryWriter {
+	public:
+
+		/// @brief File format version.
+		static const uint32_t VERSION = 1;
+
+		/// @brief Slots per block.
+		static const uint32_t BLOCK_SIZE = 4096;
+
+		/**
+		 * @brief Sets the quantization.
+		 *
+		 * Positions outside the bound are still recorded, with more bits.
+		 *
+		 * @param boundMin, boundMax Bound of the positions.
+		 * @param positionBits       Bits per axis spanning the bound (1..24).
+		 * @param velocityStep       Resolution of the velocities.
+		 * @param keyframeEvery      Frames between keyframes.
+		 * @param slots              Frames that can wait for the I/O thread.
+		 */
+		QmTrajectoryWriter(const glm::vec3& boundMin, const glm::vec3& boundMax, int positionBits = 16,
+			float velocityStep = 1e-3f, int keyframeEvery = 64, int slots = 2);
+
+		/**
+		 * @brief Closes the file.
+		 */
+		~QmTrajectoryWriter();
+
+		/**
+		 * @brief Creates the file and starts the I/O thread, closing the previous file.
+		 * @return False if the file cannot be created.
+		 */
+		bool open(const char* path);
+
+		/**
+		 * @brief Writes the frames still waiting and the frame index, stops the I/O thread and closes the file.
+		 * @return False if a write failed.
+		 */
+		bool close();
+
+		/**
+		 * @return True between open() and close().
+		 */
+		bool isOpen();
+
+		/**
+		 * @brief Queues a frame of the world. Call between ticks.
+		 *
+		 * QmWorld::setTrajectoryWriter does it at the end of a tick.
+		 *
+		 * @return False if no file is open.
+		 */
+		bool record(QmWorld& world);
+
+		/**
+		 * @return Number of frames written.
+		 */
+		unsigned long long getFrames();
+
+		/**
+		 * @return Bytes written to the file.
+		 */
+		unsigned long long getBytes();
+
+		/**
+		 * @return Bytes the frames would take as floats.
+		 */
+		unsigned long long getRawBytes();
+
+		/**
+		 * @return Seconds spent in record(), waits for a free slot included.
+		 */
+		double getRecordSeconds();
+
+		/**
+		 * @return Number of record() calls that waited for a free slot.
+		 */
+		unsigned long long getStalls();
+
+	private:
+
+		QmTrajectoryWriter(const QmTrajectoryWriter&);
+		QmTrajectoryWriter& operator=(const QmTrajectoryWriter&);
+
+		/// @brief A frame copied by record().
+		struct Slot {
+			unsigned long long tick;
+			float time;
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec3> velocities;
+		};
+
+		/**
+		 * @brief Body of the I/O thread.
+		 */
+		void writerLoop();
+
+		/**
+		 * @brief Encodes a slot at the start of out_ (I/O thread).
+		 * @return Bytes of the encoded frame.
+		 */
+		size_t encode(const Slot& slot);
+
+		/// @brief Header written at the start of the file.
+		QmTrajectoryHeader header_;
+
+		/// @brief Inverse lattice spacings.
+		glm::vec3 invPositionStep_;
+		float invVelocityStep_;
+
+		/// @brief Frames copied by record(), used as a ring.
+		std::vector<Slot> slots_;
+
+		/// @brief Next slot record() fills.
+		size_t head_;
+
+		/// @brief Slots filled and not yet written.
+		size_t filled_;
+
+		/// @brief Set when the I/O thread must exit once the ring is empty.
+		bool stop_;
+
+		/// @brief Protects the ring, stop_ and the counters.
+		std::mutex mutex_;
+
+		/// @brief Signals the I/O thread that a slot was filled or that it must stop.
+		std::condition_variable wake_;
+
+		/// @brief Signals record() that a slot was freed.
+		std::condition_variable freed_;
+
+		/// @brief I/O thread, running while a file is open.
+		std::thread writer_;
+
+		/// @brief Open file, NULL when closed.
+		FILE* file_;
+
+		/// @brief Quantized values of the current and previous frames, one array per component (I/O thread).
+		std::vector<int32_t> current_[6];
+		std::vector<int32_t> previous_[6];
+
+		/// @brief Zigzag-coded differences of one block (I/O thread).
+		std::vector<uint32_t> deltas_[6];
+
+		/// @brief Encoded frame, sized for the worst case (I/O thread).
+		std::vector<unsigned char> out_;
+
+		/// @brief Frames encoded since the last keyframe (I/O thread).
+		unsigned long long sinceKeyframe_;
+
+		/// @brief File offset of each frame written, for the index (I/O thread).
+		std::vector<uint64_t> offsets_;
+
+		/// @brief Set when a write failed.
+		bool failed_;
+
+		unsigned long long frames_;
+		unsigned long long bytes_;
+		unsigned long long rawBytes_;
+		double recordSeconds_;
+		unsigned long long stalls_;
+	};
+}
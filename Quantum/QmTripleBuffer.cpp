@@ -0,0 +1,32 @@
+#include "QmTripleBuffer.h"
+
+using namespace Quantum;
+
+QmTripleBuffer::QmTripleBuffer() : middle_(1), back_(0), front_(2) {}
+
+QmTripleBuffer::~QmTripleBuffer() {}
+
+QmSnapshot& QmTripleBuffer::back()
+{
+	return buffers_[back_];
+}
+
+void QmTripleBuffer::publish()
+{
+	int old = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+	back_ = old & 3;
+}
+
+bool QmTripleBuffer::acquire()
+{
+	if (!(middle_.load(std::memory_order_acquire) & FRESH))
+		return false;
+	int old = middle_.exchange(front_, std::memory_order_acq_rel);
+	front_ = old & 3;
+	return true;
+}
+
+const QmSnapshot& QmTripleBuffer::front()
+{
+	return buffers_[front_];
+}
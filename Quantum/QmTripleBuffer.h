@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	/**
+	 * @struct QmSnapshot
+	 * @brief State of the world published after a tick.
+	 */
+	struct QmSnapshot {
+		/// @brief Number of ticks simulated when the snapshot was taken.
+		unsigned long long tick = 0;
+
+		/// @brief Simulated time when the snapshot was taken.
+		float time = 0.f;
+
+		/// @brief QmWorld::getStateHash() when the snapshot was taken.
+		unsigned long long hash = 0;
+
+		/// @brief Body positions, indexed by body handle (see QmWorld::exportState).
+		std::vector<glm::vec3> positions;
+
+		/// @brief 1 where the handle has a body, 0 where it was removed (its position is stale).
+		std::vector<unsigned char> live;
+	};
+
+	/**
+	 * @class QmTripleBuffer
+	 * @brief Lock-free single-producer / single-consumer triple buffer of snapshots.
+	 *
+	 * The writer fills the back buffer and publishes it by swapping it with
+	 * the middle buffer; the reader swaps the middle buffer with its front
+	 * buffer when a new frame is available. Neither side ever waits: the
+	 * writer can publish faster than the reader consumes (older frames are
+	 * dropped), and the reader always sees the latest complete frame.
+	 */
+	class QmTripleBuffer {
+	public:
+
+		/**
+		 * @brief Constructs three empty snapshots.
+		 */
+		QmTripleBuffer();
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmTripleBuffer();
+
+		/**
+		 * @brief Returns the buffer the writer may fill. Writer thread only.
+		 */
+		QmSnapshot& back();
+
+		/**
+		 * @brief Publishes the back buffer as the latest frame. Writer thread only.
+		 */
+		void publish();
+
+		/**
+		 * @brief Takes the latest published frame if there is a new one. Reader thread only.
+		 *
+		 * @return True if front() changed.
+		 */
+		bool acquire();
+
+		/**
+		 * @brief Returns the frame last taken by acquire(). Reader thread only.
+		 */
+		const QmSnapshot& front();
+
+	private:
+
+		/// @brief Set in middle_ when it holds a frame the reader has not taken.
+		static const int FRESH = 4;
+
+		/// @brief The three snapshots.
+		QmSnapshot buffers_[3];
+
+		/// @brief Index of the middle buffer, plus the FRESH flag.
+		std::atomic<int> middle_;
+
+		/// @brief Index of the buffer owned by the writer.
+		int back_;
+
+		/// @brief Index of the buffer owned by the reader.
+		int front_;
+	};
+}
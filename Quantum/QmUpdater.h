@@ -23,7 +23,7 @@ namespace Quantum {
 		/**
 		 * @brief Virtual destructor.
 		 */
-		~QmUpdater() {};
+		virtual ~QmUpdater() {};
 
 		/**
 		 * @brief Callback invoked when a particle updates its position.
@@ -1,33 +1,134 @@
 #include "stdafx.h"
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 
 #include "QmWorld.h"
+#include "QmTrace.h"
+#include "QmCheckpointer.h"
+#include "QmTrajectoryWriter.h"
+#include "QmEmitter.h"
 
 using namespace Quantum;
 
 QmWorld::QmWorld() :
-	gravity(glm::vec3(0, -9.81, 0))
+	gravity(glm::vec3(0, -9.81, 0)),
+	electricField(glm::vec3(0, 0, 0))
 {
 	std::cout << "Starting Quantum Physics engine." << std::endl;
 	time = 0.f;
 	ticktime = 0.f;
+	chargeInteraction = false;
+	chargeK = 0.f;
+	chargeTheta = 0.7f;
+	tickCount = 0;
+	threadRunning = false;
+	implicitSprings = false;
+	cgMaxIterations = 20;
+	cgTolerance = 1e-3f;
+	nextHandle = 0;
+	pool = NULL;
+	deterministic = false;
+	stateHash = 0;
+	allocWarmup = -1;
+	allocViolations = 0;
+	checkpointer = NULL;
+	checkpointEvery = 1;
+	trajectoryWriter = NULL;
+	trajectoryEvery = 1;
+	reorderEvery = 0;
+	quantizedBroadphase = true;
+	bodiesVersion = 0;
+	spatialVersion = 0;
 }
 
 QmWorld::~QmWorld()
 {
+	stopThread();
 }
 
 float QmWorld::tick(float t, bool g, float damping, bool euler, bool c) 
 {
 	// former world::simulate
-	ClearParticles();
-	if (g)
-		ApplyGravity();
-	updateForces();
-	integrate(t, damping, euler);
-	if(c)
-		resolve(broadphase());
+	stats.reset();
+	unsigned long long allocs = QmAllocTracker::getCount();
+	QmPerfCounters* perf = perfCounters.isOpen() ? &perfCounters : NULL;
+	{
+		QmPhaseScope tickScope(stats, PHASE_COUNT, perf);
+		QM_TRACE_SCOPE("tick");
+		{
+			QmPhaseScope scope(stats, PHASE_COMMANDS, perf);
+			QM_TRACE_SCOPE("commands");
+			processCommands();
+		}
+		if (!emitters.empty())
+		{
+			QmPhaseScope scope(stats, PHASE_EMIT, perf);
+			QM_TRACE_SCOPE("emit");
+			for (QmEmitter* e : emitters)
+				e->update(*this, t);
+		}
+		if (reorderEvery > 0 && tickCount % reorderEvery == 0)
+		{
+			QmPhaseScope scope(stats, PHASE_REORDER, perf);
+			QM_TRACE_SCOPE("reorder");
+			updateSpatialOrder();
+		}
+		{
+			QmPhaseScope scope(stats, PHASE_CLEAR, perf);
+			QM_TRACE_SCOPE("clear");
+			ClearParticles();
+		}
+		{
+			QmPhaseScope scope(stats, PHASE_FORCES, perf);
+			QM_TRACE_SCOPE("forces");
+			updateForces();
+		}
+		if (implicitSprings)
+		{
+			QmPhaseScope scope(stats, PHASE_IMPLICIT, perf);
+			QM_TRACE_SCOPE("implicit");
+			for (QmSpringNetwork* net : springNetworks)
+			{
+				net->solveImplicit(t, cgMaxIterations, cgTolerance);
+				QM_STAT_ADD(stats, forceEntries, net->getSpringCount());
+			}
+		}
+		{
+			QmPhaseScope scope(stats, PHASE_INTEGRATE, perf);
+			QM_TRACE_SCOPE("integrate");
+			integrate(t, damping, euler, g);
+		}
+		if (c)
+		{
+			{
+				QmPhaseScope scope(stats, PHASE_BROADPHASE, perf);
+				QM_TRACE_SCOPE("broadphase");
+				broadphase();
+			}
+			QmPhaseScope scope(stats, PHASE_RESOLVE, perf);
+			QM_TRACE_SCOPE("resolve");
+			resolve(contacts);
+		}
+	}
 	ticktime += t;
+	tickCount++;
+	if (deterministic)
+		stateHash = computeStateHash();
+	if (allocWarmup > 0)
+		allocWarmup--;
+	else if (allocWarmup == 0 && QmAllocTracker::getCount() != allocs)
+	{
+		if (allocViolations == 0)
+			std::cout << "Tick " << tickCount << " allocated " << QmAllocTracker::getCount() - allocs << " times after the warm-up." << std::endl;
+		allocViolations++;
+	}
+	// After the allocation check: capturing the image may allocate.
+	if (checkpointer && tickCount % checkpointEvery == 0)
+		checkpointer->checkpoint(*this);
+	if (trajectoryWriter && tickCount % trajectoryEvery == 0)
+		trajectoryWriter->record(*this);
 	return time - ticktime; // the remaining time interval
 }
 
@@ -48,12 +149,267 @@ void QmWorld::simulate(float t, bool g, bool useDelta, float damping, bool euler
 }
 
 
-void QmWorld::integrate(float t, float damping, bool euler)
+void QmWorld::startThread(float step, bool g, float damping, bool euler, bool c)
+{
+	stopThread();
+	setThreadParameters(g, damping, euler, c);
+	threadRunning = true;
+	worker = std::thread(&QmWorld::threadLoop, this, step);
+}
+
+void QmWorld::stopThread()
+{
+	threadRunning = false;
+	if (worker.joinable())
+		worker.join();
+}
+
+bool QmWorld::isThreadRunning()
+{
+	return threadRunning;
+}
+
+void QmWorld::setThreadParameters(bool g, float damping, bool euler, bool c)
+{
+	threadGravity = g;
+	threadDamping = damping;
+	threadEuler = euler;
+	threadCollisions = c;
+}
+
+void QmWorld::threadLoop(float step)
+{
+	using clock = std::chrono::steady_clock;
+	const clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(step));
+	clock::time_point next = clock::now();
+	while (threadRunning)
+	{
+		tick(step, threadGravity, threadDamping, threadEuler, threadCollisions);
+		publish();
+
+		next += period;
+		clock::time_point now = clock::now();
+		if (next > now)
+			std::this_thread::sleep_until(next);
+		else if (now - next > 10 * period)
+			next = now; // too far behind: drop the backlog instead of spiralling
+	}
+}
+
+void QmWorld::publish()
+{
+	QmSnapshot& s = snapshots.back();
+	s.tick = tickCount;
+	s.time = ticktime;
+	s.hash = stateHash;
+	s.positions.resize(getHandleCount());
+	exportState(s.positions.data(), NULL, (int)s.positions.size());
+	s.live.resize(s.positions.size());
+	for (size_t h = 0; h < s.live.size(); h++)
+		s.live[h] = getBodyIndex((int)h) >= 0;
+	snapshots.publish();
+}
+
+bool QmWorld::acquireSnapshot()
+{
+	return snapshots.acquire();
+}
+
+const QmSnapshot& QmWorld::getSnapshot()
+{
+	return snapshots.front();
+}
+
+void QmWorld::integrate(float t, float damping, bool euler, bool g)
 {
 	time += t;
+	bool field = electricField != glm::vec3(0, 0, 0);
+	parallelFor((int)bodies.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			QmParticle* p = (QmParticle*)bodies[i];
+			if (g && p->IsAcc())
+				p->setAcc(gravity);
+
+			glm::vec3 f(0, 0, 0);
+			if (field)
+				f += electricField * p->getCharge();
+			float k1 = linearDrag[i], k2 = quadraticDrag[i];
+			if (k1 != 0.f || k2 != 0.f)
+			{
+				// F = -(k1 |v| + k2 |v|^2) v / |v|
+				glm::vec3 v = p->getVel();
+				float N = glm::length(v);
+				f -= v * (k1 + k2 * N);
+			}
+			if (field || k1 != 0.f || k2 != 0.f)
+				p->AddForce(f);
+
+			p->integrate(t, damping, euler);
+		}
+	}, "integrate");
+	QM_STAT_ADD(stats, bodiesIntegrated, bodies.size());
+}
+
+int QmWorld::partitionCount()
+{
+	// Fixed in deterministic mode, so that partial sums never depend on the pool.
+	if (deterministic)
+		return 32;
+	return pool ? 4 * pool->getThreadCount() : 1;
+}
+
+void QmWorld::setThreadPool(QmThreadPool* p)
+{
+	pool = p;
+}
+
+void QmWorld::setDeterministic(bool enable)
+{
+	deterministic = enable;
+	stateHash = enable ? computeStateHash() : 0;
+}
+
+bool QmWorld::isDeterministic()
+{
+	return deterministic;
+}
+
+unsigned long long QmWorld::computeStateHash()
+{
+	unsigned long long h = 14695981039346656037ULL;
+	auto mix = [&h](float v) {
+		unsigned int bits;
+		std::memcpy(&bits, &v, sizeof(bits));
+		for (int k = 0; k < 4; k++)
+		{
+			h ^= (bits >> (8 * k)) & 0xff;
+			h *= 1099511628211ULL;
+		}
+	};
 	for (QmBody* b : bodies)
-		b->integrate(t, damping, euler);
-	
+	{
+		QmParticle* p = (QmParticle*)b;
+		glm::vec3 x = p->getPos(), v = p->getVel();
+		mix(x.x); mix(x.y); mix(x.z);
+		mix(v.x); mix(v.y); mix(v.z);
+	}
+	return h;
+}
+
+unsigned long long QmWorld::getStateHash()
+{
+	return stateHash;
+}
+
+unsigned long long QmWorld::getTickCount()
+{
+	return tickCount;
+}
+
+float QmWorld::getTickTime()
+{
+	return ticktime;
+}
+
+const QmTickStats& QmWorld::getStats()
+{
+	return stats;
+}
+
+void QmWorld::setAllocationCheck(int warmupTicks)
+{
+	allocWarmup = warmupTicks < 0 ? -1 : warmupTicks;
+	allocViolations = 0;
+}
+
+unsigned long long QmWorld::getAllocationViolations()
+{
+	return allocViolations;
+}
+
+void QmWorld::setCheckpointer(QmCheckpointer* checkpointer, int everyTicks)
+{
+	this->checkpointer = checkpointer;
+	checkpointEvery = everyTicks < 1 ? 1 : everyTicks;
+}
+
+void QmWorld::setTrajectoryWriter(QmTrajectoryWriter* writer, int everyTicks)
+{
+	trajectoryWriter = writer;
+	trajectoryEvery = everyTicks < 1 ? 1 : everyTicks;
+}
+
+void QmWorld::updateSpatialOrder()
+{
+	int count = (int)bodies.size();
+	mortonPos.resize(count);
+	for (int i = 0; i < count; i++)
+		mortonPos[i] = ((QmParticle*)bodies[i])->getPos();
+	const std::vector<int>& order = mortonOrder.sort(mortonPos.data(), count);
+	// Room for the bodies reserved since (emitters), so that getSpatialOrder() does not allocate.
+	spatialBodies.reserve(bodies.capacity());
+	spatialPlaced.reserve(bodies.capacity());
+	spatialHandles.resize(count);
+	spatialBodies.resize(count);
+	for (int k = 0; k < count; k++)
+	{
+		spatialHandles[k] = bodyHandles[order[k]];
+		spatialBodies[k] = bodies[order[k]];
+	}
+	spatialVersion = bodiesVersion;
+}
+
+const std::vector<QmBody*>& QmWorld::getSpatialOrder()
+{
+	if (spatialHandles.empty())
+		return bodies;
+	if (spatialVersion != bodiesVersion)
+	{
+		// Bodies changed since the sort: drop the removed ones, append the new ones.
+		int count = (int)bodies.size();
+		spatialPlaced.assign(count, 0);
+		spatialBodies.clear();
+		for (int h : spatialHandles)
+		{
+			int i = h < (int)handleIndex.size() ? handleIndex[h] : -1;
+			if (i >= 0 && !spatialPlaced[i])
+			{
+				spatialPlaced[i] = 1;
+				spatialBodies.push_back(bodies[i]);
+			}
+		}
+		for (int i = 0; i < count; i++)
+			if (!spatialPlaced[i])
+				spatialBodies.push_back(bodies[i]);
+		spatialVersion = bodiesVersion;
+	}
+	return spatialBodies;
+}
+
+void QmWorld::setReorderInterval(int everyTicks)
+{
+	reorderEvery = everyTicks > 0 ? everyTicks : 0;
+	if (reorderEvery == 0)
+	{
+		spatialHandles.clear();
+		spatialBodies.clear();
+	}
+}
+
+int QmWorld::getReorderInterval()
+{
+	return reorderEvery;
+}
+
+bool QmWorld::enablePerfCounters(bool enable)
+{
+	if (!enable)
+	{
+		perfCounters.close();
+		return false;
+	}
+	return perfCounters.isOpen() || perfCounters.open();
 }
 
 void QmWorld::interpolate(float dt, float damping, bool euler)
@@ -68,29 +424,89 @@ bool QmWorld::intersect(AABB a, AABB b) {
 		(a.getMin().z <= b.getMax().z && a.getMax().z >= b.getMin().z);
 }
 
-std::list<QmContact> QmWorld::broadphase()
+void QmWorld::setQuantizedBroadphase(bool enable)
+{
+	quantizedBroadphase = enable;
+}
+
+bool QmWorld::getQuantizedBroadphase()
+{
+	return quantizedBroadphase;
+}
+
+const std::vector<QmContact>& QmWorld::broadphase()
 {
-	std::list<QmContact>* ContactList = new std::list<QmContact>();
-	for (QmBody* b1 : bodies)
+	contacts.clear();
+	int count = (int)bodies.size();
+	int tasks = pool ? std::min(partitionCount(), count) : 1;
+	// Each partition of first bodies collects its own contacts; appending them
+	// in partition order gives the same list as the sequential loop.
+	if ((int)contactParts.size() < tasks)
+		contactParts.resize(tasks);
+	for (int k = 0; k < tasks; k++)
+		contactParts[k].clear();
+	std::vector<std::vector<QmContact>>& parts = contactParts;
+	// Second bodies are filtered candidateChunk at a time, so the candidate
+	// buffers stay small however many bodies there are.
+	const int candidateChunk = 256;
+	if (quantizedBroadphase)
 	{
-		for (QmBody* b2 : bodies)
+		// Candidates in body order, so the contacts come in the same order.
+		packedBoxes.pack(bodies);
+		if ((int)candidateParts.size() < tasks)
+			candidateParts.resize(tasks);
+		for (int k = 0; k < tasks; k++)
+			candidateParts[k].resize(candidateChunk);
+	}
+	auto collect = [&](int k) {
+		for (int i = (int)((long long)k * count / tasks); i < (int)((long long)(k + 1) * count / tasks); i++)
 		{
-			if (intersect(((QmParticle*)b1)->getAABB(), ((QmParticle*)b2)->getAABB()))
+			QmBody* b1 = bodies[i];
+			if (quantizedBroadphase)
 			{
-				QmContact contact = QmContact((QmParticle*)b1, (QmParticle*)b2);
-				ContactList->push_back(contact);
+				int* candidates = candidateParts[k].data();
+				for (int begin = 0; begin < count; begin += candidateChunk)
+				{
+					int n = packedBoxes.query(i, begin, std::min(begin + candidateChunk, count), candidates);
+					for (int c = 0; c < n; c++)
+					{
+						QmBody* b2 = bodies[candidates[c]];
+						if (intersect(((QmParticle*)b1)->getAABB(), ((QmParticle*)b2)->getAABB()))
+							parts[k].push_back(QmContact((QmParticle*)b1, (QmParticle*)b2));
+					}
+				}
+				continue;
 			}
-		}
-		/*for (HalfSpace* h : halfSpaces)
-		{
-			if (intersect(((QmParticle*)b1)->getAABB(), h->getAABB()))
+			for (QmBody* b2 : bodies)
 			{
-				QmContact contact = QmContact((QmParticle*)b1, (QmParticle*)h);
-				ContactHalf->push_back(contact);
+				if (intersect(((QmParticle*)b1)->getAABB(), ((QmParticle*)b2)->getAABB()))
+				{
+					QmContact contact = QmContact((QmParticle*)b1, (QmParticle*)b2);
+					parts[k].push_back(contact);
+				}
 			}
-		}*/
-	}
-	return *ContactList;
+			/*for (HalfSpace* h : halfSpaces)
+			{
+				if (intersect(((QmParticle*)b1)->getAABB(), h->getAABB()))
+				{
+					QmContact contact = QmContact((QmParticle*)b1, (QmParticle*)h);
+					ContactHalf->push_back(contact);
+				}
+			}*/
+		}
+	};
+	if (tasks > 1)
+		pool->run(tasks, collect, "broadphase");
+	else if (tasks == 1)
+		collect(0);
+	if (tasks > 1)
+		for (int k = 0; k < tasks; k++)
+			contacts.insert(contacts.end(), parts[k].begin(), parts[k].end());
+	else if (tasks == 1)
+		contacts.swap(parts[0]);
+	QM_STAT_ADD(stats, aabbTests, (unsigned long long)count * count);
+	QM_STAT_ADD(stats, contactsGenerated, contacts.size());
+	return contacts;
 }
 
 //std::list<QmContact> QmWorld::narrowphase(QmParticle* b1, QmParticle* b2)
@@ -106,7 +522,7 @@ std::list<QmContact> QmWorld::broadphase()
 //	return *ContactList;
 //}
 
-void QmWorld::resolve(std::list<QmContact> cList)
+void QmWorld::resolve(const std::vector<QmContact>& cList)
 {
 	for (QmContact c : cList) 
 	{
@@ -135,6 +551,7 @@ void QmWorld::resolve(std::list<QmContact> cList)
 			// Recombine with the unchanged parallel components
 			c.getB1()->setVel(v1 + vpara1);
 			c.getB2()->setVel(v2 + vpara2);
+			QM_STAT_ADD(stats, contactsResolved, 1);
 		}
 		
 	}
@@ -161,17 +578,251 @@ void QmWorld::CreateBox()
 	halfSpaces.push_back(new HalfSpace(glm::vec3(0, 0, -1), glm::vec3(6, 6, 6)));
 }
 
-void QmWorld::addBody(QmBody* b)
+void QmWorld::addHalfSpace(HalfSpace* h)
+{
+	halfSpaces.push_back(h);
+}
+
+void QmWorld::addEmitter(QmEmitter* e)
+{
+	// Room for every particle the emitters may still release.
+	int room = e->getCapacity();
+	for (QmEmitter* other : emitters)
+		room += other->getCapacity() - other->getAliveCount();
+	reserveBodies(room);
+	e->attach(*this);
+	emitters.push_back(e);
+}
+
+const std::vector<QmEmitter*>& QmWorld::getEmitters()
 {
+	return emitters;
+}
+
+const std::vector<HalfSpace*>& QmWorld::getHalfSpaces()
+{
+	return halfSpaces;
+}
+
+int QmWorld::addBody(QmBody* b)
+{
+	int h = nextHandle++;
+	insertBody(b, h, 0.f, 0.f);
+	return h;
+}
+
+void QmWorld::insertBody(QmBody* b, int h, float K1, float K2)
+{
+	if (h >= (int)handleIndex.size())
+		handleIndex.resize(h + 1, -1);
+	handleIndex[h] = (int)bodies.size();
+	bodiesVersion++;
 	bodies.push_back(b);
+	bodyHandles.push_back(h);
+	linearDrag.push_back(K1);
+	quadraticDrag.push_back(K2);
+}
+
+void QmWorld::reserveBodies(int count)
+{
+	size_t n = bodies.size() + (count > 0 ? count : 0);
+	bodies.reserve(n);
+	bodyHandles.reserve(n);
+	linearDrag.reserve(n);
+	quadraticDrag.reserve(n);
+	handleIndex.reserve((size_t)nextHandle + (count > 0 ? count : 0));
+}
+
+int QmWorld::addBodies(QmParticle* const* particles, int count, const float* K1, const float* K2)
+{
+	int first = nextHandle.fetch_add(count);
+	size_t start = bodies.size();
+	size_t n = start + count;
+	if (first + count > (int)handleIndex.size())
+		handleIndex.resize(first + count, -1);
+	bodiesVersion++;
+	bodies.insert(bodies.end(), particles, particles + count);
+	bodyHandles.resize(n);
+	linearDrag.resize(n, 0.f);
+	quadraticDrag.resize(n, 0.f);
+	for (int i = 0; i < count; i++)
+	{
+		bodyHandles[start + i] = first + i;
+		handleIndex[first + i] = (int)(start + i);
+	}
+	if (K1)
+		std::copy(K1, K1 + count, linearDrag.begin() + start);
+	if (K2)
+		std::copy(K2, K2 + count, quadraticDrag.begin() + start);
+	return first;
+}
+
+int QmWorld::getBodyCount()
+{
+	return (int)bodies.size();
+}
+
+int QmWorld::getHandleCount()
+{
+	return nextHandle;
+}
+
+int QmWorld::getBodyIndex(int h)
+{
+	if (h < 0 || h >= (int)handleIndex.size())
+		return -1;
+	return handleIndex[h];
+}
+
+int QmWorld::exportState(glm::vec3* positions, glm::vec3* velocities, int capacity)
+{
+	// Handles are unique, so the ranges write disjoint slots.
+	std::atomic<int> count(0);
+	parallelFor((int)bodies.size(), [&](int begin, int end) {
+		int written = 0;
+		for (int i = begin; i < end; i++)
+		{
+			int h = bodyHandles[i];
+			if (h >= capacity)
+				continue;
+			QmParticle* p = (QmParticle*)bodies[i];
+			if (positions)
+				positions[h] = p->getPos();
+			if (velocities)
+				velocities[h] = p->getVel();
+			written++;
+		}
+		count.fetch_add(written, std::memory_order_relaxed);
+	}, "export");
+	return count.load(std::memory_order_relaxed);
+}
+
+int QmWorld::postSpawn(QmParticle* p, float K1, float K2)
+{
+	QmCommand c;
+	c.type = CMD_SPAWN;
+	c.particle = p;
+	c.generator = NULL;
+	c.emitter = NULL;
+	c.value = glm::vec3(0);
+	c.k1 = K1;
+	c.k2 = K2;
+	c.handle = nextHandle++;
+	if (!commands.push(c))
+		return -1; // the reserved handle stays unused
+	return c.handle;
+}
+
+bool QmWorld::post(QmCommandType type, int handle, glm::vec3 value, float k1)
+{
+	QmCommand c;
+	c.type = type;
+	c.particle = NULL;
+	c.generator = NULL;
+	c.emitter = NULL;
+	c.value = value;
+	c.k1 = k1;
+	c.k2 = 0.f;
+	c.handle = handle;
+	return commands.push(c);
+}
+
+bool QmWorld::postRemove(int handle)
+{
+	return post(CMD_REMOVE, handle, glm::vec3(0), 0.f);
+}
+
+bool QmWorld::postPosition(int handle, glm::vec3 pos)
+{
+	return post(CMD_SET_POSITION, handle, pos, 0.f);
+}
+
+bool QmWorld::postVelocity(int handle, glm::vec3 vel)
+{
+	return post(CMD_SET_VELOCITY, handle, vel, 0.f);
+}
+
+bool QmWorld::postCharge(int handle, float q)
+{
+	return post(CMD_SET_CHARGE, handle, glm::vec3(0), q);
 }
 
-std::vector<QmBody*> QmWorld::getBodies()
+bool QmWorld::postForceRegistry(int handle, QmForceGenerator* fg)
+{
+	QmCommand c;
+	c.type = CMD_ADD_FORCE;
+	c.particle = NULL;
+	c.generator = fg;
+	c.emitter = NULL;
+	c.value = glm::vec3(0);
+	c.k1 = 0.f;
+	c.k2 = 0.f;
+	c.handle = handle;
+	return commands.push(c);
+}
+
+bool QmWorld::postBurst(QmEmitter* e, int count, glm::vec3 pos)
+{
+	QmCommand c;
+	c.type = CMD_BURST;
+	c.particle = NULL;
+	c.generator = NULL;
+	c.emitter = e;
+	c.value = pos;
+	c.k1 = 0.f;
+	c.k2 = 0.f;
+	c.handle = count;
+	return commands.push(c);
+}
+
+void QmWorld::processCommands()
+{
+	QmCommand c;
+	while (commands.pop(c))
+	{
+		// Resolve the target now: it may have been removed since the command was posted.
+		QmParticle* p = NULL;
+		if (c.type != CMD_SPAWN && c.type != CMD_BURST)
+		{
+			int i = getBodyIndex(c.handle);
+			if (i < 0)
+				continue;
+			p = (QmParticle*)bodies[i];
+		}
+		switch (c.type)
+		{
+		case CMD_SPAWN:
+			insertBody(c.particle, c.handle, c.k1, c.k2);
+			break;
+		case CMD_REMOVE:
+			DelParticle(p);
+			break;
+		case CMD_SET_POSITION:
+			p->setPos(c.value);
+			break;
+		case CMD_SET_VELOCITY:
+			p->setVel(c.value);
+			break;
+		case CMD_SET_CHARGE:
+			p->setCharge(c.k1);
+			break;
+		case CMD_ADD_FORCE:
+			AddForceRegistry(new QmForceRegistry(p, c.generator));
+			break;
+		case CMD_BURST:
+			c.emitter->getSpawn().setPosition(c.value);
+			c.emitter->burst(c.handle);
+			break;
+		}
+	}
+}
+
+const std::vector<QmBody*>& QmWorld::getBodies()
 {
 	return bodies;
 }
 
-std::list<QmForceRegistry*> QmWorld::getForces()
+const std::list<QmForceRegistry*>& QmWorld::getForces()
 {
 	return forceRegistry;
 }
@@ -184,25 +835,169 @@ void QmWorld::ApplyGravity() {
 
 void QmWorld::ChangeRaideur(int K) {
 	for (QmForceRegistry* fr : forceRegistry)
-		((QmSpring*)fr->fg)->setRaideur(K);
+		if (fr->fg->getType() == FORCE_SPRING)
+			((QmSpring*)fr->fg)->setRaideur(K);
+	for (QmSpringNetwork* net : springNetworks)
+		net->setRaideur((float)K);
 }
 
 void QmWorld::updateForces() {
 	for (QmForceRegistry* fr : forceRegistry)
 		fr->fg->update(fr->p);
+	QM_STAT_ADD(stats, forceEntries, forceRegistry.size());
+	if (!implicitSprings)
+		for (QmSpringNetwork* net : springNetworks)
+		{
+			net->update();
+			QM_STAT_ADD(stats, forceEntries, net->getSpringCount());
+		}
+	for (QmCutoffMagnetism* m : cutoffForces)
+		m->update(getSpatialOrder(), pool, pool || deterministic ? partitionCount() : 1);
+	if (chargeInteraction)
+		applyChargeInteraction();
+}
+
+void QmWorld::setChargeInteraction(bool enable, float K, float theta) {
+	chargeInteraction = enable;
+	chargeK = K;
+	chargeTheta = theta;
+}
+
+void QmWorld::applyChargeInteraction() {
+	charged.clear();
+	chargedPos.clear();
+	chargedQ.clear();
+	for (QmBody* b : getSpatialOrder())
+	{
+		QmParticle* p = (QmParticle*)b;
+		if (p->getCharge() != 0.f)
+		{
+			charged.push_back(p);
+			chargedPos.push_back(p->getPos());
+			chargedQ.push_back(p->getCharge());
+		}
+	}
+
+	chargedField.resize(charged.size());
+	chargeTree.build(chargedPos.data(), chargedQ.data(), (int)charged.size());
+	chargeTree.evaluate(chargeTheta, chargedField.data(), pool);
+	for (size_t i = 0; i < charged.size(); i++)
+		charged[i]->AddForce(chargedField[i] * (chargeK * chargedQ[i]));
+}
+
+int QmWorld::AddParticle(QmParticle* p) {
+	return addBody(p);
+}
+
+int QmWorld::AddParticle(QmParticle* p, float K1, float K2) {
+	int h = nextHandle++;
+	insertBody(p, h, K1, K2);
+	return h;
+}
+
+void QmWorld::setGravity(glm::vec3 g) {
+	gravity = g;
 }
 
-void QmWorld::AddParticle(QmParticle* p) {
-	bodies.push_back(p);
+void QmWorld::setElectricField(glm::vec3 E) {
+	electricField = E;
 }
 
 void QmWorld::AddForceRegistry(QmForceRegistry* fg) {
 	forceRegistry.push_back(fg);
 }
 
-void QmWorld::DelParticle(QmParticle* b) {
-	/*b->clear();
-	bodies.*/
+void QmWorld::AddSpringNetwork(QmSpringNetwork* net) {
+	springNetworks.push_back(net);
+}
+
+const std::vector<QmSpringNetwork*>& QmWorld::getSpringNetworks() {
+	return springNetworks;
+}
+
+void QmWorld::setImplicitSprings(bool enable, int maxIterations, float tolerance) {
+	implicitSprings = enable;
+	cgMaxIterations = maxIterations;
+	cgTolerance = tolerance;
+}
+
+void QmWorld::AddCutoffMagnetism(QmCutoffMagnetism* m) {
+	cutoffForces.push_back(m);
+}
+
+/**
+ * @brief Returns the particle a generator pulls toward or away from, NULL for none.
+ */
+static QmParticle* generatorTarget(QmForceGenerator* fg)
+{
+	switch (fg->getType())
+	{
+	case FORCE_SPRING:
+		return ((QmSpring*)fg)->part;
+	case FORCE_MAGNETISM:
+		return ((QmMagnetism*)fg)->part;
+	case FORCE_FIXED_MAGNETISM:
+		return ((QmFixedMagnetism*)fg)->partfix;
+	default:
+		return NULL;
+	}
+}
+
+bool QmWorld::DelParticle(QmParticle* b) {
+	std::vector<QmBody*>::iterator it = std::find(bodies.begin(), bodies.end(), (QmBody*)b);
+	if (it == bodies.end())
+		return false;
+	int i = (int)(it - bodies.begin());
+	for (QmEmitter* e : emitters)
+		if (bodyHandles[i] >= e->getFirstHandle() && bodyHandles[i] < e->getFirstHandle() + e->getCapacity())
+			return false;
+
+	// Drop the entries acting on b or pulled by it, then the generators nothing else uses.
+	std::vector<QmForceGenerator*> dropped;
+	forceRegistry.remove_if([b, &dropped](QmForceRegistry* fr) {
+		if (fr->p != b && generatorTarget(fr->fg) != b)
+			return false;
+		dropped.push_back(fr->fg);
+		delete fr;
+		return true;
+	});
+	std::sort(dropped.begin(), dropped.end());
+	dropped.erase(std::unique(dropped.begin(), dropped.end()), dropped.end());
+	for (QmForceRegistry* fr : forceRegistry)
+	{
+		std::vector<QmForceGenerator*>::iterator used = std::lower_bound(dropped.begin(), dropped.end(), fr->fg);
+		if (used != dropped.end() && *used == fr->fg)
+			dropped.erase(used);
+	}
+	for (QmForceGenerator* fg : dropped)
+		delete fg;
+
+	for (QmSpringNetwork* net : springNetworks)
+		net->removeNode(b);
+	removeBody(i);
+	delete b;
+	return true;
+}
+
+void QmWorld::removeBody(int i)
+{
+	int last = (int)bodies.size() - 1;
+	bodiesVersion++;
+
+	// Move the last body into the hole; its handle now points to index i.
+	handleIndex[bodyHandles[i]] = -1;
+	if (i != last)
+	{
+		bodies[i] = bodies[last];
+		bodyHandles[i] = bodyHandles[last];
+		linearDrag[i] = linearDrag[last];
+		quadraticDrag[i] = quadraticDrag[last];
+		handleIndex[bodyHandles[i]] = i;
+	}
+	bodies.pop_back();
+	bodyHandles.pop_back();
+	linearDrag.pop_back();
+	quadraticDrag.pop_back();
 }
 
 void QmWorld::ClearParticles() {
@@ -215,12 +1010,49 @@ void QmWorld::ClearParticles() {
 
 void QmWorld::clear()
 {
+	// The simulation thread would tick the bodies being deleted.
+	stopThread();
+	// Pending commands refer to the old world: drop them.
+	QmCommand c;
+	while (commands.pop(c))
+		if (c.type == CMD_SPAWN)
+			delete c.particle;
 	ClearParticles();
+	// Emitters own their particles: take them out before deleting the bodies.
+	for (QmEmitter* e : emitters)
+	{
+		e->detach(*this);
+		delete e;
+	}
+	emitters.clear();
 	for (QmBody* b : bodies)
 	{
 		delete b;
 	}
 	forceRegistry.clear();
+	for (QmSpringNetwork* net : springNetworks)
+	{
+		delete net;
+	}
+	springNetworks.clear();
+	for (QmCutoffMagnetism* m : cutoffForces)
+	{
+		delete m;
+	}
+	cutoffForces.clear();
+	for (HalfSpace* h : halfSpaces)
+	{
+		delete h;
+	}
+	halfSpaces.clear();
 	bodies.clear();
+	bodyHandles.clear();
+	handleIndex.clear();
+	bodiesVersion++;
+	spatialHandles.clear();
+	spatialBodies.clear();
+	nextHandle = 0;
+	linearDrag.clear();
+	quadraticDrag.clear();
 }
 
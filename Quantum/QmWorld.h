@@ -3,6 +3,9 @@
 
 #include <list>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include "QmParticle.h"
 #include "QmContact.h"
@@ -13,6 +16,15 @@
 #include "QmSpring.h"
 #include "QmFixedSpring.h"
 #include "HalfSpace.h"
+#include "QmSpringNetwork.h"
+#include "QmOctree.h"
+#include "QmCutoffMagnetism.h"
+#include "QmTripleBuffer.h"
+#include "QmCommandQueue.h"
+#include "QmThreadPool.h"
+#include "QmStats.h"
+#include "QmMortonOrder.h"
+#include "QmPackedAABBs.h"
 
 namespace Quantum {
 
@@ -25,6 +37,11 @@ namespace Quantum {
 	class QmMagnetism;
 	class QmFixedMagnetism;
 	class HalfSpace;
+	class QmSpringNetwork;
+	class QmCutoffMagnetism;
+	class QmCheckpointer;
+	class QmTrajectoryWriter;
+	class QmEmitter;
 
 	/**
 	* @class QmWorld
@@ -38,6 +55,8 @@ namespace Quantum {
 	*  - Running the simulation loop over time
 	*/
 	class QmWorld {
+		friend class QmWorldImage;
+		friend class QmEmitter;
 	public:
 
 		/**
@@ -83,51 +102,413 @@ namespace Quantum {
 		*/
 		void interpolate(float dt, float damping, bool euler);
 
+		/**
+		 * @brief Starts simulating on a dedicated thread at a fixed rate.
+		 *
+		 * The thread calls tick(step, ...) every step seconds (catching up
+		 * when late) and publishes a snapshot after each tick, so the
+		 * simulation rate no longer depends on how fast the caller draws.
+		 * While it runs, the world must only be read through acquireSnapshot()
+		 * and getSnapshot(), and steered through setThreadParameters().
+		 *
+		 * @param step Fixed time step in seconds.
+		 * @param g, damping, euler, c Same as tick().
+		 */
+		void startThread(float step, bool g, float damping, bool euler, bool c);
+
+		/**
+		 * @brief Stops the simulation thread and waits for it to finish.
+		 */
+		void stopThread();
+
+		/**
+		 * @return True while the simulation thread runs.
+		 */
+		bool isThreadRunning();
+
+		/**
+		 * @brief Changes the tick parameters used by the simulation thread.
+		 */
+		void setThreadParameters(bool g, float damping, bool euler, bool c);
+
+		/**
+		 * @brief Copies the body positions into a snapshot and publishes it.
+		 *
+		 * Called by the simulation thread after every tick; can also be called
+		 * after tick() when the world is stepped by the caller.
+		 */
+		void publish();
+
+		/**
+		 * @brief Takes the latest published snapshot, without blocking.
+		 * @return True if a newer snapshot than the previous one was taken.
+		 */
+		bool acquireSnapshot();
+
+		/**
+		 * @return The snapshot taken by the last acquireSnapshot().
+		 */
+		const QmSnapshot& getSnapshot();
+
+		/**
+		 * @brief Runs the parallel phases of tick() on a thread pool.
+		 *
+		 * Integration, the charge interaction, the cutoff forces and the
+		 * broadphase are spread over the pool. Force registry entries and
+		 * contact resolution depend on their order and stay sequential.
+		 *
+		 * @param pool Threads to use (not owned), NULL to run everything on the caller.
+		 */
+		void setThreadPool(QmThreadPool* pool);
+
+		/**
+		 * @brief Makes the results independent of the number of threads.
+		 *
+		 * In this mode every parallel phase splits its work into a fixed number
+		 * of partitions and combines partial sums in partition order, so ticks
+		 * are bitwise identical from one run to the next with any pool size
+		 * (or none), and a state hash is computed after every tick.
+		 */
+		void setDeterministic(bool enable);
+
+		/**
+		 * @return Whether the deterministic mode is enabled.
+		 */
+		bool isDeterministic();
+
+		/**
+		 * @brief Hashes the position and velocity bits of every body, in body order.
+		 * @return 64-bit FNV-1a hash of the state.
+		 */
+		unsigned long long computeStateHash();
+
+		/**
+		 * @return The state hash computed after the last tick in deterministic mode, 0 otherwise.
+		 */
+		unsigned long long getStateHash();
+
+		/**
+		 * @return Number of ticks simulated.
+		 */
+		unsigned long long getTickCount();
+
+		/**
+		 * @return Simulated time reached by the last tick.
+		 */
+		float getTickTime();
+
+		/**
+		 * @brief Returns the timings and counters of the last tick.
+		 *
+		 * Reset at the start of every tick; read it from the thread that ticks.
+		 * All zero when the library is built with QM_ENABLE_STATS=0.
+		 */
+		const QmTickStats& getStats();
+
+		/**
+		 * @brief Counts hardware events (cycles, instructions, cache and branch misses) per phase.
+		 *
+		 * The counters follow the thread that calls this method, which must be
+		 * the thread that ticks; work done by pool threads is not counted. The
+		 * events are added to QmTickStats::phaseEvents.
+		 *
+		 * @param enable True to open the counters, false to close them.
+		 * @return Whether the counters are open (false when perf events are unavailable).
+		 */
+		bool enablePerfCounters(bool enable);
+
+		/**
+		 * @brief Checks that ticks stop allocating once warmed up.
+		 *
+		 * After warmupTicks more ticks, in which scratch buffers may still grow,
+		 * every tick that allocates on the heap (QmAllocTracker) counts as a
+		 * violation, and the first one is reported on std::cout. Only the
+		 * allocations of the ticking thread and of its pool tasks count.
+		 *
+		 * @param warmupTicks Ticks allowed to allocate, or -1 to stop checking.
+		 */
+		void setAllocationCheck(int warmupTicks);
+
+		/**
+		 * @return Number of ticks that allocated after the warm-up.
+		 */
+		unsigned long long getAllocationViolations();
+
+		/**
+		 * @brief Takes a background checkpoint at the end of every everyTicks-th tick.
+		 *
+		 * The copy is made on the thread ticking the world, so it is consistent
+		 * whether the world ticks on its own thread or not; the file is written
+		 * by the checkpointer's thread.
+		 *
+		 * @param checkpointer Not owned, NULL to stop.
+		 * @param everyTicks   Ticks between checkpoints.
+		 */
+		void setCheckpointer(QmCheckpointer* checkpointer, int everyTicks);
+
+		/**
+		 * @brief Records a trajectory frame at the end of every everyTicks-th tick.
+		 *
+		 * @param writer     Not owned, NULL to stop.
+		 * @param everyTicks Ticks between frames.
+		 */
+		void setTrajectoryWriter(QmTrajectoryWriter* writer, int everyTicks);
+
+		/**
+		 * @brief Sorts the bodies by Morton (Z-order) code of their position, for the spatial passes.
+		 *
+		 * The passes that gather positions into per-index arrays (cutoff forces
+		 * and their neighbor lists, charge octree) then visit the bodies in that
+		 * order, so bodies close in space sit close in their arrays even after
+		 * the particles have mixed. The body arrays, handles and particles do not
+		 * move: the passes that stream over the particles keep their memory
+		 * order and pointers to particles stay valid. The order is kept by
+		 * handle, so bodies removed since are skipped and bodies added since come
+		 * last. Call between ticks.
+		 */
+		void updateSpatialOrder();
+
+		/**
+		 * @return The bodies in the order of the last updateSpatialOrder(), or in body order
+		 *         if there was none. Valid until bodies are added or removed.
+		 */
+		const std::vector<QmBody*>& getSpatialOrder();
+
+		/**
+		 * @brief Makes tick() call updateSpatialOrder() every everyTicks ticks, before the forces.
+		 * @param everyTicks Ticks between sorts, 0 (the default) for never; 0 also drops the current order.
+		 */
+		void setReorderInterval(int everyTicks);
+
+		/**
+		 * @return Ticks between sorts, 0 for never.
+		 */
+		int getReorderInterval();
+
+		/**
+		 * @brief Adds an emitter, stepped at the start of every tick. The world takes ownership of it.
+		 *
+		 * Reserves the emitter's handles and room for its particles in the body
+		 * arrays. Call between ticks.
+		 */
+		void addEmitter(QmEmitter* e);
+
+		/**
+		 * @return All emitters.
+		 */
+		const std::vector<QmEmitter*>& getEmitters();
+
 		/**
 		 * @brief Performs broadphase collision detection.
-		 * @return A list of potential contacts (colliding pairs).
+		 *
+		 * The contacts are kept in a buffer reused from one call to the next.
+		 * Unless disabled (setQuantizedBroadphase), the boxes are first packed
+		 * to 16 bits (QmPackedAABBs) and only the pairs that may overlap there
+		 * are tested on the exact boxes; the contacts are the same either way.
+		 *
+		 * @return The potential contacts (colliding pairs), valid until the next call.
 		 */
-		std::list<QmContact> broadphase();
+		const std::vector<QmContact>& broadphase();
 
 
 		//std::list<QmContact> narrowphase(QmParticle* b1, QmParticle* b2);
 
 		/**
 		 * @brief Resolves a list of detected contacts.
-		 * @param cList List of contacts to resolve.
+		 * @param cList Contacts to resolve.
 		 */
-		void resolve(std::list<QmContact> cList);
+		void resolve(const std::vector<QmContact>& cList);
 
 		/**
 		 * @brief Tests whether two AABBs intersect.
 		 */
 		bool intersect(AABB a, AABB b);
 
+		/**
+		 * @brief Whether broadphase() filters the pairs on quantized boxes first (the default).
+		 */
+		void setQuantizedBroadphase(bool enable);
+
+		/**
+		 * @return Whether broadphase() filters the pairs on quantized boxes first.
+		 */
+		bool getQuantizedBroadphase();
+
 		/**
 		 * @brief Creates the simulation box boundaries (HalfSpaces).
 		 */
 		void CreateBox();
 
+		/**
+		 * @brief Adds a boundary. The world takes ownership of it.
+		 */
+		void addHalfSpace(HalfSpace* h);
+
+		/**
+		 * @return All boundaries.
+		 */
+		const std::vector<HalfSpace*>& getHalfSpaces();
+
 		/**
 		 * @brief Adds a body (particle or half-space) to the world.
+		 *
+		 * @return The handle of the body. Handles never change while the body
+		 * is in the world, whereas its index in getBodies() can (removals).
+		 */
+		int addBody(QmBody*);
+
+		/**
+		 * @brief Reserves room for count more bodies, so that adding them does not reallocate.
+		 */
+		void reserveBodies(int count);
+
+		/**
+		 * @brief Adds particles under consecutive handles.
+		 *
+		 * Same as AddParticle in a loop, with a single growth of each body array.
+		 *
+		 * @param particles Particles to add. The world takes ownership of them.
+		 * @param count     Number of particles.
+		 * @param K1, K2    Drag coefficients of each particle (see AddParticle), may be NULL for none.
+		 * @return Handle of the first particle; particle i gets the handle first + i.
+		 */
+		int addBodies(QmParticle* const* particles, int count, const float* K1, const float* K2);
+
+		/**
+		 * @return Number of bodies in the world.
+		 */
+		int getBodyCount();
+
+		/**
+		 * @return One past the largest handle given so far (size of exportState buffers).
+		 */
+		int getHandleCount();
+
+		/**
+		 * @return Index in getBodies() of the body with handle h, -1 if it is not in the world.
 		 */
-		void addBody(QmBody*);
+		int getBodyIndex(int h);
+
+		/**
+		 * @brief Writes the state of every body into contiguous caller buffers.
+		 *
+		 * Meant to be called once per frame by the renderer, in place of one
+		 * QmUpdater callback per particle and step. The body with handle h is
+		 * written at index h; slots of removed bodies are left untouched.
+		 * Runs on the thread pool when one is set, so it must not be called
+		 * while the world ticks.
+		 *
+		 * @param positions  Receives the positions (may be NULL).
+		 * @param velocities Receives the velocities (may be NULL).
+		 * @param capacity   Size of the buffers, usually getHandleCount().
+		 * @return Number of bodies written.
+		 */
+		int exportState(glm::vec3* positions, glm::vec3* velocities, int capacity);
+
+		/**
+		 * @brief Queues the addition of a particle. Safe from any thread.
+		 *
+		 * The particle joins the world when tick() or processCommands() next
+		 * drains the queue; until then the world does not touch it.
+		 *
+		 * @param p  Particle to add. The world takes ownership of it.
+		 * @param K1 Linear drag coefficient (see AddParticle).
+		 * @param K2 Quadratic drag coefficient.
+		 * @return The handle the particle will have, -1 if the queue is full.
+		 */
+		int postSpawn(QmParticle* p, float K1 = 0.f, float K2 = 0.f);
+
+		/**
+		 * @brief Queues DelParticle on the particle with the given handle. Safe from any thread.
+		 *
+		 * This and the following commands look the handle up when they are
+		 * applied, and do nothing if it has no body by then.
+		 *
+		 * @return False if the queue is full.
+		 */
+		bool postRemove(int handle);
+
+		/**
+		 * @brief Queues setPos(pos) on the particle with the given handle. Safe from any thread.
+		 * @return False if the queue is full.
+		 */
+		bool postPosition(int handle, glm::vec3 pos);
+
+		/**
+		 * @brief Queues setVel(vel) on the particle with the given handle. Safe from any thread.
+		 * @return False if the queue is full.
+		 */
+		bool postVelocity(int handle, glm::vec3 vel);
+
+		/**
+		 * @brief Queues setCharge(q) on the particle with the given handle. Safe from any thread.
+		 * @return False if the queue is full.
+		 */
+		bool postCharge(int handle, float q);
+
+		/**
+		 * @brief Queues the registration of a generator on the particle with the given handle. Safe from any thread.
+		 *
+		 * The registry entry is created when the command is applied.
+		 *
+		 * @return False if the queue is full.
+		 */
+		bool postForceRegistry(int handle, QmForceGenerator* fg);
+
+		/**
+		 * @brief Queues e->getSpawn().setPosition(pos) and e->burst(count). Safe from any thread.
+		 * @return False if the queue is full.
+		 */
+		bool postBurst(QmEmitter* e, int count, glm::vec3 pos);
+
+		/**
+		 * @brief Applies the queued commands in the order they were posted.
+		 *
+		 * tick() calls it first, before any force is computed. Only the thread
+		 * stepping the world may call it.
+		 */
+		void processCommands();
 
 		/**
 		 * @return All bodies in the world.
 		 */
-		std::vector<QmBody*> getBodies();
+		const std::vector<QmBody*>& getBodies();
 
 		/**
 		 * @return All registered forces in the world.
 		 */
-		std::list<QmForceRegistry*> getForces();
+		const std::list<QmForceRegistry*>& getForces();
+
+		/**
+		 * @brief Applies the uniform fields and integrates all particles over a time step.
+		 *
+		 * Gravity, drag and the electric field are added to each particle right
+		 * before it is integrated, so they cost no extra pass over the bodies.
+		 *
+		 * Called by tick(); public so that the phase can be driven on its own.
+		 *
+		 * @param g Whether gravity is applied.
+		 */
+		void integrate(float t, float damping, bool euler, bool g);
 
 		/**
 		 * @brief Applies global gravity to all particles.
+		 *
+		 * tick() applies gravity inside the integration loop instead; this pass
+		 * is kept for callers driving the steps themselves.
 		 */
 		void ApplyGravity();
 
+		/**
+		 * @brief Sets the uniform gravity applied by tick().
+		 */
+		void setGravity(glm::vec3 g);
+
+		/**
+		 * @brief Sets the uniform electric field. Each particle receives q * E.
+		 */
+		void setElectricField(glm::vec3 E);
+
 		/**
 		 * @brief Changes the stiffness of spring forces globally.
 		 */
@@ -138,10 +519,38 @@ namespace Quantum {
 		 */
 		void updateForces();
 
+		/**
+		 * @brief Enables mutual charge interaction between all particles.
+		 *
+		 * Replaces one QmMagnetism registry entry per ordered pair: every tick an
+		 * octree is built over the charged particles and each of them receives
+		 * K * q * E, E being evaluated with the Barnes-Hut opening criterion.
+		 *
+		 * @param enable Whether the interaction is applied in updateForces.
+		 * @param K      Force scaling coefficient (same meaning as in QmMagnetism).
+		 * @param theta  Opening angle, 0 gives the exact O(n^2) sum.
+		 */
+		void setChargeInteraction(bool enable, float K, float theta);
+
 		/**
 		 * @brief Adds a particle to the world.
+		 * @return The handle of the particle.
 		 */
-		void AddParticle(QmParticle* p);
+		int AddParticle(QmParticle* p);
+
+		/**
+		 * @brief Adds a particle subject to the world drag field.
+		 *
+		 * Equivalent to a QmDrag(K1, K2) registry entry, without the registry:
+		 * the coefficients are stored per body and the drag is applied inside
+		 * the integration loop.
+		 *
+		 * @param p  Particle to add.
+		 * @param K1 Linear drag coefficient.
+		 * @param K2 Quadratic drag coefficient.
+		 * @return The handle of the particle.
+		 */
+		int AddParticle(QmParticle* p, float K1, float K2);
 
 		/**
 		 * @brief Registers a new force generator acting on a particle.
@@ -149,9 +558,48 @@ namespace Quantum {
 		void AddForceRegistry(QmForceRegistry* fg);
 
 		/**
-		 * @brief Removes a particle from the world.
+		 * @brief Registers a spring network. The world takes ownership of it.
+		 */
+		void AddSpringNetwork(QmSpringNetwork* net);
+
+		/**
+		 * @return All registered spring networks.
+		 */
+		const std::vector<QmSpringNetwork*>& getSpringNetworks();
+
+		/**
+		 * @brief Integrates spring networks implicitly (backward Euler).
+		 *
+		 * When enabled, tick() solves the networks' springs with a conjugate
+		 * gradient solver instead of evaluating them explicitly, which keeps
+		 * stiff springs stable at large steps. Use with semi-implicit
+		 * integration (euler = false).
+		 *
+		 * @param enable        Whether the networks are integrated implicitly.
+		 * @param maxIterations Conjugate gradient iteration budget per network.
+		 * @param tolerance     Relative residual at which the solver stops.
 		 */
-		void DelParticle(QmParticle* b);
+		void setImplicitSprings(bool enable, int maxIterations, float tolerance);
+
+		/**
+		 * @brief Registers a short-range magnetism acting on every particle pair.
+		 * The world takes ownership of it.
+		 */
+		void AddCutoffMagnetism(QmCutoffMagnetism* m);
+
+		/**
+		 * @brief Removes a particle from the world and deletes it.
+		 *
+		 * The last body takes its index, so indices change but handles do not.
+		 * Registry entries acting on the particle, or whose generator pulls
+		 * it (springs, magnetism), are deleted, and so are their generators
+		 * once no other entry uses them. The particle also leaves the spring
+		 * networks, with its springs. Particles of an emitter are refused:
+		 * the emitter reuses them.
+		 *
+		 * @return False if the particle is not in the world or belongs to an emitter.
+		 */
+		bool DelParticle(QmParticle* b);
 
 		/**
 		 * @brief Removes all particles from the world.
@@ -160,6 +608,8 @@ namespace Quantum {
 
 		/**
 		 * @brief Clears the world completely (particles, forces, etc.).
+		 *
+		 * Stops the simulation thread first.
 		 */
 		void clear();
 	private:
@@ -173,22 +623,225 @@ namespace Quantum {
 		/// @brief All bodies.
 		std::vector<QmBody*> bodies;
 
+		/// @brief Handle of each body (same index as bodies).
+		std::vector<int> bodyHandles;
+
+		/// @brief Index in bodies of each handle, -1 once removed.
+		std::vector<int> handleIndex;
+
+		/// @brief Next handle to give out (producers reserve handles concurrently).
+		std::atomic<int> nextHandle;
+
+		/// @brief Threads running the parallel phases (not owned), may be NULL.
+		QmThreadPool* pool;
+
+		/// @brief Whether parallel phases use fixed partitions.
+		bool deterministic;
+
+		/// @brief State hash after the last tick (deterministic mode).
+		unsigned long long stateHash;
+
+		/// @brief Timings and counters of the last tick.
+		QmTickStats stats;
+
+		/// @brief Hardware counters read around each phase, open when enabled.
+		QmPerfCounters perfCounters;
+
+		/// @brief Ticks left before allocations count as violations, -1 when not checking.
+		int allocWarmup;
+
+		/// @brief Ticks that allocated after the warm-up.
+		unsigned long long allocViolations;
+
+		/// @brief Background checkpoints (not owned), may be NULL.
+		QmCheckpointer* checkpointer;
+
+		/// @brief Ticks between checkpoints.
+		int checkpointEvery;
+
+		/// @brief Trajectory recording (not owned), may be NULL.
+		QmTrajectoryWriter* trajectoryWriter;
+
+		/// @brief Ticks between trajectory frames.
+		int trajectoryEvery;
+
+		/// @brief Particle emitters.
+		std::vector<QmEmitter*> emitters;
+
+		/// @brief Ticks between Morton sorts, 0 for never.
+		int reorderEvery;
+
+		/// @brief Sort of updateSpatialOrder().
+		QmMortonOrder mortonOrder;
+
+		/// @brief Positions sorted by updateSpatialOrder().
+		std::vector<glm::vec3> mortonPos;
+
+		/// @brief Handles in Morton order at the last sort, empty if there was none.
+		std::vector<int> spatialHandles;
+
+		/// @brief Bodies in the order of spatialHandles, then those added since.
+		std::vector<QmBody*> spatialBodies;
+
+		/// @brief Whether each body index is in spatialBodies, while it is built.
+		std::vector<char> spatialPlaced;
+
+		/// @brief Incremented whenever bodies are added or removed.
+		unsigned long long bodiesVersion;
+
+		/// @brief bodiesVersion when spatialBodies was built.
+		unsigned long long spatialVersion;
+
+		/// @brief Contacts of the last broadphase.
+		std::vector<QmContact> contacts;
+
+		/// @brief Contacts found by each broadphase partition, spliced into contacts.
+		std::vector<std::vector<QmContact>> contactParts;
+
+		/// @brief Whether broadphase() filters the pairs on packedBoxes.
+		bool quantizedBroadphase;
+
+		/// @brief Body boxes quantized by broadphase().
+		QmPackedAABBs packedBoxes;
+
+		/// @brief Candidate second bodies of each broadphase partition, one chunk of its current body at a time.
+		std::vector<std::vector<int>> candidateParts;
+
+		/// @brief Changes posted from other threads, applied by processCommands().
+		QmCommandQueue commands;
+
 		/// @brief lation boundaries.
 		std::vector<HalfSpace*> halfSpaces;
 
 		/// @brief Registered forces.
 		std::list<QmForceRegistry*> forceRegistry;
 
+		/// @brief Spring networks evaluated with the other forces.
+		std::vector<QmSpringNetwork*> springNetworks;
+
+		/// @brief Whether spring networks are integrated implicitly.
+		bool implicitSprings;
+
+		/// @brief Conjugate gradient iteration budget.
+		int cgMaxIterations;
+
+		/// @brief Conjugate gradient relative tolerance.
+		float cgTolerance;
+
+		/// @brief Short-range pair forces evaluated over neighbor lists.
+		std::vector<QmCutoffMagnetism*> cutoffForces;
+
+		/// @brief Whether the world-level charge interaction is applied.
+		bool chargeInteraction;
+
+		/// @brief Charge interaction coefficient.
+		float chargeK;
+
+		/// @brief Barnes-Hut opening angle.
+		float chargeTheta;
+
+		/// @brief Octree rebuilt every tick over the charged particles.
+		QmOctree chargeTree;
+
+		/// @brief Charged particles of the current tick.
+		std::vector<QmParticle*> charged;
+
+		/// @brief Positions of the charged particles.
+		std::vector<glm::vec3> chargedPos;
+
+		/// @brief Charges of the charged particles.
+		std::vector<float> chargedQ;
+
+		/// @brief Field evaluated at each charged particle.
+		std::vector<glm::vec3> chargedField;
+
+		/// @brief Number of ticks since construction.
+		unsigned long long tickCount;
+
+		/// @brief Snapshots published for readers on other threads.
+		QmTripleBuffer snapshots;
+
+		/// @brief Simulation thread.
+		std::thread worker;
+
+		/// @brief Set while the simulation thread must keep running.
+		std::atomic<bool> threadRunning;
+
+		/// @brief Tick parameters of the simulation thread.
+		std::atomic<bool> threadGravity, threadEuler, threadCollisions;
+
+		/// @brief Damping used by the simulation thread.
+		std::atomic<float> threadDamping;
+
 		/// @brief Contact list (possibly from half-spaces).
 		std::list<QmContact>* ContactHalf;
 
 		/// @brief Global gravity vector.
 		glm::vec3 gravity;
 
+		/// @brief Uniform electric field.
+		glm::vec3 electricField;
+
+		/// @brief Linear drag coefficient of each body (same index as bodies).
+		std::vector<float> linearDrag;
+
+		/// @brief Quadratic drag coefficient of each body (same index as bodies).
+		std::vector<float> quadraticDrag;
+
+
+		/**
+		 * @brief Calls fn(begin, end) over contiguous ranges covering [0, count).
+		 *
+		 * The ranges run on the pool when there is one and count is large enough.
+		 *
+		 * @param name Trace name of the pool tasks.
+		 */
+		template <class F>
+		void parallelFor(int count, const F& fn, const char* name)
+		{
+			const int grain = 1024;
+			int tasks = pool ? std::min(partitionCount(), (count + grain - 1) / grain) : 1;
+			if (tasks <= 1)
+			{
+				fn(0, count);
+				return;
+			}
+			pool->run(tasks, [&](int k) {
+				fn((int)((long long)k * count / tasks), (int)((long long)(k + 1) * count / tasks));
+			}, name);
+		}
+
+		/**
+		 * @return Number of partitions of the order-dependent parallel phases.
+		 */
+		int partitionCount();
+
+		/**
+		 * @brief Appends a body under an already reserved handle.
+		 */
+		void insertBody(QmBody* b, int h, float K1, float K2);
+
+		/**
+		 * @brief Takes the body at index i out of the arrays, without deleting it.
+		 *
+		 * The last body takes its index; the handle stays reserved.
+		 */
+		void removeBody(int i);
+
+		/**
+		 * @brief Queues a command that targets a particle.
+		 */
+		bool post(QmCommandType type, int handle, glm::vec3 value, float k1);
+
+		/**
+		 * @brief Builds the charge octree and applies the charge forces.
+		 */
+		void applyChargeInteraction();
+
 		/**
-		 * @brief Integrates all particles over a time step.
+		 * @brief Body of the simulation thread.
 		 */
-		void integrate(float t, float damping, bool euler);
+		void threadLoop(float step);
 	};
 
 }
@@ -0,0 +1,242 @@
+#include "QmWorldBatch.h"
+#include <algorithm>
+#include <cmath>
+#include "QmThreadPool.h"
+
+using namespace Quantum;
+
+QmWorldBatch::QmWorldBatch(int worlds, QmThreadPool* pool) :
+	worlds_(worlds), particles_(0), pool_(pool), tickCount_(0),
+	gravity_(glm::vec3(0, -9.81, 0)), field_(glm::vec3(0, 0, 0)),
+	damping_(worlds, 1.f), stiffness_(worlds, 0.f), magnetism_(worlds, 0.f)
+{
+}
+
+QmWorldBatch::~QmWorldBatch() {}
+
+void QmWorldBatch::appendWorlds(std::vector<float>& a, float v)
+{
+	a.insert(a.end(), worlds_, v);
+}
+
+int QmWorldBatch::addParticle(glm::vec3 pos, glm::vec3 vel, float masse, float charge, bool isacc, float K1, float K2)
+{
+	appendWorlds(px_, pos.x);
+	appendWorlds(py_, pos.y);
+	appendWorlds(pz_, pos.z);
+	appendWorlds(vx_, vel.x);
+	appendWorlds(vy_, vel.y);
+	appendWorlds(vz_, vel.z);
+	appendWorlds(fx_, 0.f);
+	appendWorlds(fy_, 0.f);
+	appendWorlds(fz_, 0.f);
+	appendWorlds(q_, charge);
+	invMass_.push_back(masse == 0 ? 0.f : 1 / masse);
+	isAcc_.push_back(isacc ? 1.f : 0.f);
+	k1_.push_back(K1);
+	k2_.push_back(K2);
+	return particles_++;
+}
+
+void QmWorldBatch::addSpring(int i, int j, float restLength)
+{
+	springI_.push_back(i);
+	springJ_.push_back(j);
+	springL_.push_back(restLength);
+}
+
+void QmWorldBatch::addFixedSpring(int i, glm::vec3 anchor, float restLength)
+{
+	anchorI_.push_back(i);
+	anchorPos_.push_back(anchor);
+	anchorL_.push_back(restLength);
+}
+
+void QmWorldBatch::tick(float t, bool euler)
+{
+	int blocks = (worlds_ + BLOCK - 1) / BLOCK;
+	auto step = [&](int b) { tickBlock(b * BLOCK, std::min(worlds_, (b + 1) * BLOCK), t, euler); };
+	if (pool_)
+		pool_->run(blocks, step, "batch_block");
+	else
+		for (int b = 0; b < blocks; b++)
+			step(b);
+	tickCount_++;
+}
+
+void QmWorldBatch::tickBlock(int w0, int w1, float t, bool euler)
+{
+	const int W = worlds_;
+	float* px = px_.data(); float* py = py_.data(); float* pz = pz_.data();
+	float* vx = vx_.data(); float* vy = vy_.data(); float* vz = vz_.data();
+	float* fx = fx_.data(); float* fy = fy_.data(); float* fz = fz_.data();
+	const float* q = q_.data();
+	const float* K = stiffness_.data();
+	const float* M = magnetism_.data();
+	const float* damping = damping_.data();
+
+	// Uniform field and drag start the accumulators.
+	for (int i = 0; i < particles_; i++)
+	{
+		int o = i * W;
+		float k1 = k1_[i], k2 = k2_[i];
+		for (int w = w0; w < w1; w++)
+		{
+			float x = vx[o + w], y = vy[o + w], z = vz[o + w];
+			float c = k1 + k2 * std::sqrt(x * x + y * y + z * z);
+			fx[o + w] = field_.x * q[o + w] - x * c;
+			fy[o + w] = field_.y * q[o + w] - y * c;
+			fz[o + w] = field_.z * q[o + w] - z * c;
+		}
+	}
+
+	// Springs: F = -(N - l) K d / N on i, the opposite on j.
+	for (size_t e = 0; e < springI_.size(); e++)
+	{
+		int oi = springI_[e] * W, oj = springJ_[e] * W;
+		float l = springL_[e];
+		for (int w = w0; w < w1; w++)
+		{
+			float dx = px[oi + w] - px[oj + w], dy = py[oi + w] - py[oj + w], dz = pz[oi + w] - pz[oj + w];
+			float N = std::sqrt(dx * dx + dy * dy + dz * dz);
+			float c = N > 0.f ? -(N - l) * K[w] / N : 0.f;
+			fx[oi + w] += dx * c; fy[oi + w] += dy * c; fz[oi + w] += dz * c;
+			fx[oj + w] -= dx * c; fy[oj + w] -= dy * c; fz[oj + w] -= dz * c;
+		}
+	}
+
+	for (size_t e = 0; e < anchorI_.size(); e++)
+	{
+		int oi = anchorI_[e] * W;
+		glm::vec3 a = anchorPos_[e];
+		float l = anchorL_[e];
+		for (int w = w0; w < w1; w++)
+		{
+			float dx = px[oi + w] - a.x, dy = py[oi + w] - a.y, dz = pz[oi + w] - a.z;
+			float N = std::sqrt(dx * dx + dy * dy + dz * dz);
+			float c = N > 0.f ? -(N - l) * K[w] / N : 0.f;
+			fx[oi + w] += dx * c; fy[oi + w] += dy * c; fz[oi + w] += dz * c;
+		}
+	}
+
+	// Magnetism between every pair: F = K qi qj d / (N (N^2 + 1)) on i, the opposite on j.
+	bool magnetism = false;
+	for (int w = w0; w < w1; w++)
+		magnetism |= M[w] != 0.f;
+	if (magnetism)
+	{
+		for (int i = 0; i < particles_; i++)
+		{
+			int oi = i * W;
+			for (int j = i + 1; j < particles_; j++)
+			{
+				int oj = j * W;
+				for (int w = w0; w < w1; w++)
+				{
+					float dx = px[oi + w] - px[oj + w], dy = py[oi + w] - py[oj + w], dz = pz[oi + w] - pz[oj + w];
+					float N2 = dx * dx + dy * dy + dz * dz;
+					float N = std::sqrt(N2);
+					float c = N > 0.f ? M[w] * q[oi + w] * q[oj + w] / (N * (N2 + 1.f)) : 0.f;
+					fx[oi + w] += dx * c; fy[oi + w] += dy * c; fz[oi + w] += dz * c;
+					fx[oj + w] -= dx * c; fy[oj + w] -= dy * c; fz[oj + w] -= dz * c;
+				}
+			}
+		}
+	}
+
+	// Same update as QmParticle::integrate.
+	for (int i = 0; i < particles_; i++)
+	{
+		int o = i * W;
+		float im = invMass_[i];
+		float gx = gravity_.x * isAcc_[i], gy = gravity_.y * isAcc_[i], gz = gravity_.z * isAcc_[i];
+		for (int w = w0; w < w1; w++)
+		{
+			float ax = gx + fx[o + w] * im, ay = gy + fy[o + w] * im, az = gz + fz[o + w] * im;
+			float d = damping[w];
+			if (euler)
+			{
+				px[o + w] += t * vx[o + w]; py[o + w] += t * vy[o + w]; pz[o + w] += t * vz[o + w];
+				vx[o + w] = vx[o + w] * d + t * ax; vy[o + w] = vy[o + w] * d + t * ay; vz[o + w] = vz[o + w] * d + t * az;
+			}
+			else
+			{
+				vx[o + w] = vx[o + w] * d + t * ax; vy[o + w] = vy[o + w] * d + t * ay; vz[o + w] = vz[o + w] * d + t * az;
+				px[o + w] += t * vx[o + w]; py[o + w] += t * vy[o + w]; pz[o + w] += t * vz[o + w];
+			}
+		}
+	}
+}
+
+void QmWorldBatch::setGravity(glm::vec3 g)
+{
+	gravity_ = g;
+}
+
+void QmWorldBatch::setElectricField(glm::vec3 E)
+{
+	field_ = E;
+}
+
+void QmWorldBatch::setDamping(int w, float damping)
+{
+	damping_[w] = damping;
+}
+
+void QmWorldBatch::setStiffness(int w, float K)
+{
+	stiffness_[w] = K;
+}
+
+void QmWorldBatch::setMagnetism(int w, float K)
+{
+	magnetism_[w] = K;
+}
+
+void QmWorldBatch::setCharge(int w, int i, float q)
+{
+	q_[i * worlds_ + w] = q;
+}
+
+void QmWorldBatch::setPos(int w, int i, glm::vec3 pos)
+{
+	int k = i * worlds_ + w;
+	px_[k] = pos.x;
+	py_[k] = pos.y;
+	pz_[k] = pos.z;
+}
+
+void QmWorldBatch::setVel(int w, int i, glm::vec3 vel)
+{
+	int k = i * worlds_ + w;
+	vx_[k] = vel.x;
+	vy_[k] = vel.y;
+	vz_[k] = vel.z;
+}
+
+glm::vec3 QmWorldBatch::getPos(int w, int i)
+{
+	int k = i * worlds_ + w;
+	return glm::vec3(px_[k], py_[k], pz_[k]);
+}
+
+glm::vec3 QmWorldBatch::getVel(int w, int i)
+{
+	int k = i * worlds_ + w;
+	return glm::vec3(vx_[k], vy_[k], vz_[k]);
+}
+
+int QmWorldBatch::getWorldCount()
+{
+	return worlds_;
+}
+
+int QmWorldBatch::getParticleCount()
+{
+	return particles_;
+}
+
+unsigned long long QmWorldBatch::getTickCount()
+{
+	return tickCount_;
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Quantum {
+
+	class QmThreadPool;
+
+	/**
+	 * @class QmWorldBatch
+	 * @brief Steps many independent copies of one scene in lockstep.
+	 *
+	 * All worlds share the topology (particles, masses, springs) and differ
+	 * by their state and a few parameters (damping, stiffness, magnetism,
+	 * charges), as in a parameter sweep. State is stored structure-of-arrays
+	 * with the world index innermost, so every force and integration loop
+	 * runs over consecutive worlds and vectorizes. Blocks of worlds are
+	 * stepped in parallel on a QmThreadPool.
+	 *
+	 * The forces follow the QmWorld ones: gravity on accelerated particles,
+	 * uniform electric field, drag (QmDrag), springs between particles
+	 * (QmSpring, applied to both ends), springs to fixed points
+	 * (QmFixedSpring) and magnetism between every particle pair
+	 * (QmMagnetism). Collisions are not handled.
+	 */
+	class QmWorldBatch {
+	public:
+
+		/**
+		 * @brief Creates a batch of empty worlds.
+		 *
+		 * @param worlds Number of worlds.
+		 * @param pool   Threads stepping the worlds, NULL steps them on the caller.
+		 */
+		QmWorldBatch(int worlds, QmThreadPool* pool = NULL);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~QmWorldBatch();
+
+		/**
+		 * @brief Adds a particle with the same initial state to every world.
+		 *
+		 * @param pos     Initial position.
+		 * @param vel     Initial velocity.
+		 * @param masse   Mass, 0 for an immovable particle.
+		 * @param charge  Initial charge.
+		 * @param isacc   Whether gravity applies.
+		 * @param K1, K2  Drag coefficients (0 for none).
+		 * @return Index of the particle.
+		 */
+		int addParticle(glm::vec3 pos, glm::vec3 vel, float masse, float charge, bool isacc, float K1 = 0.f, float K2 = 0.f);
+
+		/**
+		 * @brief Links two particles with a spring. Its stiffness is the world's (setStiffness).
+		 */
+		void addSpring(int i, int j, float restLength);
+
+		/**
+		 * @brief Links a particle to a fixed point with a spring.
+		 */
+		void addFixedSpring(int i, glm::vec3 anchor, float restLength);
+
+		/**
+		 * @brief Advances every world by one tick.
+		 *
+		 * @param t     Time step.
+		 * @param euler If true, use Euler integration; otherwise semi-implicit Euler.
+		 */
+		void tick(float t, bool euler);
+
+		/**
+		 * @brief Sets the gravity of all worlds.
+		 */
+		void setGravity(glm::vec3 g);
+
+		/**
+		 * @brief Sets the uniform electric field of all worlds.
+		 */
+		void setElectricField(glm::vec3 E);
+
+		/**
+		 * @brief Sets the damping factor of world w.
+		 */
+		void setDamping(int w, float damping);
+
+		/**
+		 * @brief Sets the spring stiffness of world w.
+		 */
+		void setStiffness(int w, float K);
+
+		/**
+		 * @brief Sets the magnetism coefficient of world w (0 disables it).
+		 */
+		void setMagnetism(int w, float K);
+
+		/**
+		 * @brief Sets the charge of particle i in world w.
+		 */
+		void setCharge(int w, int i, float q);
+
+		/**
+		 * @brief Sets the position of particle i in world w.
+		 */
+		void setPos(int w, int i, glm::vec3 pos);
+
+		/**
+		 * @brief Sets the velocity of particle i in world w.
+		 */
+		void setVel(int w, int i, glm::vec3 vel);
+
+		/**
+		 * @return Position of particle i in world w.
+		 */
+		glm::vec3 getPos(int w, int i);
+
+		/**
+		 * @return Velocity of particle i in world w.
+		 */
+		glm::vec3 getVel(int w, int i);
+
+		/**
+		 * @return Number of worlds.
+		 */
+		int getWorldCount();
+
+		/**
+		 * @return Number of particles in each world.
+		 */
+		int getParticleCount();
+
+		/**
+		 * @return Number of ticks since construction.
+		 */
+		unsigned long long getTickCount();
+
+	private:
+
+		/// @brief Worlds stepped by one task.
+		static const int BLOCK = 64;
+
+		/**
+		 * @brief Steps worlds [w0, w1).
+		 */
+		void tickBlock(int w0, int w1, float t, bool euler);
+
+		/**
+		 * @brief Appends one value per world to an array.
+		 */
+		void appendWorlds(std::vector<float>& a, float v);
+
+		/// @brief Number of worlds.
+		int worlds_;
+
+		/// @brief Number of particles per world.
+		int particles_;
+
+		/// @brief Threads stepping the worlds (not owned).
+		QmThreadPool* pool_;
+
+		/// @brief Number of ticks.
+		unsigned long long tickCount_;
+
+		/// @brief Global gravity vector.
+		glm::vec3 gravity_;
+
+		/// @brief Uniform electric field.
+		glm::vec3 field_;
+
+		/// @brief Per world and particle state, element [i * worlds + w].
+		std::vector<float> px_, py_, pz_, vx_, vy_, vz_, fx_, fy_, fz_, q_;
+
+		/// @brief Inverse mass of each particle.
+		std::vector<float> invMass_;
+
+		/// @brief 1 if gravity applies to the particle, 0 otherwise.
+		std::vector<float> isAcc_;
+
+		/// @brief Drag coefficients of each particle.
+		std::vector<float> k1_, k2_;
+
+		/// @brief Springs between particles.
+		std::vector<int> springI_, springJ_;
+
+		/// @brief Rest lengths of the springs.
+		std::vector<float> springL_;
+
+		/// @brief Fixed springs: particle, anchor and rest length.
+		std::vector<int> anchorI_;
+		std::vector<glm::vec3> anchorPos_;
+		std::vector<float> anchorL_;
+
+		/// @brief Per world parameters.
+		std::vector<float> damping_, stiffness_, magnetism_;
+	};
+}
@@ -0,0 +1,598 @@
+#include "QmWorldImage.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include "QmWorld.h"
+
+using namespace Quantum;
+
+static_assert(sizeof(QmImageHeader) == 64, "QmImageHeader layout");
+static_assert(sizeof(QmImageSectionEntry) == 24, "QmImageSectionEntry layout");
+static_assert(sizeof(QmImageParams) == 72, "QmImageParams layout");
+static_assert(sizeof(QmImageGenerator) == 32, "QmImageGenerator layout");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be three packed floats");
+
+namespace {
+
+	const char MAGIC[8] = { 'Q', 'M', 'W', 'O', 'R', 'L', 'D', 0 };
+
+	const uint64_t ALIGNMENT = 64;
+
+	/// @brief Longest chain of incremental images read() follows.
+	const int MAX_BASE_DEPTH = 64;
+
+	bool littleEndian()
+	{
+		const uint16_t one = 1;
+		return *(const uint8_t*)&one == 1;
+	}
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+
+	/// @brief Index of each particle of a world, for the references between objects.
+	typedef std::unordered_map<QmParticle*, int> BodyIndex;
+
+	int indexOf(const BodyIndex& index, QmParticle* p)
+	{
+		BodyIndex::const_iterator it = index.find(p);
+		return it == index.end() ? -1 : it->second;
+	}
+
+	bool inRange(int32_t i, uint64_t count)
+	{
+		return i >= 0 && (uint64_t)i < count;
+	}
+}
+
+QmWorldImage::QmWorldImage()
+{
+	for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+	{
+		data_[s] = NULL;
+		count_[s] = 0;
+	}
+}
+
+uint32_t QmWorldImage::getElementSize(int id)
+{
+	static const uint32_t sizes[IMAGE_SECTION_COUNT] = {
+		sizeof(QmImageParams),
+		sizeof(int32_t),
+		3 * sizeof(float), 3 * sizeof(float), 3 * sizeof(float),
+		sizeof(float), sizeof(float), sizeof(float),
+		sizeof(uint8_t),
+		2 * sizeof(float),
+		sizeof(QmImageHalfSpace),
+		sizeof(QmImageGenerator),
+		sizeof(QmImageForce),
+		sizeof(QmImageNetwork),
+		sizeof(int32_t),
+		sizeof(QmImageSpring),
+		sizeof(QmImageCutoff),
+		sizeof(char)
+	};
+	return id >= 0 && id < IMAGE_SECTION_COUNT ? sizes[id] : 0;
+}
+
+const void* QmWorldImage::getSection(int id) const
+{
+	return id >= 0 && id < IMAGE_SECTION_COUNT ? data_[id] : NULL;
+}
+
+uint64_t QmWorldImage::getCount(int id) const
+{
+	return id >= 0 && id < IMAGE_SECTION_COUNT ? count_[id] : 0;
+}
+
+uint64_t QmWorldImage::hashSection(int id) const
+{
+	// FNV-1a over 64-bit words, then the tail bytes; the count is mixed in so that
+	// an empty section differs from a missing one.
+	const uint64_t prime = 1099511628211ull;
+	uint64_t h = 14695981039346656037ull ^ getCount(id);
+	const unsigned char* p = (const unsigned char*)getSection(id);
+	size_t bytes = p ? (size_t)(count_[id] * getElementSize(id)) : 0;
+	size_t k = 0;
+	for (; k + 8 <= bytes; k += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, p + k, 8);
+		h = (h ^ word) * prime;
+	}
+	for (; k < bytes; k++)
+		h = (h ^ p[k]) * prime;
+	return h;
+}
+
+int QmWorldImage::capture(QmWorld& world)
+{
+	file_.close();
+	base_.reset();
+	data_[IMAGE_BASE] = NULL;
+	count_[IMAGE_BASE] = 0;
+
+	QmImageParams* params = allocate<QmImageParams>(IMAGE_PARAMS, 1);
+	params->time = world.time;
+	params->tickTime = world.ticktime;
+	params->tickCount = world.tickCount;
+	std::memcpy(params->gravity, &world.gravity, sizeof(params->gravity));
+	std::memcpy(params->electricField, &world.electricField, sizeof(params->electricField));
+	params->chargeInteraction = world.chargeInteraction;
+	params->chargeK = world.chargeK;
+	params->chargeTheta = world.chargeTheta;
+	params->implicitSprings = world.implicitSprings;
+	params->cgMaxIterations = world.cgMaxIterations;
+	params->cgTolerance = world.cgTolerance;
+	params->deterministic = world.deterministic;
+	params->nextHandle = world.nextHandle;
+
+	// Bodies: one pass per array keeps every write sequential.
+	const std::vector<QmBody*>& bodies = world.bodies;
+	size_t n = bodies.size();
+	std::memcpy(allocate<int32_t>(IMAGE_HANDLES, n), world.bodyHandles.data(), n * sizeof(int32_t));
+	glm::vec3* pos = allocate<glm::vec3>(IMAGE_POSITIONS, n);
+	glm::vec3* vel = allocate<glm::vec3>(IMAGE_VELOCITIES, n);
+	glm::vec3* acc = allocate<glm::vec3>(IMAGE_ACCELERATIONS, n);
+	float* invMass = allocate<float>(IMAGE_INV_MASSES, n);
+	float* charge = allocate<float>(IMAGE_CHARGES, n);
+	float* radius = allocate<float>(IMAGE_RADII, n);
+	uint8_t* flags = allocate<uint8_t>(IMAGE_FLAGS, n);
+	float* drag = allocate<float>(IMAGE_DRAG, n * 2);
+	count_[IMAGE_DRAG] = n;
+	for (size_t i = 0; i < n; i++)
+	{
+		QmParticle* p = (QmParticle*)bodies[i];
+		pos[i] = p->getPos();
+		vel[i] = p->getVel();
+		acc[i] = p->getAcc();
+		invMass[i] = p->getInvMass();
+		charge[i] = p->getCharge();
+		radius[i] = p->getRadius();
+		flags[i] = p->IsAcc() ? 1 : 0;
+		drag[2 * i] = world.linearDrag[i];
+		drag[2 * i + 1] = world.quadraticDrag[i];
+	}
+
+	QmImageHalfSpace* half = allocate<QmImageHalfSpace>(IMAGE_HALF_SPACES, world.halfSpaces.size());
+	for (size_t i = 0; i < world.halfSpaces.size(); i++)
+	{
+		glm::vec3 normal = world.halfSpaces[i]->GetNormal(), offset = world.halfSpaces[i]->GetOffset();
+		std::memcpy(half[i].normal, &normal, sizeof(half[i].normal));
+		std::memcpy(half[i].offset, &offset, sizeof(half[i].offset));
+	}
+
+	// Pointers between objects become body indices.
+	BodyIndex index;
+	if (!world.forceRegistry.empty() || !world.springNetworks.empty())
+	{
+		index.reserve(n);
+		for (size_t i = 0; i < n; i++)
+			index[(QmParticle*)bodies[i]] = (int)i;
+	}
+
+	// Generators are shared between entries, so they are stored once each.
+	std::vector<QmImageGenerator> generators;
+	std::vector<QmImageForce> forces;
+	std::unordered_map<QmForceGenerator*, int> generatorIndex;
+	int skipped = 0;
+	for (QmForceRegistry* fr : world.forceRegistry)
+	{
+		QmImageForce force;
+		force.body = indexOf(index, fr->p);
+		std::unordered_map<QmForceGenerator*, int>::iterator it = generatorIndex.find(fr->fg);
+		if (it != generatorIndex.end())
+			force.generator = it->second;
+		else
+		{
+			QmImageGenerator g;
+			std::memset(&g, 0, sizeof(g));
+			g.type = fr->fg->getType();
+			g.body = -1;
+			switch (g.type)
+			{
+			case FORCE_DRAG:
+				g.k = ((QmDrag*)fr->fg)->getK1();
+				g.k2 = ((QmDrag*)fr->fg)->getK2();
+				break;
+			case FORCE_SPRING:
+				g.k = ((QmSpring*)fr->fg)->getRaideur();
+				g.restLength = ((QmSpring*)fr->fg)->getRestLength();
+				g.body = indexOf(index, ((QmSpring*)fr->fg)->part);
+				break;
+			case FORCE_FIXED_SPRING:
+				g.k = ((QmFixedSpring*)fr->fg)->getRaideur();
+				g.restLength = ((QmFixedSpring*)fr->fg)->getRestLength();
+				std::memcpy(g.point, &((QmFixedSpring*)fr->fg)->fix, sizeof(g.point));
+				break;
+			case FORCE_MAGNETISM:
+				g.k = ((QmMagnetism*)fr->fg)->getK();
+				g.body = indexOf(index, ((QmMagnetism*)fr->fg)->part);
+				break;
+			case FORCE_FIXED_MAGNETISM:
+				g.k = ((QmFixedMagnetism*)fr->fg)->getK();
+				g.body = indexOf(index, ((QmFixedMagnetism*)fr->fg)->partfix);
+				break;
+			}
+			bool needsBody = g.type == FORCE_SPRING || g.type == FORCE_MAGNETISM || g.type == FORCE_FIXED_MAGNETISM;
+			if (g.type == FORCE_CUSTOM || (needsBody && g.body < 0))
+				force.generator = -1;
+			else
+			{
+				force.generator = (int)generators.size();
+				generators.push_back(g);
+			}
+			generatorIndex[fr->fg] = force.generator;
+		}
+		if (force.body < 0 || force.generator < 0)
+		{
+			skipped++;
+			continue;
+		}
+		forces.push_back(force);
+	}
+	std::memcpy(allocate<QmImageGenerator>(IMAGE_GENERATORS, generators.size()), generators.data(), generators.size() * sizeof(QmImageGenerator));
+	std::memcpy(allocate<QmImageForce>(IMAGE_FORCES, forces.size()), forces.data(), forces.size() * sizeof(QmImageForce));
+
+	// Networks keep their node order, so that their springs come back in the same order.
+	std::vector<QmImageNetwork> networks;
+	std::vector<int32_t> nodes;
+	std::vector<QmImageSpring> springs;
+	for (QmSpringNetwork* net : world.springNetworks)
+	{
+		QmImageNetwork record;
+		record.firstNode = (int32_t)nodes.size();
+		record.nodeCount = net->getNodeCount();
+		record.firstSpring = (int32_t)springs.size();
+		record.springCount = net->getSpringCount();
+		std::unordered_map<QmParticle*, int> local;
+		for (int i = 0; i < record.nodeCount; i++)
+		{
+			nodes.push_back(indexOf(index, net->getNode(i)));
+			local[net->getNode(i)] = i;
+		}
+		for (int e = 0; e < record.springCount; e++)
+		{
+			QmImageSpring s;
+			s.i = local[net->getSpringStart(e)];
+			s.j = local[net->getSpringEnd(e)];
+			s.k = net->getSpringStiffness(e);
+			s.restLength = net->getSpringRestLength(e);
+			springs.push_back(s);
+		}
+		networks.push_back(record);
+	}
+	std::memcpy(allocate<QmImageNetwork>(IMAGE_NETWORKS, networks.size()), networks.data(), networks.size() * sizeof(QmImageNetwork));
+	std::memcpy(allocate<int32_t>(IMAGE_NETWORK_NODES, nodes.size()), nodes.data(), nodes.size() * sizeof(int32_t));
+	std::memcpy(allocate<QmImageSpring>(IMAGE_NETWORK_SPRINGS, springs.size()), springs.data(), springs.size() * sizeof(QmImageSpring));
+
+	QmImageCutoff* cutoffs = allocate<QmImageCutoff>(IMAGE_CUTOFFS, world.cutoffForces.size());
+	for (size_t i = 0; i < world.cutoffForces.size(); i++)
+	{
+		cutoffs[i].k = world.cutoffForces[i]->getK();
+		cutoffs[i].cutoff = world.cutoffForces[i]->getNeighborList().getCutoff();
+		cutoffs[i].skin = world.cutoffForces[i]->getNeighborList().getSkin();
+	}
+
+	if (skipped > 0)
+		std::cout << "World image: " << skipped << " force entries left out (custom generator or particle outside the world)." << std::endl;
+	return skipped;
+}
+
+bool QmWorldImage::write(const char* path) const
+{
+	return write(path, NULL, NULL);
+}
+
+bool QmWorldImage::write(const char* path, const char* base, const bool* sections) const
+{
+	if (!littleEndian() || !data_[IMAGE_PARAMS])
+		return false;
+
+	// The section list: everything the image holds, or the requested sections and the link.
+	const void* data[IMAGE_SECTION_COUNT];
+	uint64_t count[IMAGE_SECTION_COUNT];
+	int ids[IMAGE_SECTION_COUNT];
+	uint32_t sectionCount = 0;
+	for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+	{
+		data[s] = data_[s];
+		count[s] = count_[s];
+		if (s == IMAGE_BASE)
+		{
+			data[s] = base;
+			count[s] = base ? std::strlen(base) : 0;
+			if (!base)
+				continue;
+		}
+		else if (base && sections && s != IMAGE_PARAMS && !sections[s])
+			continue;
+		ids[sectionCount++] = s;
+	}
+
+	QmImageHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.sectionCount = sectionCount;
+
+	QmImageSectionEntry table[IMAGE_SECTION_COUNT];
+	uint64_t tableSize = sectionCount * sizeof(QmImageSectionEntry);
+	uint64_t offset = alignUp(sizeof(header) + tableSize);
+	for (uint32_t k = 0; k < sectionCount; k++)
+	{
+		int s = ids[k];
+		table[k].id = s;
+		table[k].elementSize = getElementSize(s);
+		table[k].count = count[s];
+		table[k].offset = offset;
+		offset = alignUp(offset + count[s] * table[k].elementSize);
+	}
+	header.fileSize = offset;
+
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	static const char zeros[ALIGNMENT] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(table, (size_t)tableSize, 1, f) == 1;
+	uint64_t written = sizeof(header) + tableSize;
+	for (uint32_t k = 0; k < sectionCount && ok; k++)
+	{
+		ok = fwrite(zeros, 1, (size_t)(table[k].offset - written), f) == table[k].offset - written;
+		size_t bytes = (size_t)(table[k].count * table[k].elementSize);
+		if (ok && bytes > 0)
+			ok = fwrite(data[ids[k]], 1, bytes, f) == bytes;
+		written = table[k].offset + bytes;
+	}
+	if (ok)
+		ok = fwrite(zeros, 1, (size_t)(header.fileSize - written), f) == header.fileSize - written;
+	return fclose(f) == 0 && ok;
+}
+
+bool QmWorldImage::read(const char* path)
+{
+	return read(std::string(path), MAX_BASE_DEPTH);
+}
+
+bool QmWorldImage::read(const std::string& path, int depth)
+{
+	for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+	{
+		storage_[s].clear();
+		data_[s] = NULL;
+		count_[s] = 0;
+	}
+	base_.reset();
+	if (!littleEndian() || !file_.open(path.c_str()))
+		return false;
+
+	const unsigned char* base = file_.data();
+	uint64_t size = file_.size();
+	QmImageHeader header;
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(&header, base, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.fileSize > size
+		|| sizeof(header) + (uint64_t)header.sectionCount * sizeof(QmImageSectionEntry) > size)
+	{
+		file_.close();
+		return false;
+	}
+
+	const QmImageSectionEntry* table = (const QmImageSectionEntry*)(base + sizeof(header));
+	for (uint32_t k = 0; k < header.sectionCount; k++)
+	{
+		QmImageSectionEntry e = table[k];
+		if (e.id >= IMAGE_SECTION_COUNT)
+			continue; // written by a newer version
+		if (e.elementSize != getElementSize(e.id) || e.offset % ALIGNMENT != 0 || e.offset > size
+			|| (e.count > 0 && e.count > (size - e.offset) / e.elementSize))
+		{
+			file_.close();
+			return false;
+		}
+		data_[e.id] = base + e.offset;
+		count_[e.id] = e.count;
+	}
+	if (count_[IMAGE_PARAMS] != 1)
+	{
+		file_.close();
+		return false;
+	}
+
+	// Incremental image: the sections it leaves out come from its base.
+	if (data_[IMAGE_BASE])
+	{
+		std::string name((const char*)data_[IMAGE_BASE], (size_t)count_[IMAGE_BASE]);
+		size_t slash = path.find_last_of("/\\");
+		std::string basePath = slash == std::string::npos ? name : path.substr(0, slash + 1) + name;
+		base_.reset(new QmWorldImage());
+		if (depth <= 0 || name.empty() || !base_->read(basePath, depth - 1))
+		{
+			base_.reset();
+			file_.close();
+			return false;
+		}
+		bool present[IMAGE_SECTION_COUNT] = { false };
+		for (uint32_t k = 0; k < header.sectionCount; k++)
+			if (table[k].id < IMAGE_SECTION_COUNT)
+				present[table[k].id] = true;
+		for (int s = 0; s < IMAGE_SECTION_COUNT; s++)
+			if (!present[s])
+			{
+				data_[s] = base_->data_[s];
+				count_[s] = base_->count_[s];
+			}
+		data_[IMAGE_BASE] = NULL;
+		count_[IMAGE_BASE] = 0;
+	}
+	return true;
+}
+
+bool QmWorldImage::validate() const
+{
+	if (count_[IMAGE_PARAMS] != 1)
+		return false;
+	const QmImageParams* params = (const QmImageParams*)data_[IMAGE_PARAMS];
+	uint64_t n = count_[IMAGE_HANDLES];
+	const int perBody[] = { IMAGE_POSITIONS, IMAGE_VELOCITIES, IMAGE_ACCELERATIONS, IMAGE_INV_MASSES, IMAGE_CHARGES, IMAGE_RADII, IMAGE_FLAGS, IMAGE_DRAG };
+	for (int s : perBody)
+		if (count_[s] != n)
+			return false;
+	if (params->nextHandle < 0 || (uint64_t)params->nextHandle < n)
+		return false;
+
+	const int32_t* handles = (const int32_t*)data_[IMAGE_HANDLES];
+	std::vector<char> used(params->nextHandle, 0);
+	for (uint64_t i = 0; i < n; i++)
+	{
+		if (!inRange(handles[i], params->nextHandle) || used[handles[i]])
+			return false;
+		used[handles[i]] = 1;
+	}
+
+	const QmImageGenerator* generators = (const QmImageGenerator*)data_[IMAGE_GENERATORS];
+	for (uint64_t g = 0; g < count_[IMAGE_GENERATORS]; g++)
+	{
+		int type = generators[g].type;
+		if (type < FORCE_DRAG || type > FORCE_FIXED_MAGNETISM)
+			return false;
+		if ((type == FORCE_SPRING || type == FORCE_MAGNETISM || type == FORCE_FIXED_MAGNETISM) && !inRange(generators[g].body, n))
+			return false;
+	}
+	const QmImageForce* forces = (const QmImageForce*)data_[IMAGE_FORCES];
+	for (uint64_t f = 0; f < count_[IMAGE_FORCES]; f++)
+		if (!inRange(forces[f].body, n) || !inRange(forces[f].generator, count_[IMAGE_GENERATORS]))
+			return false;
+
+	const QmImageNetwork* networks = (const QmImageNetwork*)data_[IMAGE_NETWORKS];
+	const int32_t* nodes = (const int32_t*)data_[IMAGE_NETWORK_NODES];
+	const QmImageSpring* springs = (const QmImageSpring*)data_[IMAGE_NETWORK_SPRINGS];
+	for (uint64_t k = 0; k < count_[IMAGE_NETWORKS]; k++)
+	{
+		const QmImageNetwork& net = networks[k];
+		if (net.firstNode < 0 || net.nodeCount < 0 || (uint64_t)net.firstNode + net.nodeCount > count_[IMAGE_NETWORK_NODES]
+			|| net.firstSpring < 0 || net.springCount < 0 || (uint64_t)net.firstSpring + net.springCount > count_[IMAGE_NETWORK_SPRINGS])
+			return false;
+		for (int i = 0; i < net.nodeCount; i++)
+			if (!inRange(nodes[net.firstNode + i], n))
+				return false;
+		for (int e = 0; e < net.springCount; e++)
+			if (!inRange(springs[net.firstSpring + e].i, net.nodeCount) || !inRange(springs[net.firstSpring + e].j, net.nodeCount))
+				return false;
+	}
+	return true;
+}
+
+bool QmWorldImage::restore(QmWorld& world) const
+{
+	if (!validate())
+		return false;
+
+	world.clear();
+
+	const QmImageParams* params = (const QmImageParams*)data_[IMAGE_PARAMS];
+	world.time = params->time;
+	world.ticktime = params->tickTime;
+	world.tickCount = params->tickCount;
+	std::memcpy(&world.gravity, params->gravity, sizeof(params->gravity));
+	std::memcpy(&world.electricField, params->electricField, sizeof(params->electricField));
+	world.chargeInteraction = params->chargeInteraction != 0;
+	world.chargeK = params->chargeK;
+	world.chargeTheta = params->chargeTheta;
+	world.implicitSprings = params->implicitSprings != 0;
+	world.cgMaxIterations = params->cgMaxIterations;
+	world.cgTolerance = params->cgTolerance;
+	world.deterministic = params->deterministic != 0;
+
+	// Bodies: the index arrays are copied in bulk, the particles built in one pass.
+	size_t n = (size_t)count_[IMAGE_HANDLES];
+	const int32_t* handles = (const int32_t*)data_[IMAGE_HANDLES];
+	const glm::vec3* pos = (const glm::vec3*)data_[IMAGE_POSITIONS];
+	const glm::vec3* vel = (const glm::vec3*)data_[IMAGE_VELOCITIES];
+	const glm::vec3* acc = (const glm::vec3*)data_[IMAGE_ACCELERATIONS];
+	const float* invMass = (const float*)data_[IMAGE_INV_MASSES];
+	const float* charge = (const float*)data_[IMAGE_CHARGES];
+	const float* radius = (const float*)data_[IMAGE_RADII];
+	const uint8_t* flags = (const uint8_t*)data_[IMAGE_FLAGS];
+	const float* drag = (const float*)data_[IMAGE_DRAG];
+
+	world.bodyHandles.assign(handles, handles + n);
+	world.handleIndex.assign(params->nextHandle, -1);
+	world.linearDrag.resize(n);
+	world.quadraticDrag.resize(n);
+	world.bodies.resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		QmParticle* p = new QmParticle(pos[i], vel[i], acc[i], 1, charge[i], radius[i], (flags[i] & 1) != 0);
+		p->setInvMass(invMass[i]);
+		world.bodies[i] = p;
+		world.handleIndex[handles[i]] = (int)i;
+		world.linearDrag[i] = drag[2 * i];
+		world.quadraticDrag[i] = drag[2 * i + 1];
+	}
+	world.nextHandle = params->nextHandle;
+
+	const QmImageHalfSpace* half = (const QmImageHalfSpace*)data_[IMAGE_HALF_SPACES];
+	for (uint64_t i = 0; i < count_[IMAGE_HALF_SPACES]; i++)
+		world.halfSpaces.push_back(new HalfSpace(glm::vec3(half[i].normal[0], half[i].normal[1], half[i].normal[2]),
+			glm::vec3(half[i].offset[0], half[i].offset[1], half[i].offset[2])));
+
+	std::vector<QmForceGenerator*> generators((size_t)count_[IMAGE_GENERATORS]);
+	const QmImageGenerator* g = (const QmImageGenerator*)data_[IMAGE_GENERATORS];
+	for (size_t k = 0; k < generators.size(); k++)
+	{
+		QmParticle* other = g[k].body >= 0 ? (QmParticle*)world.bodies[g[k].body] : NULL;
+		switch (g[k].type)
+		{
+		case FORCE_DRAG: generators[k] = (QmForceGenerator*)new QmDrag(g[k].k, g[k].k2); break;
+		case FORCE_SPRING: generators[k] = (QmForceGenerator*)new QmSpring(g[k].k, g[k].restLength, other); break;
+		case FORCE_FIXED_SPRING: generators[k] = (QmForceGenerator*)new QmFixedSpring(g[k].k, g[k].restLength, glm::vec3(g[k].point[0], g[k].point[1], g[k].point[2])); break;
+		case FORCE_MAGNETISM: generators[k] = (QmForceGenerator*)new QmMagnetism(g[k].k, other); break;
+		case FORCE_FIXED_MAGNETISM: generators[k] = (QmForceGenerator*)new QmFixedMagnetism(g[k].k, other); break;
+		}
+	}
+	const QmImageForce* forces = (const QmImageForce*)data_[IMAGE_FORCES];
+	for (uint64_t f = 0; f < count_[IMAGE_FORCES]; f++)
+		world.forceRegistry.push_back(new QmForceRegistry((QmParticle*)world.bodies[forces[f].body], generators[forces[f].generator]));
+
+	const QmImageNetwork* networks = (const QmImageNetwork*)data_[IMAGE_NETWORKS];
+	const int32_t* nodes = (const int32_t*)data_[IMAGE_NETWORK_NODES];
+	const QmImageSpring* springs = (const QmImageSpring*)data_[IMAGE_NETWORK_SPRINGS];
+	for (uint64_t k = 0; k < count_[IMAGE_NETWORKS]; k++)
+	{
+		QmSpringNetwork* net = new QmSpringNetwork();
+		const int32_t* netNodes = nodes + networks[k].firstNode;
+		for (int i = 0; i < networks[k].nodeCount; i++)
+			net->addNode((QmParticle*)world.bodies[netNodes[i]]);
+		for (int e = 0; e < networks[k].springCount; e++)
+		{
+			const QmImageSpring& s = springs[networks[k].firstSpring + e];
+			net->addSpring((QmParticle*)world.bodies[netNodes[s.i]], (QmParticle*)world.bodies[netNodes[s.j]], s.k, s.restLength);
+		}
+		world.springNetworks.push_back(net);
+	}
+
+	const QmImageCutoff* cutoffs = (const QmImageCutoff*)data_[IMAGE_CUTOFFS];
+	for (uint64_t k = 0; k < count_[IMAGE_CUTOFFS]; k++)
+		world.cutoffForces.push_back(new QmCutoffMagnetism(cutoffs[k].k, cutoffs[k].cutoff, cutoffs[k].skin));
+
+	world.stateHash = world.deterministic ? world.computeStateHash() : 0;
+	return true;
+}
+
+bool QmWorldImage::save(QmWorld& world, const char* path)
+{
+	QmWorldImage image;
+	image.capture(world);
+	return image.write(path);
+}
+
+bool QmWorldImage::load(QmWorld& world, const char* path)
+{
+	QmWorldImage image;
+	return image.read(path) && image.restore(world);
+}
@@ -0,0 +1,273 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "QmMappedFile.h"
+
+namespace Quantum {
+
+	class QmWorld;
+
+	/**
+	 * @brief Sections of a world image. The values are stored in the file.
+	 *
+	 * Per-body sections hold one element per body, in body order.
+	 */
+	enum QmImageSection {
+		IMAGE_PARAMS = 0,          ///< One QmImageParams.
+		IMAGE_HANDLES = 1,         ///< int32 handle of each body.
+		IMAGE_POSITIONS = 2,       ///< float[3] per body.
+		IMAGE_VELOCITIES = 3,      ///< float[3] per body.
+		IMAGE_ACCELERATIONS = 4,   ///< float[3] per body.
+		IMAGE_INV_MASSES = 5,      ///< float per body.
+		IMAGE_CHARGES = 6,         ///< float per body.
+		IMAGE_RADII = 7,           ///< float per body.
+		IMAGE_FLAGS = 8,           ///< uint8 per body, bit 0: subject to acceleration (QmParticle::IsAcc).
+		IMAGE_DRAG = 9,            ///< float[2] per body, world drag coefficients K1 and K2.
+		IMAGE_HALF_SPACES = 10,    ///< QmImageHalfSpace.
+		IMAGE_GENERATORS = 11,     ///< QmImageGenerator, shared by the force entries.
+		IMAGE_FORCES = 12,         ///< QmImageForce, in registry order.
+		IMAGE_NETWORKS = 13,       ///< QmImageNetwork.
+		IMAGE_NETWORK_NODES = 14,  ///< int32 body index of each network node.
+		IMAGE_NETWORK_SPRINGS = 15,///< QmImageSpring.
+		IMAGE_CUTOFFS = 16,        ///< QmImageCutoff.
+		IMAGE_BASE = 17,           ///< char, file name of the image holding the sections this file leaves out.
+		IMAGE_SECTION_COUNT
+	};
+
+	/**
+	 * @struct QmImageHeader
+	 * @brief First 64 bytes of a world image file.
+	 */
+	struct QmImageHeader {
+		char magic[8];          ///< "QMWORLD" and a zero.
+		uint32_t version;       ///< QmWorldImage::VERSION.
+		uint32_t sectionCount;  ///< Entries in the section table that follows.
+		uint64_t fileSize;      ///< Total size, to detect truncated files.
+		uint64_t reserved[5];
+	};
+
+	/**
+	 * @struct QmImageSectionEntry
+	 * @brief Entry of the section table.
+	 */
+	struct QmImageSectionEntry {
+		uint32_t id;            ///< QmImageSection.
+		uint32_t elementSize;   ///< Bytes per element.
+		uint64_t count;         ///< Number of elements.
+		uint64_t offset;        ///< From the start of the file, multiple of 64.
+	};
+
+	/**
+	 * @struct QmImageParams
+	 * @brief World parameters.
+	 */
+	struct QmImageParams {
+		float time;
+		float tickTime;
+		uint64_t tickCount;
+		float gravity[3];
+		float electricField[3];
+		uint32_t chargeInteraction;
+		float chargeK;
+		float chargeTheta;
+		uint32_t implicitSprings;
+		int32_t cgMaxIterations;
+		float cgTolerance;
+		uint32_t deterministic;
+		int32_t nextHandle;     ///< Handles below it are taken or free.
+	};
+
+	/// @brief A half-space of the collision box.
+	struct QmImageHalfSpace {
+		float normal[3];
+		float offset[3];
+	};
+
+	/**
+	 * @struct QmImageGenerator
+	 * @brief A force generator; the meaning of the fields depends on type.
+	 */
+	struct QmImageGenerator {
+		int32_t type;           ///< FORCE_* constant.
+		int32_t body;           ///< Index of the reference particle (springs, magnetism), -1 if none.
+		float k;                ///< Stiffness, magnetism coefficient or linear drag.
+		float k2;               ///< Quadratic drag.
+		int32_t restLength;     ///< Rest length of the springs.
+		float point[3];         ///< Anchor of a fixed spring.
+	};
+
+	/// @brief A force registry entry.
+	struct QmImageForce {
+		int32_t body;           ///< Index of the particle the force acts on.
+		int32_t generator;      ///< Index in IMAGE_GENERATORS.
+	};
+
+	/// @brief A spring network: ranges of IMAGE_NETWORK_NODES and IMAGE_NETWORK_SPRINGS.
+	struct QmImageNetwork {
+		int32_t firstNode;
+		int32_t nodeCount;
+		int32_t firstSpring;
+		int32_t springCount;
+	};
+
+	/// @brief A spring of a network, between two nodes of that network.
+	struct QmImageSpring {
+		int32_t i;
+		int32_t j;
+		float k;
+		float restLength;
+	};
+
+	/// @brief A short-range magnetism (QmCutoffMagnetism).
+	struct QmImageCutoff {
+		float k;
+		float cutoff;
+		float skin;
+	};
+
+	/**
+	 * @class QmWorldImage
+	 * @brief Binary snapshot of a QmWorld, saved and restored with bulk copies.
+	 *
+	 * The file is little-endian: a QmImageHeader, a section table, then one
+	 * flat array per section, each aligned on 64 bytes. Bodies are stored as
+	 * arrays of structures of arrays and references between objects as
+	 * indices, so a file can be mapped and read without parsing. Readers
+	 * skip the sections they do not know; a change to an existing layout
+	 * bumps VERSION.
+	 *
+	 * An incremental image only contains the sections that changed since
+	 * another image, whose file name (in the same directory) is stored in
+	 * IMAGE_BASE; read() follows these links to fill in the other sections.
+	 *
+	 * The image covers the bodies with their handles, the half-spaces, the
+	 * force registry (built-in generator types only), the spring networks,
+	 * the cutoff forces and the world parameters. Commands still queued, the
+	 * thread pool and the render updaters are not part of it.
+	 */
+	class QmWorldImage {
+	public:
+
+		/// @brief File format version.
+		static const uint32_t VERSION = 1;
+
+		QmWorldImage();
+
+		/**
+		 * @brief Copies the state of a world into the image.
+		 *
+		 * The world must not be ticking. Force entries with a custom
+		 * generator, or referring to a particle outside the world, are
+		 * left out.
+		 *
+		 * @return Number of force entries left out.
+		 */
+		int capture(QmWorld& world);
+
+		/**
+		 * @brief Writes the image to a file.
+		 * @return False on I/O error.
+		 */
+		bool write(const char* path) const;
+
+		/**
+		 * @brief Writes an incremental image.
+		 *
+		 * @param path     File to write.
+		 * @param base     File name of the image holding the other sections, in the directory of path.
+		 * @param sections Which sections to write (IMAGE_SECTION_COUNT flags); IMAGE_PARAMS is always written.
+		 * @return False on I/O error.
+		 */
+		bool write(const char* path, const char* base, const bool* sections) const;
+
+		/**
+		 * @brief Maps an image file. The sections point into the mapping.
+		 *
+		 * The images an incremental file is based on are mapped too.
+		 *
+		 * @return False if a file cannot be mapped or is not a valid image.
+		 */
+		bool read(const char* path);
+
+		/**
+		 * @brief Replaces the content of a world with the image.
+		 *
+		 * The world must not be ticking; restored objects are owned like the
+		 * ones added through the usual calls.
+		 *
+		 * @return False, leaving the world untouched, if the image is inconsistent.
+		 */
+		bool restore(QmWorld& world) const;
+
+		/**
+		 * @brief capture() then write().
+		 */
+		static bool save(QmWorld& world, const char* path);
+
+		/**
+		 * @brief read() then restore().
+		 */
+		static bool load(QmWorld& world, const char* path);
+
+		/**
+		 * @return Elements of a section, NULL if the image has none.
+		 */
+		const void* getSection(int id) const;
+
+		/**
+		 * @return Number of elements of a section.
+		 */
+		uint64_t getCount(int id) const;
+
+		/**
+		 * @return Size in bytes of one element of a section.
+		 */
+		static uint32_t getElementSize(int id);
+
+		/**
+		 * @return 64-bit hash of the content of a section, to detect the sections that changed.
+		 */
+		uint64_t hashSection(int id) const;
+
+	private:
+
+		/**
+		 * @brief Points a section at count zeroed elements of its own storage.
+		 */
+		template <class T>
+		T* allocate(int id, size_t count)
+		{
+			storage_[id].assign(count * sizeof(T), 0);
+			data_[id] = storage_[id].data();
+			count_[id] = count;
+			return (T*)storage_[id].data();
+		}
+
+		/**
+		 * @brief Checks that counts and indices are consistent before a restore.
+		 */
+		bool validate() const;
+
+		/**
+		 * @brief read() following at most depth links to base images.
+		 */
+		bool read(const std::string& path, int depth);
+
+		/// @brief Elements of each section, in storage_ or in file_.
+		const void* data_[IMAGE_SECTION_COUNT];
+
+		/// @brief Number of elements of each section.
+		uint64_t count_[IMAGE_SECTION_COUNT];
+
+		/// @brief Sections filled by capture().
+		std::vector<unsigned char> storage_[IMAGE_SECTION_COUNT];
+
+		/// @brief File mapped by read().
+		QmMappedFile file_;
+
+		/// @brief Image the mapped file is based on, when it is incremental.
+		std::unique_ptr<QmWorldImage> base_;
+	};
+}
@@ -4,4 +4,26 @@
 #include "QmUpdater.h"
 #include "QmForceGenerator.h"
 #include "QmForceRegistry.h"
-#include "QmDrag.h"
\ No newline at end of file
+#include "QmDrag.h"
+#include "QmSpringNetwork.h"
+#include "QmOctree.h"
+#include "QmNeighborList.h"
+#include "QmCutoffMagnetism.h"
+#include "QmBlockMatrix.h"
+#include "QmTripleBuffer.h"
+#include "QmCommandQueue.h"
+#include "QmThreadPool.h"
+#include "QmWorldBatch.h"
+#include "QmPerfCounters.h"
+#include "QmAllocTracker.h"
+#include "QmStats.h"
+#include "QmTrace.h"
+#include "QmMappedFile.h"
+#include "QmWorldImage.h"
+#include "QmCheckpointer.h"
+#include "QmTrajectoryWriter.h"
+#include "QmTrajectoryReader.h"
+#include "QmMortonOrder.h"
+#include "QmPackedAABBs.h"
+#include "QmEmitter.h"
+#include "QmScene.h"
\ No newline at end of file
@@ -5,4 +5,6 @@
 // Si vous souhaitez gnrer votre application pour une plateforme Windows prcdente, incluez WinSDKVer.h et
 // dfinissez la macro _WIN32_WINNT  la plateforme que vous souhaitez prendre en charge avant d'inclure SDKDDKVer.h.
 
+#ifdef _WIN32
 #include <SDKDDKVer.h>
+#endif
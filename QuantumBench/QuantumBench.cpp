@@ -0,0 +1,580 @@
+// Microbenchmarks of the tick phases of QmWorld.
+//
+// Every phase is timed on its own, on seeded random layouts of growing size,
+// and reported in ns per particle (or per pair for the pairwise phases) as
+// CSV, so that runs before and after a change can be compared directly.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream> // initializes std::cout before QmWorld prints to it
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Quantum.h"
+
+using namespace Quantum;
+
+// ------------------- Options -------------------
+
+std::vector<int> sizes = { 1000, 10000, 100000, 1000000 };
+unsigned int seed = 1;
+double minTime = 0.2;
+double maxPairs = 2e9;
+std::string filter;
+std::string outPath = "quantum_bench.csv";
+bool perf = false;
+
+/// @brief Number of accuracy checks that failed (the exit status is 1 if any).
+int failures = 0;
+
+
+// ------------------- Layout -------------------
+
+/**
+ * @brief Random initial state shared by all phases of one size.
+ *
+ * Particles are spread uniformly in a cube whose volume grows with n, so
+ * that the density (and the number of close pairs) does not depend on n.
+ */
+struct Layout {
+	std::vector<glm::vec3> pos, vel;
+	std::vector<float> charge;
+
+	Layout(int n)
+	{
+		std::mt19937 rng(seed + n);
+		float side = 2.f * std::cbrt((float)n);
+		std::uniform_real_distribution<float> x(-side / 2, side / 2), v(-1.f, 1.f);
+		for (int i = 0; i < n; i++)
+		{
+			pos.push_back(glm::vec3(x(rng), x(rng), x(rng)));
+			vel.push_back(glm::vec3(v(rng), v(rng), v(rng)));
+			charge.push_back(rng() % 2 ? 1.f : -1.f);
+		}
+	}
+};
+
+/// @brief Registry entries and generators of the current world, deleted by resetWorld().
+std::vector<std::function<void()>> garbage;
+
+/**
+ * @brief Fills the world with the particles of a layout.
+ */
+std::vector<QmParticle*> populate(QmWorld& world, const Layout& l)
+{
+	std::vector<QmParticle*> ps;
+	for (size_t i = 0; i < l.pos.size(); i++)
+	{
+		QmParticle* p = new QmParticle(l.pos[i], l.vel[i], glm::vec3(0, 0, 0), 1, l.charge[i], 0.3f, 1);
+		world.addBody(p);
+		ps.push_back(p);
+	}
+	return ps;
+}
+
+/**
+ * @brief Registers p with a generator owned by the benchmark.
+ */
+template <class T>
+void addForce(QmWorld& world, QmParticle* p, T* generator)
+{
+	QmForceRegistry* fr = new QmForceRegistry(p, (QmForceGenerator*)generator);
+	world.AddForceRegistry(fr);
+	garbage.push_back([fr]() { delete fr->fg; delete fr; });
+}
+
+/**
+ * @brief Empties the world and frees what the benchmark allocated.
+ */
+void resetWorld(QmWorld& world)
+{
+	world.clear();
+	world.setChargeInteraction(false, 0.f, 0.7f);
+	for (std::function<void()>& f : garbage)
+		f();
+	garbage.clear();
+}
+
+/// @brief Particles of the chain stepped by the batch phases.
+const int CHAIN = 16;
+
+/// @brief Drag coefficients of the chain particles.
+const float CHAIN_K1 = 0.1f, CHAIN_K2 = 0.05f;
+
+/// @brief Parameters of batch world w, so that neighbouring worlds differ.
+float chainDamping(int w) { return 0.99f + 0.001f * (w % 5); }
+float chainStiffness(int w) { return 4.f + (w % 7); }
+float chainMagnetism(int w) { return 0.1f * (w % 3); }
+
+/**
+ * @brief Builds a chain of CHAIN charged particles in every world of a batch.
+ *
+ * Neighbours are linked by springs of rest length 1 and the first particle
+ * is held by a fixed spring; the layout jitters the initial state.
+ */
+void buildChain(QmWorldBatch& batch, const Layout& l)
+{
+	for (int i = 0; i < CHAIN; i++)
+	{
+		batch.addParticle(glm::vec3((float)i, 0, 0) + 0.2f * l.vel[i], l.vel[i], 1, l.charge[i], true, CHAIN_K1, CHAIN_K2);
+		if (i > 0)
+			batch.addSpring(i - 1, i, 1);
+	}
+	batch.addFixedSpring(0, glm::vec3(-1, 0, 0), 1);
+	for (int w = 0; w < batch.getWorldCount(); w++)
+	{
+		batch.setDamping(w, chainDamping(w));
+		batch.setStiffness(w, chainStiffness(w));
+		batch.setMagnetism(w, chainMagnetism(w));
+	}
+}
+
+
+// ------------------- Timing -------------------
+
+FILE* out = NULL;
+
+/// @brief Hardware counters of the benchmark thread, open with --perf.
+QmPerfCounters counters;
+
+/**
+ * @brief Runs a phase until minTime is spent and records its cost.
+ *
+ * With --perf, the hardware events of the timed runs are also reported per
+ * particle or pair; the columns are left empty otherwise.
+ *
+ * @param name  Phase name.
+ * @param n     Number of particles.
+ * @param ops   Number of particles or pairs processed by one run.
+ * @param unit  "particle" or "pair".
+ * @param run   One run of the phase.
+ * @return Mean duration of one run in seconds.
+ */
+double measure(const std::string& name, int n, double ops, const char* unit, const std::function<void()>& run)
+{
+	run(); // warm up caches and scratch buffers
+	int reps = 0;
+	double best = 1e300, total = 0.;
+	unsigned long long before[PERF_EVENT_COUNT], after[PERF_EVENT_COUNT];
+	counters.read(before);
+	while (total < minTime || reps < 3)
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		run();
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		best = std::min(best, s);
+		total += s;
+		reps++;
+	}
+	counters.read(after);
+	double mean = total / reps;
+	fprintf(out, "%s,%d,%d,%s,%.0f,%.3f,%.3f", name.c_str(), n, reps, unit, ops, 1e9 * mean / ops, 1e9 * best / ops);
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+	{
+		if (counters.isAvailable(e))
+			fprintf(out, ",%.4f", (double)(after[e] - before[e]) / (reps * ops));
+		else
+			fprintf(out, ",");
+	}
+	fprintf(out, "\n");
+	fflush(out);
+	printf("%-26s n=%-8d %10.2f ns/%s (best %.2f, %d runs)", name.c_str(), n, 1e9 * mean / ops, unit, 1e9 * best / ops, reps);
+	if (counters.isOpen())
+	{
+		double cycles = (double)(after[PERF_CYCLES] - before[PERF_CYCLES]);
+		double instructions = (double)(after[PERF_INSTRUCTIONS] - before[PERF_INSTRUCTIONS]);
+		printf("  IPC %.2f, %.2f L1D / %.3f LLC / %.3f branch misses per %s", cycles > 0. ? instructions / cycles : 0.,
+			(after[PERF_L1D_MISSES] - before[PERF_L1D_MISSES]) / (reps * ops), (after[PERF_LLC_MISSES] - before[PERF_LLC_MISSES]) / (reps * ops),
+			(after[PERF_BRANCH_MISSES] - before[PERF_BRANCH_MISSES]) / (reps * ops), unit);
+	}
+	printf("\n");
+	fflush(stdout);
+	return mean;
+}
+
+/**
+ * @return Whether the phase is selected by --filter.
+ */
+bool selected(const std::string& name)
+{
+	return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+
+// ------------------- Phases -------------------
+
+/**
+ * @brief Benchmarks every phase at one size.
+ */
+void benchSize(QmWorld& world, int n)
+{
+	Layout l(n);
+	double pairs = (double)n * n;
+
+	if (selected("clear"))
+	{
+		populate(world, l);
+		measure("clear", n, n, "particle", [&] { world.ClearParticles(); });
+		resetWorld(world);
+	}
+
+	if (selected("gravity"))
+	{
+		populate(world, l);
+		measure("gravity", n, n, "particle", [&] { world.ApplyGravity(); });
+		resetWorld(world);
+	}
+
+	// One registry entry per particle; pairwise generators use the next particle.
+	struct Generator {
+		const char* name;
+		std::function<void(QmParticle*, QmParticle*)> attach;
+	};
+	const Generator generators[] = {
+		{ "forces/drag", [&](QmParticle* p, QmParticle*) { addForce(world, p, new QmDrag(0.5f, 0.1f)); } },
+		{ "forces/spring", [&](QmParticle* p, QmParticle* q) { addForce(world, p, new QmSpring(8, 1, q)); } },
+		{ "forces/fixed_spring", [&](QmParticle* p, QmParticle*) { addForce(world, p, new QmFixedSpring(8, 1, glm::vec3(0, 0, 0))); } },
+		{ "forces/magnetism", [&](QmParticle* p, QmParticle* q) { addForce(world, p, new QmMagnetism(0.2f, q)); } },
+		{ "forces/fixed_magnetism", [&](QmParticle* p, QmParticle* q) { addForce(world, p, new QmFixedMagnetism(0.4f, q)); } },
+	};
+	for (const Generator& gen : generators)
+	{
+		if (!selected(gen.name))
+			continue;
+		std::vector<QmParticle*> ps = populate(world, l);
+		for (int i = 0; i < n; i++)
+			gen.attach(ps[i], ps[(i + 1) % n]);
+		measure(gen.name, n, n, "particle", [&] { world.updateForces(); });
+		resetWorld(world);
+	}
+
+	if (selected("forces/spring_network"))
+	{
+		std::vector<QmParticle*> ps = populate(world, l);
+		QmSpringNetwork* net = new QmSpringNetwork();
+		for (int i = 0; i + 1 < n; i++)
+			net->addSpring(ps[i], ps[i + 1], 8, 1);
+		world.AddSpringNetwork(net);
+		measure("forces/spring_network", n, n, "particle", [&] { world.updateForces(); });
+		resetWorld(world);
+	}
+
+	// A cubic grid of springs whose nodes were added in random order, as
+	// when a network is assembled piece by piece; "/partitioned" renumbers
+	// it first (QmSpringNetwork::reorder).
+	for (int partitioned = 0; partitioned < 2; partitioned++)
+	{
+		std::string name = partitioned ? "forces/spring_lattice/partitioned" : "forces/spring_lattice";
+		if (!selected(name))
+			continue;
+		std::vector<QmParticle*> ps = populate(world, l);
+		int side = std::max(2, (int)std::cbrt((double)n));
+		int count = std::min(n, side * side * side);
+		std::vector<int> shuffled(count);
+		for (int i = 0; i < count; i++)
+			shuffled[i] = i;
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(seed + n));
+		QmSpringNetwork* net = new QmSpringNetwork();
+		net->reserve(count, 3 * count);
+		for (int i : shuffled)
+			net->addNode(ps[i]);
+		for (int i = 0; i < count; i++)
+		{
+			int x = i % side, y = (i / side) % side;
+			if (x + 1 < side && i + 1 < count)
+				net->addSpring(ps[i], ps[i + 1], 8, 1);
+			if (y + 1 < side && i + side < count)
+				net->addSpring(ps[i], ps[i + side], 8, 1);
+			if (i + side * side < count)
+				net->addSpring(ps[i], ps[i + side * side], 8, 1);
+		}
+		if (partitioned)
+			net->reorder();
+		world.AddSpringNetwork(net);
+		measure(name, n, count, "particle", [&] { world.updateForces(); });
+		resetWorld(world);
+	}
+
+	// The layout is random, so the bodies start in no spatial order; the
+	// "/morton" runs sort them first (QmWorld::updateSpatialOrder).
+	for (int morton = 0; morton < 2; morton++)
+	{
+		const char* suffix = morton ? "/morton" : "";
+
+		if (selected(std::string("forces/cutoff_magnetism") + suffix))
+		{
+			populate(world, l);
+			if (morton)
+				world.updateSpatialOrder();
+			world.AddCutoffMagnetism(new QmCutoffMagnetism(0.2f, 1.5f, 0.3f));
+			measure(std::string("forces/cutoff_magnetism") + suffix, n, n, "particle", [&] { world.updateForces(); });
+			resetWorld(world);
+		}
+
+		if (selected(std::string("forces/charge_octree") + suffix))
+		{
+			populate(world, l);
+			if (morton)
+				world.updateSpatialOrder();
+			world.setChargeInteraction(true, 0.2f, 0.7f);
+			measure(std::string("forces/charge_octree") + suffix, n, n, "particle", [&] { world.updateForces(); });
+			resetWorld(world);
+		}
+	}
+
+	// Accuracy of the octree against the direct O(n^2) sum, on up to 1000
+	// points, for evaluate() and for field().
+	if (selected("check/charge_octree"))
+	{
+		const float theta = 0.7f, tolerance = 0.1f;
+		QmOctree tree;
+		tree.build(l.pos.data(), l.charge.data(), n);
+		std::vector<glm::vec3> field(n);
+		tree.evaluate(theta, field.data());
+		int step = std::max(1, n / 1000);
+		double err2 = 0., walkErr2 = 0., norm2 = 0.;
+		for (int i = 0; i < n; i += step)
+		{
+			glm::vec3 exact(0);
+			for (int j = 0; j < n; j++)
+			{
+				glm::vec3 d = l.pos[i] - l.pos[j];
+				float N2 = glm::dot(d, d);
+				if (j != i && N2 > 0.f)
+					exact += d * (l.charge[j] / (std::sqrt(N2) * (N2 + 1.f)));
+			}
+			glm::vec3 walk = tree.field(l.pos[i], i, theta);
+			err2 += glm::dot(field[i] - exact, field[i] - exact);
+			walkErr2 += glm::dot(walk - exact, walk - exact);
+			norm2 += glm::dot(exact, exact);
+		}
+		double err = std::sqrt(err2 / norm2), walkErr = std::sqrt(walkErr2 / norm2);
+		bool ok = err < tolerance && walkErr < tolerance;
+		printf("%-26s n=%-8d rms relative error %.4f (field() %.4f) at theta %.1f: %s\n", "check/charge_octree", n, err, walkErr,
+			theta, ok ? "ok" : "FAILED");
+		if (!ok)
+			failures++;
+	}
+
+	// Charges posted through the command queue reach the particles unchanged.
+	if (selected("check/post_charge"))
+	{
+		populate(world, l);
+		int m = std::min(n, 100), wrong = 0;
+		for (int h = 0; h < m; h++)
+			world.postCharge(h, l.charge[h] * 0.37f);
+		world.processCommands();
+		for (int h = 0; h < m; h++)
+			wrong += ((QmParticle*)world.getBodies()[world.getBodyIndex(h)])->getCharge() != l.charge[h] * 0.37f;
+		printf("%-26s n=%-8d %d of %d posted charges changed: %s\n", "check/post_charge", n, wrong, m, wrong ? "FAILED" : "ok");
+		if (wrong)
+			failures++;
+		resetWorld(world);
+	}
+
+	// One lane of a batch stepped on a pool (three blocks of worlds) follows
+	// the same chain built in a QmWorld from the force generators.
+	if (selected("check/batch_lane"))
+	{
+		const int worlds = 130, lane = 70, steps = 300;
+		const float dt = 0.005f, tolerance = 1e-3f;
+		const glm::vec3 gravity(0, -9.81f, 0), field(0.5f, 0, 0);
+		QmThreadPool pool(2);
+		QmWorldBatch batch(worlds, &pool);
+		buildChain(batch, l);
+		batch.setGravity(gravity);
+		batch.setElectricField(field);
+
+		std::vector<QmParticle*> ps;
+		for (int i = 0; i < CHAIN; i++)
+		{
+			ps.push_back(new QmParticle(batch.getPos(lane, i), batch.getVel(lane, i), glm::vec3(0, 0, 0), 1, l.charge[i], 0.1f, 1));
+			world.AddParticle(ps[i], CHAIN_K1, CHAIN_K2);
+		}
+		float K = chainStiffness(lane), M = chainMagnetism(lane);
+		for (int i = 1; i < CHAIN; i++)
+		{
+			addForce(world, ps[i - 1], new QmSpring(K, 1, ps[i]));
+			addForce(world, ps[i], new QmSpring(K, 1, ps[i - 1]));
+		}
+		addForce(world, ps[0], new QmFixedSpring(K, 1, glm::vec3(-1, 0, 0)));
+		for (int i = 0; i < CHAIN; i++)
+			for (int j = 0; j < CHAIN; j++)
+				if (M != 0.f && j != i)
+					addForce(world, ps[i], new QmMagnetism(M, ps[j]));
+		world.setGravity(gravity);
+		world.setElectricField(field);
+
+		for (int s = 0; s < steps; s++)
+		{
+			batch.tick(dt, s % 2 == 0);
+			world.tick(dt, true, chainDamping(lane), s % 2 == 0, false);
+		}
+		float err = 0.f;
+		for (int i = 0; i < CHAIN; i++)
+			err = std::max(err, std::max(glm::length(batch.getPos(lane, i) - ps[i]->getPos()), glm::length(batch.getVel(lane, i) - ps[i]->getVel())));
+		bool ok = err < tolerance;
+		printf("%-26s n=%-8d lane %d of %d after %d ticks: largest position or velocity gap %.2g: %s\n", "check/batch_lane", n,
+			lane, worlds, steps, err, ok ? "ok" : "FAILED");
+		if (!ok)
+			failures++;
+		world.setElectricField(glm::vec3(0, 0, 0));
+		resetWorld(world);
+	}
+
+	if (selected("reorder"))
+	{
+		populate(world, l);
+		measure("reorder", n, n, "particle", [&] { world.updateSpatialOrder(); });
+		resetWorld(world);
+	}
+
+	if (selected("integrate/euler"))
+	{
+		populate(world, l);
+		measure("integrate/euler", n, n, "particle", [&] { world.integrate(0.001f, 0.995f, true, true); });
+		resetWorld(world);
+	}
+
+	if (selected("integrate/semi"))
+	{
+		populate(world, l);
+		measure("integrate/semi", n, n, "particle", [&] { world.integrate(0.001f, 0.995f, false, true); });
+		resetWorld(world);
+	}
+
+	// The broadphase tests every ordered pair: skip the sizes it cannot finish.
+	// "/exact" tests the float boxes of the particles instead of the packed ones.
+	for (int exact = 0; exact < 2; exact++)
+	{
+		const char* name = exact ? "broadphase/exact" : "broadphase";
+		if (!selected(name))
+			continue;
+		if (pairs <= maxPairs)
+		{
+			populate(world, l);
+			world.setQuantizedBroadphase(!exact);
+			measure(name, n, pairs, "pair", [&] { world.broadphase(); });
+			world.setQuantizedBroadphase(true);
+			resetWorld(world);
+		}
+		else
+			printf("%-26s n=%-8d skipped (%.0g pairs > --max-pairs)\n", name, n, pairs);
+	}
+
+	// Contacts between consecutive particles, so resolve is timed without the broadphase.
+	if (selected("resolve"))
+	{
+		std::vector<QmParticle*> ps = populate(world, l);
+		std::vector<QmContact> contacts;
+		for (int i = 0; i + 1 < n; i++)
+			contacts.push_back(QmContact(ps[i], ps[i + 1]));
+		measure("resolve", n, (double)contacts.size(), "pair", [&] { world.resolve(contacts); });
+		resetWorld(world);
+	}
+
+	// n / CHAIN chains stepped as a QmWorldBatch on 1, 2, 4, ... threads up
+	// to the hardware ones (1 runs on the caller, without a pool).
+	if (selected("batch/threads"))
+	{
+		int worlds = std::max(1, n / CHAIN);
+		int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+		std::vector<int> counts = { 1 };
+		for (int t = 2; t < hardware; t *= 2)
+			counts.push_back(t);
+		if (hardware > 1)
+			counts.push_back(hardware);
+		double base = 0.;
+		std::string scaling;
+		for (int t : counts)
+		{
+			QmThreadPool* pool = t > 1 ? new QmThreadPool(t) : NULL;
+			QmWorldBatch batch(worlds, pool);
+			buildChain(batch, l);
+			double s = measure("batch/threads" + std::to_string(t), n, worlds, "world", [&] { batch.tick(0.001f, false); });
+			delete pool;
+			if (t == 1)
+				base = s;
+			char item[64];
+			snprintf(item, sizeof(item), "%s%d: %.3g (x%.2f)", t == 1 ? "" : ", ", t, worlds / s, base / s);
+			scaling += item;
+		}
+		printf("%-26s n=%-8d world-steps/s by thread count: %s\n", "batch/threads", n, scaling.c_str());
+	}
+}
+
+
+// ------------------- Main -------------------
+
+/**
+ * @brief Prints the command line help.
+ */
+void usage(const char* name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("  --sizes A,B,...   particle counts (default 1000,10000,100000,1000000)\n");
+	printf("  --seed S          random seed (default 1)\n");
+	printf("  --min-time T      seconds spent on each measurement (default 0.2)\n");
+	printf("  --max-pairs P     largest n*n run by the broadphase (default 2e9)\n");
+	printf("  --filter F        only run the phases whose name contains F\n");
+	printf("  --out FILE        CSV output (default quantum_bench.csv)\n");
+	printf("  --perf            hardware counters per particle or pair (Linux perf events)\n");
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string a = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (a == "--sizes" && hasValue)
+		{
+			sizes.clear();
+			std::stringstream ss(argv[++i]);
+			std::string item;
+			while (std::getline(ss, item, ','))
+				sizes.push_back(atoi(item.c_str()));
+		}
+		else if (a == "--seed" && hasValue) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (a == "--min-time" && hasValue) minTime = atof(argv[++i]);
+		else if (a == "--max-pairs" && hasValue) maxPairs = atof(argv[++i]);
+		else if (a == "--filter" && hasValue) filter = argv[++i];
+		else if (a == "--out" && hasValue) outPath = argv[++i];
+		else if (a == "--perf") perf = true;
+		else
+		{
+			usage(argv[0]);
+			return a == "--help" || a == "-h" ? 0 : 1;
+		}
+	}
+
+	QmWorld world;
+
+	out = fopen(outPath.c_str(), "w");
+	if (!out)
+	{
+		fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+		return 1;
+	}
+	fprintf(out, "phase,n,runs,unit,ops_per_run,ns_per_op,best_ns_per_op");
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		fprintf(out, ",%s_per_op", QmPerfCounters::eventName(e));
+	fprintf(out, "\n");
+
+	if (perf && !counters.open())
+		fprintf(stderr, "perf events unavailable (check kernel.perf_event_paranoid), --perf ignored\n");
+
+	for (int n : sizes)
+		if (n > 1)
+			benchSize(world, n);
+
+	fclose(out);
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,632 @@
+// Headless scene runner: builds one of the demo scenes of Application.cpp (or a scene file)
+// without graphics, steps it a fixed number of ticks and reports the rate.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream> // initializes std::cout before pxWorld below prints to it
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Quantum.h"
+
+using namespace Quantum;
+
+// ------------------- World and options -------------------
+
+QmWorld pxWorld;
+QmParticle* mousP;
+QmSpringNetwork* springNetwork;
+
+int scene = 1;
+int particles = -1;
+float step = 0.016f;
+int ticks = 1000;
+unsigned int seed = 0;
+int threads = 0;
+bool deterministic = false;
+bool threadMode = false;
+bool g = false;
+bool euler = true;
+bool col = false;
+float damping = 1.0f;
+bool perf = false;
+std::string tracePath;
+int checkAllocs = -1;
+int reorderEvery = 0;
+bool partitionSprings = false;
+bool exactBroadphase = false;
+std::string loadPath, savePath;
+std::string checkpointPrefix;
+int checkpointEvery = 100;
+std::string recordPath;
+int recordEvery = 1;
+std::string playPath;
+std::string sceneFile;
+QmScene sceneDesc;
+int K = 8;
+
+
+// ------------------- Utility Functions -------------------
+
+/**
+ * @brief Generates a random 3D vector with each component in the range [min, max].
+ */
+glm::vec3 randomVector(float min, float max)
+{
+	float x = min + (max - min)*((rand() % 100) / 100.f);
+	float y = min + (max - min)*((rand() % 100) / 100.f);
+	float z = min + (max - min)*((rand() % 100) / 100.f);
+	return glm::vec3(x, y, z);
+}
+
+/**
+ * @brief Prints the command line help.
+ */
+void usage(const char* name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("  --scene S      demo scene 1..4 (default 1)\n");
+	printf("  --scene-file FILE  build the scene described in FILE (see QmScene.h)\n");
+	printf("  --particles N  number of particles (default: the scene's own)\n");
+	printf("  --step H       time step in seconds (default 0.016)\n");
+	printf("  --ticks T      number of ticks (default 1000)\n");
+	printf("  --seed S       random seed (default 0)\n");
+	printf("  --threads N    threads for the parallel phases (default 0: none)\n");
+	printf("  --deterministic  fixed work partitions: the same state hash for any --threads\n");
+	printf("  --thread       tick on the world's own thread at the --step rate and check its snapshots\n");
+	printf("  --gravity      apply gravity\n");
+	printf("  --semi         semi-implicit Euler instead of Euler\n");
+	printf("  --collisions   resolve collisions\n");
+	printf("  --exact-broadphase  test every pair on the float boxes, without the 16-bit packed ones\n");
+	printf("  --damping D    damping factor (default 1.0)\n");
+	printf("  --perf         hardware counters per phase (Linux perf events)\n");
+	printf("  --trace FILE   write a Chrome trace of the ticks and pool tasks\n");
+	printf("  --check-allocs W  fail if a tick allocates after W warm-up ticks\n");
+	printf("  --reorder N    sort the bodies by Morton code every N ticks (default 0: never)\n");
+	printf("  --partition-springs  renumber the spring networks by graph bisection\n");
+	printf("  --load FILE    start from a world image instead of a scene\n");
+	printf("  --save FILE    write a world image after the last tick\n");
+	printf("  --checkpoint PREFIX  write background checkpoints PREFIX<tick>.qmw\n");
+	printf("  --checkpoint-every N ticks between checkpoints (default 100)\n");
+	printf("  --record FILE  record a compressed trajectory of positions and velocities\n");
+	printf("  --record-every N     ticks between trajectory frames (default 1)\n");
+	printf("  --play FILE    decode a recorded trajectory and report the playback rate\n");
+}
+
+
+/**
+ * @brief Adds the timings and counters of one tick to a running total.
+ */
+void accumulate(QmTickStats& total, const QmTickStats& s)
+{
+	for (int p = 0; p < PHASE_COUNT; p++)
+	{
+		total.phaseTime[p] += s.phaseTime[p];
+		total.phaseAllocs[p] += s.phaseAllocs[p];
+		total.phaseAllocBytes[p] += s.phaseAllocBytes[p];
+	}
+	total.tickTime += s.tickTime;
+	total.tickAllocs += s.tickAllocs;
+	total.tickAllocBytes += s.tickAllocBytes;
+	total.bodiesIntegrated += s.bodiesIntegrated;
+	total.forceEntries += s.forceEntries;
+	total.aabbTests += s.aabbTests;
+	total.contactsGenerated += s.contactsGenerated;
+	total.contactsResolved += s.contactsResolved;
+	for (int p = 0; p < PHASE_COUNT; p++)
+		for (int e = 0; e < PERF_EVENT_COUNT; e++)
+			total.phaseEvents[p][e] += s.phaseEvents[p][e];
+}
+
+/**
+ * @brief Prints the time per phase and the counters per tick.
+ */
+void printStats(const QmTickStats& total)
+{
+	if (total.tickTime == 0.)
+		return; // built without QM_ENABLE_STATS
+	printf("%-12s %12s %8s %12s %12s\n", "phase", "us/tick", "share", "allocs/tick", "bytes/tick");
+	for (int p = 0; p < PHASE_COUNT; p++)
+		printf("%-12s %12.2f %7.1f%% %12.1f %12.0f\n", QmTickStats::phaseName(p), 1e6 * total.phaseTime[p] / ticks, 100. * total.phaseTime[p] / total.tickTime,
+			(double)total.phaseAllocs[p] / ticks, (double)total.phaseAllocBytes[p] / ticks);
+	printf("per tick: %.0f bodies integrated, %.0f force entries, %.0f AABB tests, %.0f contacts generated, %.0f resolved\n",
+		(double)total.bodiesIntegrated / ticks, (double)total.forceEntries / ticks, (double)total.aabbTests / ticks,
+		(double)total.contactsGenerated / ticks, (double)total.contactsResolved / ticks);
+}
+
+/**
+ * @brief Prints the hardware events per phase and per tick.
+ */
+void printEvents(const QmTickStats& total)
+{
+	printf("%-12s %14s %14s %6s %12s %12s %12s\n", "phase", "cycles/tick", "instr/tick", "IPC", "L1D miss", "LLC miss", "branch miss");
+	for (int p = 0; p < PHASE_COUNT; p++)
+	{
+		const unsigned long long* e = total.phaseEvents[p];
+		printf("%-12s %14.0f %14.0f %6.2f %12.0f %12.0f %12.0f\n", QmTickStats::phaseName(p),
+			(double)e[PERF_CYCLES] / ticks, (double)e[PERF_INSTRUCTIONS] / ticks,
+			e[PERF_CYCLES] ? (double)e[PERF_INSTRUCTIONS] / e[PERF_CYCLES] : 0.,
+			(double)e[PERF_L1D_MISSES] / ticks, (double)e[PERF_LLC_MISSES] / ticks, (double)e[PERF_BRANCH_MISSES] / ticks);
+	}
+}
+
+
+// ------------------- Particle Creation -------------------
+// Same particles as Application.cpp, without the graphics side.
+
+QmParticle* createParticle()
+{
+	glm::vec3 pos = randomVector(-5, 5);
+	float rad = 0.1f + 0.2f*((rand() % 100) / 100.f);
+	randomVector(1, 0); // color, kept so that a seed gives the same scene as the application
+	QmParticle* p = new QmParticle(pos, randomVector(-1, 1), randomVector(-1, 1), 1, 0, rad, 1);
+	pxWorld.addBody(p);
+	return p;
+}
+
+QmParticle* createParticleMagnet()
+{
+	glm::vec3 posp = randomVector(-6, 6);
+	QmParticle* pp = new QmParticle(posp, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 0.1, 3, 0.2f, 1);
+	glm::vec3 posn = randomVector(-6, 6);
+	QmParticle* pn = new QmParticle(posn, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 0.1, -3, 0.2f, 1);
+
+	pxWorld.AddForceRegistry(new QmForceRegistry(pp, (QmForceGenerator*)new QmMagnetism(0.2, pn)));
+	pxWorld.AddForceRegistry(new QmForceRegistry(pn, (QmForceGenerator*)new QmMagnetism(0.2, pp)));
+	pxWorld.AddForceRegistry(new QmForceRegistry(pp, (QmForceGenerator*)new QmFixedMagnetism(0.4, mousP)));
+	pxWorld.AddForceRegistry(new QmForceRegistry(pn, (QmForceGenerator*)new QmFixedMagnetism(0.4, mousP)));
+
+	pxWorld.addBody(pp);
+	pxWorld.addBody(pn);
+	return pp;
+}
+
+QmParticle* createParticleSpring(QmParticle* part, int lo)
+{
+	randomVector(1, 0);
+	QmParticle* p = new QmParticle(part->getPos() - glm::vec3(-3 + 6 * (rand() % 100) / 100.f, 3, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 2, 0, 0.3f, 1);
+	pxWorld.AddForceRegistry(new QmForceRegistry(p, (QmForceGenerator*)new QmSpring(K, lo, part)));
+	pxWorld.addBody(p);
+	return p;
+}
+
+QmParticle* createTethra(QmParticle* part)
+{
+	QmParticle* p1 = createParticleSpring(part, 2);
+	QmParticle* p2 = createParticleSpring(part, 2);
+	QmParticle* p3 = createParticleSpring(part, 2);
+
+	springNetwork->addSpring(p1, p2, K, 1);
+	springNetwork->addSpring(p2, p3, K, 1);
+	springNetwork->addSpring(p3, p1, K, 1);
+
+	QmParticle* p4 = createParticleSpring(p1, 2);
+	springNetwork->addSpring(p4, p2, K, 1);
+	springNetwork->addSpring(p4, p3, K, 1);
+
+	return p4;
+}
+
+QmParticle* createParticleBox()
+{
+	glm::vec3 pos = randomVector(-5, 5);
+	randomVector(1, 0);
+	QmParticle* p = new QmParticle(pos, randomVector(-4, 4), randomVector(1, 2), 1, 0, 0.3f, 1);
+	pxWorld.addBody(p);
+	return p;
+}
+
+
+// ------------------- Scene Initialization -------------------
+
+/**
+ * @brief Scene 1: random free particles (100 by default).
+ */
+void initScene1(int n)
+{
+	for (int i = 0; i < n; i++)
+		createParticle();
+}
+
+/**
+ * @brief Scene 2: pairs of opposite charges around a fixed particle (100 particles by default).
+ */
+void initScene2(int n)
+{
+	mousP = new QmParticle(glm::vec3(0, 4.5, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 0.1, 0, 0.2f, 0);
+	pxWorld.addBody(mousP);
+	for (int i = 0; i < n / 2; i++)
+		createParticleMagnet();
+}
+
+/**
+ * @brief Scene 3: chain of tetrahedra hanging from a fixed particle (8 particles by default).
+ */
+void initScene3(int n)
+{
+	mousP = new QmParticle(glm::vec3(0, 4.5, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 9.81), 0.1, 0, 0.2f, 0);
+	pxWorld.addBody(mousP);
+	springNetwork = new QmSpringNetwork();
+	pxWorld.AddSpringNetwork(springNetwork);
+	QmParticle* last = mousP;
+	for (int i = 0; i < n / 4 || i == 0; i++)
+		last = createTethra(last);
+}
+
+/**
+ * @brief Scene 4: particles in the collision box (100 by default).
+ */
+void initScene4(int n)
+{
+	pxWorld.CreateBox();
+	for (int i = 0; i < n; i++)
+		createParticleBox();
+}
+
+
+// ------------------- Playback -------------------
+
+/**
+ * @brief Plays a trajectory into a position buffer, as the renderer would.
+ *
+ * Reads every frame in order, then frames in random order, and reports the
+ * rate of each, and the final frame's position hash.
+ */
+int playTrajectory(const std::string& path)
+{
+	QmTrajectoryReader reader;
+	if (!reader.open(path.c_str()))
+	{
+		fprintf(stderr, "Cannot open trajectory %s\n", path.c_str());
+		return 1;
+	}
+	int frames = reader.getFrameCount();
+	if (frames == 0)
+	{
+		printf("Trajectory %s: no frame\n", path.c_str());
+		return 0;
+	}
+	printf("Trajectory %s: %d frames, ticks %llu to %llu, %d slots\n", path.c_str(), frames,
+		reader.getTick(0), reader.getTick(frames - 1), reader.getSlotCount(frames - 1));
+
+	std::vector<glm::vec3> buffer;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		buffer.resize(reader.getSlotCount(f));
+		if (reader.readFrame(f, buffer.data(), NULL, (int)buffer.size()) < 0)
+		{
+			fprintf(stderr, "Frame %d is corrupt\n", f);
+			return 1;
+		}
+	}
+	double sequential = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// FNV-1a over the last frame, to compare runs.
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char* bytes = (const unsigned char*)buffer.data();
+	for (size_t i = 0; i < buffer.size() * sizeof(glm::vec3); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+	int seeks = std::min(frames, 200);
+	srand(seed);
+	start = std::chrono::steady_clock::now();
+	for (int k = 0; k < seeks; k++)
+	{
+		int f = rand() % frames;
+		buffer.resize(reader.getSlotCount(f));
+		reader.readFrame(f, buffer.data(), NULL, (int)buffer.size());
+	}
+	double random = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("in order: %.1f frames/s, random seeks: %.1f frames/s, last frame hash %016llx\n",
+		frames / sequential, seeks / random, hash);
+	return 0;
+}
+
+
+// ------------------- Simulation thread -------------------
+
+/**
+ * @brief Checks one snapshot taken from the simulation thread.
+ * @return The number of problems found (and printed).
+ */
+int checkSnapshot(const QmSnapshot& s, unsigned long long previousTick)
+{
+	if (s.tick <= previousTick)
+	{
+		fprintf(stderr, "snapshot of tick %llu taken after tick %llu\n", s.tick, previousTick);
+		return 1;
+	}
+	if (s.live.size() != s.positions.size())
+	{
+		fprintf(stderr, "snapshot of tick %llu: %zu positions, %zu liveness flags\n", s.tick, s.positions.size(), s.live.size());
+		return 1;
+	}
+	for (size_t h = 0; h < s.positions.size(); h++)
+		if (s.live[h] && !(std::isfinite(s.positions[h].x) && std::isfinite(s.positions[h].y) && std::isfinite(s.positions[h].z)))
+		{
+			fprintf(stderr, "snapshot of tick %llu: handle %zu at a non-finite position\n", s.tick, h);
+			return 1;
+		}
+	return 0;
+}
+
+/**
+ * @brief Runs the ticks on the world's simulation thread, reading it only
+ * through its snapshots, then checks the last snapshot against the stopped world.
+ * @return The number of problems found.
+ */
+int runThread()
+{
+	unsigned long long first = pxWorld.getTickCount(), last = first;
+	int taken = 0, errors = 0;
+	pxWorld.startThread(step, g, damping, euler, col);
+	while (last < first + ticks && errors == 0)
+	{
+		if (!pxWorld.acquireSnapshot())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		errors += checkSnapshot(pxWorld.getSnapshot(), last);
+		last = pxWorld.getSnapshot().tick;
+		taken++;
+	}
+	pxWorld.stopThread();
+
+	// Stopped: the world can be read again, and the latest snapshot must describe it.
+	pxWorld.acquireSnapshot();
+	const QmSnapshot& s = pxWorld.getSnapshot();
+	std::vector<glm::vec3> positions(pxWorld.getHandleCount());
+	pxWorld.exportState(positions.data(), NULL, (int)positions.size());
+	int removed = 0;
+	if (s.tick != pxWorld.getTickCount() || s.positions.size() != positions.size() || s.live.size() != positions.size())
+	{
+		fprintf(stderr, "last snapshot: tick %llu with %zu handles, world at tick %llu with %zu handles\n",
+			s.tick, s.positions.size(), pxWorld.getTickCount(), positions.size());
+		errors++;
+	}
+	else
+	{
+		for (size_t h = 0; h < positions.size(); h++)
+		{
+			bool live = pxWorld.getBodyIndex((int)h) >= 0;
+			removed += !live;
+			if (s.live[h] != live || (live && s.positions[h] != positions[h]))
+			{
+				fprintf(stderr, "last snapshot: handle %zu differs from the world\n", h);
+				errors++;
+				break;
+			}
+		}
+		if (deterministic && s.hash != pxWorld.computeStateHash())
+		{
+			fprintf(stderr, "last snapshot: hash %016llx, world %016llx\n", s.hash, pxWorld.computeStateHash());
+			errors++;
+		}
+	}
+	ticks = (int)(pxWorld.getTickCount() - first);
+	printf("physics thread: %d ticks, %d snapshots taken, %d removed handles in the last\n", ticks, taken, removed);
+	return errors;
+}
+
+
+// ------------------- Main -------------------
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string a = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (a == "--scene" && hasValue) scene = atoi(argv[++i]);
+		else if (a == "--scene-file" && hasValue) sceneFile = argv[++i];
+		else if (a == "--particles" && hasValue) particles = atoi(argv[++i]);
+		else if (a == "--step" && hasValue) step = (float)atof(argv[++i]);
+		else if (a == "--ticks" && hasValue) ticks = atoi(argv[++i]);
+		else if (a == "--seed" && hasValue) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (a == "--threads" && hasValue) threads = atoi(argv[++i]);
+		else if (a == "--deterministic") deterministic = true;
+		else if (a == "--thread") threadMode = true;
+		else if (a == "--damping" && hasValue) damping = (float)atof(argv[++i]);
+		else if (a == "--gravity") g = true;
+		else if (a == "--semi") euler = false;
+		else if (a == "--collisions") col = true;
+		else if (a == "--exact-broadphase") exactBroadphase = true;
+		else if (a == "--perf") perf = true;
+		else if (a == "--trace" && hasValue) tracePath = argv[++i];
+		else if (a == "--check-allocs" && hasValue) checkAllocs = atoi(argv[++i]);
+		else if (a == "--reorder" && hasValue) reorderEvery = atoi(argv[++i]);
+		else if (a == "--partition-springs") partitionSprings = true;
+		else if (a == "--load" && hasValue) loadPath = argv[++i];
+		else if (a == "--save" && hasValue) savePath = argv[++i];
+		else if (a == "--checkpoint" && hasValue) checkpointPrefix = argv[++i];
+		else if (a == "--checkpoint-every" && hasValue) checkpointEvery = atoi(argv[++i]);
+		else if (a == "--record" && hasValue) recordPath = argv[++i];
+		else if (a == "--record-every" && hasValue) recordEvery = atoi(argv[++i]);
+		else if (a == "--play" && hasValue) playPath = argv[++i];
+		else
+		{
+			usage(argv[0]);
+			return a == "--help" || a == "-h" ? 0 : 1;
+		}
+	}
+	if (scene < 1 || scene > 4)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	if (!playPath.empty())
+		return playTrajectory(playPath);
+
+	std::chrono::steady_clock::time_point setup = std::chrono::steady_clock::now();
+	if (!loadPath.empty())
+	{
+		if (!QmWorldImage::load(pxWorld, loadPath.c_str()))
+		{
+			fprintf(stderr, "Cannot load world image %s\n", loadPath.c_str());
+			return 1;
+		}
+	}
+	else if (!sceneFile.empty())
+	{
+		if (!sceneDesc.load(sceneFile.c_str()))
+		{
+			fprintf(stderr, "%s\n", sceneDesc.getError().c_str());
+			return 1;
+		}
+		sceneDesc.build(pxWorld);
+	}
+	else
+	{
+		srand(seed);
+		switch (scene)
+		{
+		case 1: initScene1(particles < 0 ? 100 : particles); break;
+		case 2: initScene2(particles < 0 ? 100 : particles); break;
+		case 3: initScene3(particles < 0 ? 8 : particles); break;
+		case 4: initScene4(particles < 0 ? 100 : particles); break;
+		}
+	}
+	double setupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - setup).count();
+
+	QmThreadPool* pool = threads > 1 ? new QmThreadPool(threads) : NULL;
+	pxWorld.setThreadPool(pool);
+	pxWorld.setDeterministic(deterministic);
+
+	if (!loadPath.empty())
+		printf("Image %s: %d bodies loaded in %.3f s, step %g, %d ticks\n", loadPath.c_str(), pxWorld.getBodyCount(), setupSeconds, step, ticks);
+	else if (!sceneFile.empty())
+		printf("Scene %s: %d bodies built in %.3f s, step %g, %d ticks\n", sceneFile.c_str(), pxWorld.getBodyCount(), setupSeconds, step, ticks);
+	else
+		printf("Scene %d: %d bodies built in %.3f s, step %g, %d ticks, seed %u\n", scene, pxWorld.getBodyCount(), setupSeconds, step, ticks, seed);
+
+	if (perf && !pxWorld.enablePerfCounters(true))
+	{
+		fprintf(stderr, "perf events unavailable (check kernel.perf_event_paranoid), --perf ignored\n");
+		perf = false;
+	}
+
+	if (!tracePath.empty())
+	{
+		QmTrace::setThreadName("main");
+		QmTrace::enable();
+	}
+
+	if (checkAllocs >= 0 && !QmAllocTracker::isEnabled())
+		fprintf(stderr, "built without QM_TRACK_ALLOCATIONS, --check-allocs sees no allocation\n");
+	if (checkAllocs >= 0)
+		pxWorld.setAllocationCheck(checkAllocs);
+	pxWorld.setReorderInterval(reorderEvery);
+	pxWorld.setQuantizedBroadphase(!exactBroadphase);
+	if (partitionSprings)
+		for (QmSpringNetwork* net : pxWorld.getSpringNetworks())
+			net->reorder();
+
+	QmCheckpointer* checkpointer = checkpointPrefix.empty() ? NULL : new QmCheckpointer(checkpointPrefix);
+	pxWorld.setCheckpointer(checkpointer, checkpointEvery);
+
+	QmTrajectoryWriter* recorder = NULL;
+	if (!recordPath.empty())
+	{
+		// Quantize against the initial bounding box, with room for the bodies to spread.
+		std::vector<glm::vec3> start(pxWorld.getHandleCount());
+		pxWorld.exportState(start.data(), NULL, (int)start.size());
+		glm::vec3 lo(0.f), hi(0.f);
+		for (size_t i = 0; i < start.size(); i++)
+		{
+			lo = i ? glm::min(lo, start[i]) : start[i];
+			hi = i ? glm::max(hi, start[i]) : start[i];
+		}
+		glm::vec3 margin = glm::max((hi - lo) * 0.5f, glm::vec3(1.f));
+		recorder = new QmTrajectoryWriter(lo - margin, hi + margin);
+		if (!recorder->open(recordPath.c_str()))
+		{
+			fprintf(stderr, "Cannot create trajectory %s\n", recordPath.c_str());
+			return 1;
+		}
+		pxWorld.setTrajectoryWriter(recorder, recordEvery);
+	}
+
+
+	QmTickStats total;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (threadMode)
+	{
+		if (runThread())
+			return 1;
+	}
+	else
+		for (int i = 0; i < ticks; i++)
+		{
+			pxWorld.tick(step, g, damping, euler, col);
+			accumulate(total, pxWorld.getStats());
+		}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%.3f s, %.1f ticks/s, state hash %016llx\n", seconds, ticks / seconds, pxWorld.computeStateHash());
+	printStats(total);
+	if (!tracePath.empty())
+	{
+		QmTrace::disable();
+		if (QmTrace::dump(tracePath.c_str()))
+			printf("trace written to %s\n", tracePath.c_str());
+		else
+			fprintf(stderr, "Cannot write trace %s\n", tracePath.c_str());
+	}
+	if (perf && total.tickTime > 0.)
+		printEvents(total);
+
+	if (recorder)
+	{
+		pxWorld.setTrajectoryWriter(NULL, 1);
+		bool ok = recorder->close();
+		printf("trajectory: %llu frames, %.1f MB (%.1f%% of the raw floats), record() %.2f%% of the run, %llu stalls\n",
+			recorder->getFrames(), recorder->getBytes() / 1048576., 100. * recorder->getBytes() / std::max(1ULL, recorder->getRawBytes()),
+			100. * recorder->getRecordSeconds() / seconds, recorder->getStalls());
+		delete recorder;
+		if (!ok)
+		{
+			fprintf(stderr, "Cannot write trajectory %s\n", recordPath.c_str());
+			return 1;
+		}
+	}
+
+	if (checkpointer)
+	{
+		pxWorld.setCheckpointer(NULL, 1);
+		checkpointer->flush();
+		printf("checkpoints: %llu written (%.1f MB of sections), %llu skipped, %llu failed, last %s\n",
+			checkpointer->getWritten(), checkpointer->getBytesWritten() / 1048576., checkpointer->getSkipped(),
+			checkpointer->getFailed(), checkpointer->getLastPath().c_str());
+		delete checkpointer;
+	}
+
+	for (QmEmitter* e : pxWorld.getEmitters())
+		printf("emitter: %d of %d alive, %llu spawned, %llu expired, %llu recycled\n",
+			e->getAliveCount(), e->getCapacity(), e->getSpawned(), e->getExpired(), e->getRecycled());
+
+	if (!savePath.empty())
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		if (!QmWorldImage::save(pxWorld, savePath.c_str()))
+		{
+			fprintf(stderr, "Cannot write world image %s\n", savePath.c_str());
+			return 1;
+		}
+		printf("world image written to %s in %.3f s\n", savePath.c_str(), std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+	}
+
+	unsigned long long violations = pxWorld.getAllocationViolations();
+	if (checkAllocs >= 0)
+		printf("allocation check: %llu of %d ticks allocated after %d warm-up ticks\n", violations, ticks - std::min(ticks, checkAllocs), checkAllocs);
+
+	pxWorld.clear();
+	delete pool;
+	return violations ? 2 : 0;
+}
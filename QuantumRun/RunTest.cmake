@@ -0,0 +1,91 @@
+# Drives quantum_run for the ctest cases of QuantumRun/CMakeLists.txt.
+#
+#   cmake -DRUN=<quantum_run> -DMODE=<mode> -DARGS="<options>" [-DTICKS=N] [-DWORK=<dir>] -P RunTest.cmake
+#
+# MODE determinism  runs ARGS with --deterministic on 1, 4 and 0 (no pool)
+#                   threads, and on 4 threads once more, and compares the
+#                   state hashes.
+# MODE restart      runs ARGS for TICKS ticks, then TICKS/2 ticks, --save, --load
+#                   and TICKS/2 more ticks, and compares the final state hashes.
+# MODE playback     records ARGS for TICKS ticks, plays the trajectory back, and
+#                   checks that every frame decodes and that a recording made
+#                   with 4 threads plays back to the same last frame.
+# MODE thread       runs ARGS --deterministic for TICKS ticks on the simulation
+#                   thread (quantum_run checks its snapshots), then the same
+#                   number of ticks on the caller, and compares the state hashes.
+
+separate_arguments(ARGS UNIX_COMMAND "${ARGS}")
+if(NOT WORK)
+	set(WORK "${CMAKE_CURRENT_BINARY_DIR}")
+endif()
+
+# Runs quantum_run, fails the test on a non-zero exit, and stores its output in OUT.
+function(run_quantum OUT)
+	execute_process(COMMAND "${RUN}" ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "quantum_run ${ARGN} failed (${result}):\n${output}")
+	endif()
+	set(${OUT} "${output}" PARENT_SCOPE)
+endfunction()
+
+# Extracts the hash following TAG in OUTPUT.
+function(find_hash OUT TAG OUTPUT)
+	string(REGEX MATCH "${TAG} ([0-9a-f]+)" match "${OUTPUT}")
+	if(NOT match)
+		message(FATAL_ERROR "No ${TAG} in:\n${OUTPUT}")
+	endif()
+	set(${OUT} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+endfunction()
+
+if(MODE STREQUAL "determinism")
+	run_quantum(reference ${ARGS} --deterministic --threads 1 --ticks ${TICKS})
+	find_hash(h1 "state hash" "${reference}")
+	foreach(threads 4 0 4)
+		run_quantum(output ${ARGS} --deterministic --threads ${threads} --ticks ${TICKS})
+		find_hash(h2 "state hash" "${output}")
+		if(NOT h1 STREQUAL h2)
+			message(FATAL_ERROR "Deterministic runs ended with hash ${h1} on 1 thread and ${h2} on ${threads}")
+		endif()
+	endforeach()
+elseif(MODE STREQUAL "restart")
+	math(EXPR half "${TICKS} / 2")
+	set(image "${WORK}/restart.qmw")
+	run_quantum(whole ${ARGS} --ticks ${TICKS})
+	run_quantum(before ${ARGS} --ticks ${half} --save "${image}")
+	# --load takes precedence over the scene options in ARGS.
+	run_quantum(after ${ARGS} --load "${image}" --ticks ${half})
+	find_hash(h1 "state hash" "${whole}")
+	find_hash(h2 "state hash" "${after}")
+	if(NOT h1 STREQUAL h2)
+		message(FATAL_ERROR "Uninterrupted run ended with hash ${h1}, saved and reloaded run with ${h2}")
+	endif()
+elseif(MODE STREQUAL "playback")
+	set(trajectory "${WORK}/playback.qmt")
+	run_quantum(recorded ${ARGS} --ticks ${TICKS} --record "${trajectory}")
+	run_quantum(played --play "${trajectory}")
+	if(NOT played MATCHES "${TICKS} frames")
+		message(FATAL_ERROR "Expected ${TICKS} frames:\n${played}")
+	endif()
+	find_hash(h1 "last frame hash" "${played}")
+	run_quantum(recorded ${ARGS} --threads 4 --ticks ${TICKS} --record "${trajectory}")
+	run_quantum(played --play "${trajectory}")
+	find_hash(h2 "last frame hash" "${played}")
+	if(NOT h1 STREQUAL h2)
+		message(FATAL_ERROR "Recordings made with 0 and 4 threads play back to ${h1} and ${h2}")
+	endif()
+elseif(MODE STREQUAL "thread")
+	run_quantum(threaded ${ARGS} --deterministic --thread --ticks ${TICKS})
+	# The thread may tick a little past TICKS before it is stopped.
+	string(REGEX MATCH "physics thread: ([0-9]+) ticks" match "${threaded}")
+	if(NOT match)
+		message(FATAL_ERROR "No physics thread report in:\n${threaded}")
+	endif()
+	find_hash(h1 "state hash" "${threaded}")
+	run_quantum(stepped ${ARGS} --deterministic --ticks ${CMAKE_MATCH_1})
+	find_hash(h2 "state hash" "${stepped}")
+	if(NOT h1 STREQUAL h2)
+		message(FATAL_ERROR "${CMAKE_MATCH_1} ticks on the simulation thread ended with hash ${h1}, on the caller with ${h2}")
+	endif()
+else()
+	message(FATAL_ERROR "Unknown MODE ${MODE}")
+endif()